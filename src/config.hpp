@@ -12,11 +12,20 @@ static const int kGlobalFloorId = 0; // never change
 typedef std::vector<int>::iterator witerator;
 
 class Node;
-typedef std::unique_ptr<Node> NodePtr;
-typedef boost::container::flat_map<int, NodePtr> ChildMapType;
-//typedef std::unordered_map<int, NodePtr> ChildMapType;
+// children are owned by the NodePool of the tree
+typedef boost::container::flat_map<int, Node*> ChildMapType;
+//typedef std::unordered_map<int, Node*> ChildMapType;
+// nodes of each depth, in registration order (see ContextTree)
+typedef std::vector<std::vector<Node*> > Depth2Nodes;
 
 typedef int16_t topic_t;
+// values of the predictives kept by the particle filter (PredictiveHistory)
+// for rejuvenation; float halves its memory (configure --float-history)
+#ifdef TOPICLM_FLOAT_HISTORY
+typedef float history_t;
+#else
+typedef double history_t;
+#endif
 
 static const std::string kEosKey = "__eos__";
 // static std::string kUnkKey = "__unk__";
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 #include "context_tree.hpp"
 #include "restaurant.hpp"
 
@@ -15,7 +16,7 @@ bool IteratorState::MoreChildren() {
   return current_ != node_->end();
 }
 Node* IteratorState::pop() {
-  Node* ret = (*current_).second.get();
+  Node* ret = (*current_).second;
   ++current_;
   return ret;
 }
@@ -108,12 +109,23 @@ bool DfsPathIterator::HasMore() {
   return !iterator_state_stack_.empty();
 }
 ContextTree::ContextTree(int ngram_order_, int eos_id)
-    : root_(new Node(-1, nullptr)),
+    : root_(pool_.New(-1, nullptr)),
       depth2nodes_(ngram_order_), eos_id_(eos_id) {
-  depth2nodes_[0].insert(root_.get());
+  RegisterNode(root_, 0);
 }
 
-int GetNextType(const std::vector<int>& sent,
+ContextTree::~ContextTree() {
+  // children before their parents
+  std::vector<Node*> nodes;
+  for (auto node_it = GetDfsNodeIterator(); node_it.HasMore(); ++node_it) {
+    nodes.push_back(*node_it);
+  }
+  for (auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+    pool_.Delete(*it);
+  }
+}
+
+int GetNextType(Span<int> sent,
                 int idx,
                 int current_depth) {
   int prev_idx = idx + current_depth; // if current_depth = 0: prev_idx = idx, if 1: prev_idx = idx + 1
@@ -121,7 +133,7 @@ int GetNextType(const std::vector<int>& sent,
   return sent.at(prev_idx + 1);
 }
 
-int ContextTree::WalkTree(const std::vector<int>& sent,
+int ContextTree::WalkTree(Span<int> sent,
                           int idx,
                           int current_depth,
                           int target_depth,
@@ -133,8 +145,9 @@ int ContextTree::WalkTree(const std::vector<int>& sent,
     // int t = sent[idx];
     auto child = current->child(t);
     if (child == nullptr) {
-      child = current->set_child(t, current);
-      depth2nodes_[current_depth + 1].insert(child);
+      child = current->set_child(t, pool_.New(t, current));
+      RegisterNode(child, current_depth + 1);
+      LinkNode(child);
     }
     current = child;
     node_path[current_depth + 1] = current;
@@ -142,7 +155,7 @@ int ContextTree::WalkTree(const std::vector<int>& sent,
   return current_depth;
 }
 
-int ContextTree::WalkTreeNoCreate(const vector<int>& sent,
+int ContextTree::WalkTreeNoCreate(Span<int> sent,
                                   int idx,
                                   int current_depth,
                                   vector<Node*>& node_path) const {
@@ -162,16 +175,125 @@ int ContextTree::WalkTreeNoCreate(const vector<int>& sent,
   return current_depth;
 }
 
-void ContextTree::EraseEmptyNodes(int current_depth,
-                                  int target_depth,
-                                  const std::vector<Node*>& node_path) {
+int ContextTree::AdvanceNoCreate(Span<int> sent,
+                                 int idx,
+                                 int prev_depth,
+                                 vector<Node*>& node_path) const {
+  int t = (idx >= 0) ? sent[idx] : eos_id_;
+  // (t, h1, ..., hd) can be in the tree only if (h1, ..., hd) is, so back off
+  // from the deepest node which may still be extended
+  int max_depth = depth2nodes_.size() - 1;
+  int base_depth = min(prev_depth, max_depth - 1);
+  for (int depth = base_depth; depth >= 0; --depth) {
+    Node* current = node_path[depth]->extension(t);
+    if (current == nullptr) continue;
+    int current_depth = depth + 1;
+    if (depth == base_depth) {
+      // the new context may match deeper than the previous one did
+      for (int i = idx - current_depth; ; --i, ++current_depth) {
+        auto child = current->child((i >= 0) ? sent[i] : eos_id_);
+        if (child == nullptr) break;
+        current = child;
+      }
+    }
+    for (int d = current_depth; d > 0; --d, current = current->parent()) {
+      node_path[d] = current;
+    }
+    return current_depth;
+  }
+  return 0;
+}
+
+int ContextTree::EraseEmptyNodes(int current_depth,
+                                 int target_depth,
+                                 const std::vector<Node*>& node_path) {
   for (; current_depth > target_depth; --current_depth) {
     auto& restaurant = node_path[current_depth]->restaurant();
-    if (restaurant.Empty()) {
-      depth2nodes_[current_depth].erase(node_path[current_depth]);
-      node_path[current_depth - 1]->EraseChild(node_path[current_depth]->type());
+    // a node may still hold empty children when several words have been
+    // removed at once (parallel sampling); they are erased by their own words
+    if (!restaurant.Empty() || !node_path[current_depth]->children().empty()) {
+      break;
     }
+    UnregisterNode(node_path[current_depth], current_depth);
+    UnlinkNode(node_path[current_depth]);
+    pool_.Retire(node_path[current_depth - 1]->EraseChild(node_path[current_depth]->type()));
   }
+  return current_depth;
+}
+void ContextTree::RegisterNode(Node* node, int depth) {
+  auto& nodes = depth2nodes_[depth];
+  node->registry_idx_ = nodes.size();
+  nodes.push_back(node);
+}
+void ContextTree::UnregisterNode(Node* node, int depth) {
+  auto& nodes = depth2nodes_[depth];
+  Node* last = nodes.back();
+  nodes[node->registry_idx_] = last;
+  last->registry_idx_ = node->registry_idx_;
+  nodes.pop_back();
+  node->registry_idx_ = -1;
+}
+
+namespace {
+// the most recent word of the context of node
+int RecentType(const Node* node) {
+  while (node->parent()->parent() != nullptr) node = node->parent();
+  return node->type();
+}
+}
+
+void ContextTree::LinkNode(Node* node) {
+  Node* parent = node->parent_;
+  int type = node->type_;
+  if (parent == root_) {
+    node->suffix_ = root_;
+  } else if (parent->suffix_ != nullptr) {
+    Node* suffix = parent->suffix_->child(type);
+    if (suffix != nullptr) {
+      node->suffix_ = suffix;
+      suffix->extensions_[RecentType(node)] = node;
+    } else {
+      parent->suffix_->orphans_[type].push_back(node);
+    }
+  }
+  // the nodes whose suffix is this node have been waiting in the parent
+  auto orphans_it = parent->orphans_.find(type);
+  if (orphans_it != parent->orphans_.end()) {
+    for (Node* orphan : (*orphans_it).second) {
+      orphan->suffix_ = node;
+      node->extensions_[RecentType(orphan)] = orphan;
+      for (auto& child : orphan->children_) {
+        node->orphans_[child.first].push_back(child.second);
+      }
+    }
+    parent->orphans_.erase(orphans_it);
+  }
+}
+
+void ContextTree::UnlinkNode(Node* node) {
+  Node* parent = node->parent_;
+  int type = node->type_;
+  if (node->suffix_ != nullptr) {
+    if (node->suffix_ != root_) {
+      node->suffix_->extensions_.erase(RecentType(node));
+    }
+  } else if (parent != root_ && parent->suffix_ != nullptr) {
+    auto& orphans = parent->suffix_->orphans_[type];
+    orphans.erase(std::find(orphans.begin(), orphans.end(), node));
+    if (orphans.empty()) parent->suffix_->orphans_.erase(type);
+  }
+  // the extensions wait for this context again; their children (the orphans
+  // of this node) lose their suffixes
+  for (auto& extension : node->extensions_) {
+    extension.second->suffix_ = nullptr;
+    parent->orphans_[type].push_back(extension.second);
+  }
+  node->extensions_.clear();
+  node->orphans_.clear();
+  node->suffix_ = nullptr;
+}
+void ContextTree::ReclaimRetiredNodes() {
+  pool_.Reclaim();
 }
 int ContextTree::CountNodes() const {
   int cnt = 0;
@@ -7,7 +7,9 @@
 #include <memory>
 #include <pficommon/text/json.h>
 #include "node.hpp"
+#include "node_pool.hpp"
 #include "config.hpp"
+#include "span.hpp"
 
 namespace topiclm {
 
@@ -61,33 +63,67 @@ class DfsPathIterator {
 class ContextTree {
  public:
   ContextTree(int ngram_order_, int eos_id);
-  int WalkTree(const std::vector<int>& sent,
+  ~ContextTree();
+  int WalkTree(Span<int> sent,
                 int idx,
                 int current_depth,
                 int target_depth,
                 std::vector<Node*>& node_path);
-  int WalkTreeNoCreate(const std::vector<int>& sent,
+  int WalkTreeNoCreate(Span<int> sent,
                         int idx,
                         int current_depth,
                         std::vector<Node*>& node_path) const;
-  void EraseEmptyNodes(int current_depth,
-                       int target_depth,
-                       const std::vector<Node*>& node_path);
+  /**
+   * From node_path, the path of the context preceding sent[idx] (as left by
+   * WalkTreeNoCreate(sent, idx - 1, 0, node_path)) of depth prev_depth, move
+   * to the path of the context preceding sent[idx + 1] by the extension and
+   * suffix links. Same result as WalkTreeNoCreate(sent, idx, 0, node_path).
+   */
+  int AdvanceNoCreate(Span<int> sent,
+                      int idx,
+                      int prev_depth,
+                      std::vector<Node*>& node_path) const;
+  /**
+   * Returns the depth of the deepest node left on node_path.
+   */
+  int EraseEmptyNodes(int current_depth,
+                      int target_depth,
+                      const std::vector<Node*>& node_path);
+  /**
+   * Nodes erased by EraseEmptyNodes are kept until this is called (once per
+   * iteration), so node pointers held during an iteration stay valid.
+   */
+  void ReclaimRetiredNodes();
+  const NodePool::Stats& node_pool_stats() const { return pool_.stats(); }
+  size_t num_live_nodes() const { return pool_.num_live(); }
   DfsNodeIterator GetDfsNodeIterator() const {
-    return DfsNodeIterator(root_.get(), *this);
+    return DfsNodeIterator(root_, *this);
   }
   DfsPathIterator GetDfsPathIterator() const {
-    return DfsPathIterator(root_.get(), *this);
+    return DfsPathIterator(root_, *this);
   }
   int CountNodes() const;
 
   double CalcUnigramProbability(int type) const;
 
-  Node* root() const { return root_.get(); }
-  const std::vector<std::set<Node*> >& depth2nodes() const { return depth2nodes_; }
+  Node* root() const { return root_; }
+  int eos_id() const { return eos_id_; }
+  const Depth2Nodes& depth2nodes() const { return depth2nodes_; }
  private:
-  std::unique_ptr<Node> root_;
-  std::vector<std::set<Node*> > depth2nodes_;
+  ContextTree(const ContextTree&);
+  ContextTree& operator=(const ContextTree&);
+
+  // O(1) registration by swap-remove; the index is kept in the node
+  void RegisterNode(Node* node, int depth);
+  void UnregisterNode(Node* node, int depth);
+  // keep the suffix links and extensions consistent when a node is created
+  // or erased (only leaves are erased)
+  void LinkNode(Node* node);
+  void UnlinkNode(Node* node);
+
+  NodePool pool_; // must outlive root_
+  Node* root_;
+  Depth2Nodes depth2nodes_;
   int eos_id_;
 
   friend class pfi::data::serialization::access;
@@ -95,19 +131,20 @@ class ContextTree {
   void serialize(Archive& ar) {
     if (ar.is_read) {
       std::queue<Node*> node_queue;
-      node_queue.push(root_.get());
+      node_queue.push(root_);
       int i = 0;
       while (!node_queue.empty()) {
         Node* node = node_queue.front();
         node_queue.pop();
         ar & *node;
-        depth2nodes_[node->depth()].insert(node);
+        RegisterNode(node, node->depth());
         
         std::vector<int> child_types;
         ar & child_types;
         for (int type : child_types) {
-          auto child_it = node->children().find(type);
-          node_queue.push((*child_it).second.get());
+          Node* child = node->set_child(type, pool_.New(type, node));
+          LinkNode(child);
+          node_queue.push(child);
         }
         ++i;
       }
@@ -116,7 +153,7 @@ class ContextTree {
       assert(i == j);
     } else {
       std::queue<Node*> node_queue;
-      node_queue.push(root_.get());
+      node_queue.push(root_);
       int i = 0;
       while (!node_queue.empty()) {
         Node* node = node_queue.front();
@@ -129,7 +166,7 @@ class ContextTree {
         ar & child_types;
         for (int type : child_types) {
           auto child_it = node->children().find(type);
-          node_queue.push((*child_it).second.get());
+          node_queue.push((*child_it).second);
         }
         ++i;
       }
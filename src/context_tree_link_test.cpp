@@ -0,0 +1,109 @@
+#include <vector>
+#include <random>
+#include "context_tree.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace topiclm;
+using namespace std;
+
+namespace {
+
+const int kOrder = 5;
+const int kEosId = 0;
+const int kLexicon = 4; // word ids 1..kLexicon, and eos
+
+// the node of the context (most recent word first), or nullptr
+Node* FindContext(const ContextTree& ct, const vector<int>& context) {
+  Node* current = ct.root();
+  for (int type : context) {
+    current = current->child(type);
+    if (current == nullptr) return nullptr;
+  }
+  return current;
+}
+
+// compare the links of every node with those recomputed from the contexts
+void CheckLinks(const ContextTree& ct, Node* node, vector<int>& context) {
+  if (!context.empty()) {
+    vector<int> suffix(context.begin() + 1, context.end());
+    EXPECT_EQ(FindContext(ct, suffix), node->suffix_link());
+  }
+  for (int t = 0; t <= kLexicon; ++t) {
+    vector<int> extended(1, t);
+    extended.insert(extended.end(), context.begin(), context.end());
+    EXPECT_EQ(FindContext(ct, extended), node->extension(t));
+  }
+  for (auto& child : node->children()) {
+    context.push_back(child.first);
+    CheckLinks(ct, child.second, context);
+    context.pop_back();
+  }
+}
+
+void CheckLinks(const ContextTree& ct) {
+  vector<int> context;
+  CheckLinks(ct, ct.root(), context);
+}
+
+// advancing along a sentence gives the paths of walking from the root
+void CheckAdvance(const ContextTree& ct, const vector<int>& sent) {
+  vector<Node*> walked(kOrder + 1, ct.root());
+  vector<Node*> advanced(kOrder + 1, ct.root());
+  int advanced_depth = 0;
+  for (int i = 0; i < int(sent.size()); ++i) {
+    int walked_depth = ct.WalkTreeNoCreate(sent, i - 1, 0, walked);
+    if (i == 0) {
+      advanced_depth = ct.WalkTreeNoCreate(sent, i - 1, 0, advanced);
+    } else {
+      advanced_depth = ct.AdvanceNoCreate(sent, i - 1, advanced_depth, advanced);
+    }
+    ASSERT_EQ(walked_depth, advanced_depth);
+    for (int d = 0; d <= walked_depth; ++d) {
+      EXPECT_EQ(walked[d], advanced[d]);
+    }
+  }
+}
+
+} // namespace
+
+TEST(context_tree_link, random_create_and_erase) {
+  mt19937 random(17);
+  uniform_int_distribution<int> word(1, kLexicon);
+  vector<vector<int> > sents(6);
+  for (auto& sent : sents) {
+    int length = 3 + random() % 8;
+    for (int i = 0; i < length; ++i) sent.push_back(word(random));
+  }
+
+  ContextTree ct(kOrder, kEosId);
+  // (sentence, position, depth) of the nodes which have been walked to
+  vector<vector<int> > walked;
+  vector<Node*> node_path(kOrder + 1, ct.root());
+  for (int step = 0; step < 3000; ++step) {
+    if (walked.empty() || random() % 5 < 3) {
+      int s = random() % sents.size();
+      int idx = random() % sents[s].size();
+      int depth = random() % kOrder;
+      ct.WalkTree(sents[s], idx - 1, 0, depth, node_path);
+      walked.push_back({s, idx, depth});
+    } else {
+      // the restaurants are empty, so leaves are erased up to a branching node
+      int w = random() % walked.size();
+      auto& sent = sents[walked[w][0]];
+      int depth = ct.WalkTreeNoCreate(sent, walked[w][1] - 1, 0, node_path);
+      depth = min(depth, walked[w][2]);
+      if (depth > 0) {
+        ct.EraseEmptyNodes(depth, 0, node_path);
+      }
+      walked.erase(walked.begin() + w);
+    }
+    if (step % 50 == 0) {
+      CheckLinks(ct);
+      for (auto& sent : sents) CheckAdvance(ct, sent);
+      ct.ReclaimRetiredNodes();
+    }
+  }
+  CheckLinks(ct);
+  for (auto& sent : sents) CheckAdvance(ct, sent);
+}
@@ -32,10 +32,13 @@ ContextTreeManager::ContextTreeManager(LambdaType lambda_type,
                                        TreeType tree_type,
                                        const Parameters& parameters,
                                        int lexicon,
-                                       int eos_id)
+                                       int eos_id,
+                                       SamplerContext& context)
     : ct_(parameters.ngram_order(), eos_id),
       lmanager_(GetLambdaManager(lambda_type, parameters)),
       parameters_(parameters),
+      context_(context),
+      tree_type_(tree_type),
       lexicon_(lexicon),
       num_topics_(parameters.topic_parameter().num_topics),
       zero_order_pred_(1.0 / lexicon),
@@ -44,71 +47,84 @@ ContextTreeManager::ContextTreeManager(LambdaType lambda_type,
                           + parameters.hpy_parameter().prior_stop())),
       ngram_order_(parameters.ngram_order()),
       node_path_(parameters.ngram_order(), nullptr),
-      stop_prior_path_(parameters.ngram_order()) {
-  if (tree_type == kGraphical) {
-    rmanager_.reset(
-        new RestaurantManager(node_path_, *lmanager_, parameters_, zero_order_pred_));
-  } else {
-    rmanager_.reset(
-        new NonGraphicalRestaurantManager(node_path_, *lmanager_, parameters_, zero_order_pred_));
-  }
+      stop_prior_path_(parameters.ngram_order()),
+      test_sent_(nullptr),
+      test_idx_(-1),
+      test_depth_(0) {
+  rmanager_.reset(NewRestaurantManager(node_path_, *lmanager_, context_));
   
   node_path_[0] = ct_.root();
 }
 
 ContextTreeManager::~ContextTreeManager() {}
 
-int ContextTreeManager::WalkTreeNoCreate(const std::vector<int>& sent,
+int ContextTreeManager::WalkTreeNoCreate(Span<int> sent,
                                          int current_idx,
                                          int current_depth) {
+  test_sent_ = nullptr;
   return ct_.WalkTreeNoCreate(sent, current_idx, current_depth, node_path_);
 }
-int ContextTreeManager::WalkTree(const std::vector<int>& sent,
+int ContextTreeManager::WalkTree(Span<int> sent,
                                  int current_idx,
                                  int current_depth,
                                  int target_depth) {
+  test_sent_ = nullptr;
   return ct_.WalkTree(sent, current_idx, current_depth, target_depth, node_path_);
 }
+int ContextTreeManager::AdvanceNoCreate(Span<int> sent,
+                                        int current_idx,
+                                        int prev_depth) {
+  test_sent_ = nullptr;
+  return ct_.AdvanceNoCreate(sent, current_idx, prev_depth, node_path_);
+}
 
 void ContextTreeManager::UpTreeFromLeaf(Node* leaf, int depth) {
+  test_sent_ = nullptr;
   util::UpTreeFromLeaf(leaf, depth, node_path_);
 }
-void ContextTreeManager::EraseEmptyNodes(int current_depth, int target_depth) {
+int ContextTreeManager::EraseEmptyNodes(int current_depth, int target_depth) {
   assert(current_depth > target_depth);
-  ct_.EraseEmptyNodes(current_depth, target_depth, node_path_);
+  test_sent_ = nullptr;
+  return ct_.EraseEmptyNodes(current_depth, target_depth, node_path_);
 }
 void ContextTreeManager::CalcLambdaPath(int word_depth) {
   lmanager_->CalcLambdaPath(node_path_, word_depth);
 }
 void ContextTreeManager::CalcStopPriorPath(int word_depth, int max_depth) {
+  CalcStopPriorPath(node_path_, word_depth, max_depth, stop_prior_path_);
+}
+void ContextTreeManager::CalcStopPriorPath(const std::vector<Node*>& node_path,
+                                           int word_depth,
+                                           int max_depth,
+                                           std::vector<double>& stop_prior_path) const {
   double pass_prob = 1;
   double prior_stop = parameters_.hpy_parameter().prior_stop();
   double prior_pass = parameters_.hpy_parameter().prior_pass();
-  //int max_depth = stop_prior_path_.size();
-  max_depth = min(max_depth, (int)stop_prior_path_.size() - 1);
+  //int max_depth = stop_prior_path.size();
+  max_depth = min(max_depth, (int)stop_prior_path.size() - 1);
   double p_sum = 0;
   for (int i = 0; i <= max_depth; ++i) {
     double node_stop_prob = 0;
     if (i <= word_depth) {
-      auto& restaurant = node_path_[i]->restaurant();
+      auto& restaurant = node_path[i]->restaurant();
       node_stop_prob = (restaurant.stop_customers() + prior_stop)
           / (restaurant.stop_customers() + restaurant.pass_customers()
              + prior_stop + prior_pass);
     } else {
       node_stop_prob = 1 - zero_order_pass_;
     }
-    stop_prior_path_[i] = pass_prob * node_stop_prob;
+    stop_prior_path[i] = pass_prob * node_stop_prob;
     pass_prob *= (1 - node_stop_prob);
-    p_sum += stop_prior_path_[i];    
+    p_sum += stop_prior_path[i];    
   }
-  if (p_sum == 0) stop_prior_path_[max_depth] = 1;
+  if (p_sum == 0) stop_prior_path[max_depth] = 1;
   else {
     for (int i = 0; i <= max_depth; ++i) {
-      stop_prior_path_[i] /= p_sum;
+      stop_prior_path[i] /= p_sum;
     }
   }
-  for (size_t i = max_depth + 1; i < stop_prior_path_.size(); ++i) {
-    stop_prior_path_[i] = 0;
+  for (size_t i = max_depth + 1; i < stop_prior_path.size(); ++i) {
+    stop_prior_path[i] = 0;
   }
 }
 void ContextTreeManager::CalcTestStopPriorPath(int word_depth) {
@@ -137,6 +153,20 @@ void ContextTreeManager::CalcTestStopPriorPath(int word_depth) {
     stop_prior_path_[i] = 0;
   }
 }
+int ContextTreeManager::CalcTestPredictives(Span<int> sent, int idx) {
+  int word_depth = 0;
+  if (sent.begin() == test_sent_ && idx == test_idx_ + 1) {
+    word_depth = ct_.AdvanceNoCreate(sent, idx - 1, test_depth_, node_path_);
+  } else {
+    word_depth = ct_.WalkTreeNoCreate(sent, idx - 1, 0, node_path_);
+  }
+  test_sent_ = sent.begin();
+  test_idx_ = idx;
+  test_depth_ = word_depth;
+  CalcTestStopPriorPath(word_depth);
+  rmanager_->CalcDepth2TopicPredictives(sent[idx], word_depth, true);
+  return word_depth;
+}
 void ContextTreeManager::ResamplingTableLabels() {
   auto& depth2nodes = GetDepth2Nodes();
   int label_changed = 0;
@@ -217,6 +247,9 @@ string ContextTreeManager::PrintDepth2Tables() {
 const std::vector<double>& ContextTreeManager::lambda_path() const {
   return lmanager_->lambda_path();
 }
+const std::vector<std::vector<double> >& ContextTreeManager::depth2topic_predictives() const {
+  return rmanager_->depth2topic_predictives();
+}
 const std::vector<Node*>& ContextTreeManager::current_node_path() const {
   return node_path_;
 }
@@ -225,9 +258,9 @@ const std::vector<std::pair<double, double> >& ContextTreeManager::cache_path()
 }
 void ContextTreeManager::set_table_based_sampler(TreeType tree_type, DocumentManager& dmanager) {
   if (tree_type == kGraphical) {
-    table_based_sampler_.reset(new GraphicalTableBasedSampler(parameters_, node_path_, *this, *lmanager_, dmanager));
+    table_based_sampler_.reset(new GraphicalTableBasedSampler(parameters_, node_path_, *this, *lmanager_, dmanager, context_));
   } else {
-    table_based_sampler_.reset(new NonGraphicalTableBasedSampler(parameters_, node_path_, *this, *lmanager_, dmanager));
+    table_based_sampler_.reset(new NonGraphicalTableBasedSampler(parameters_, node_path_, *this, *lmanager_, dmanager, context_));
   }
 }
 
@@ -240,5 +273,15 @@ TableBasedSampler& ContextTreeManager::tsampler() {
 const LambdaManagerInterface& ContextTreeManager::lmanager() const {
   return *lmanager_;
 }
+RestaurantManager* ContextTreeManager::NewRestaurantManager(
+    const std::vector<Node*>& node_path,
+    LambdaManagerInterface& lmanager,
+    SamplerContext& context) const {
+  if (tree_type_ == kGraphical) {
+    return new RestaurantManager(node_path, lmanager, parameters_, zero_order_pred_, context);
+  } else {
+    return new NonGraphicalRestaurantManager(node_path, lmanager, parameters_, zero_order_pred_, context);
+  }
+}
 
 } // topiclm
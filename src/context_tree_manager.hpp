@@ -6,6 +6,7 @@
 #include <pficommon/data/intern.h>
 #include "context_tree.hpp"
 #include "context_tree_analyzer.hpp"
+#include "test_predictor.hpp"
 
 namespace topiclm {
 
@@ -15,31 +16,43 @@ class Parameters;
 class RestaurantManager;
 class DocumentManager;
 class TableBasedSampler;
+class SamplerContext;
 
-class ContextTreeManager {
+class ContextTreeManager : public TestPredictor {
   friend class ContextTreeAnalyzer;
  public:
   ContextTreeManager(LambdaType lambda_type,
                      TreeType tree_type,
                      const Parameters& parameters,
                      int lexicon,
-                     int eos_id);
+                     int eos_id,
+                     SamplerContext& context);
   virtual ~ContextTreeManager();
 
-  int WalkTreeNoCreate(const std::vector<int>& sent,
+  int WalkTreeNoCreate(Span<int> sent,
                        int current_idx,
                        int current_depth);
-  int WalkTree(const std::vector<int>& sent,
+  int WalkTree(Span<int> sent,
                int current_idx,
                int current_depth,
                int target_depth); // return new depth  
   void UpTreeFromLeaf(Node* leaf, int node_depth);
-  void EraseEmptyNodes(int current_depth, int target_depth);
+  int EraseEmptyNodes(int current_depth, int target_depth); // return new depth
+  /**
+   * The path of the context preceding sent[current_idx + 1], moved from that
+   * preceding sent[current_idx] of depth prev_depth (see ContextTree::AdvanceNoCreate).
+   */
+  int AdvanceNoCreate(Span<int> sent, int current_idx, int prev_depth);
 
   void CalcLambdaPath(int word_depth);
 
   void CalcStopPriorPath(int word_depth, int max_depth);
+  void CalcStopPriorPath(const std::vector<Node*>& node_path,
+                         int word_depth,
+                         int max_depth,
+                         std::vector<double>& stop_prior_path) const;
   void CalcTestStopPriorPath(int word_depth);
+  virtual int CalcTestPredictives(Span<int> sent, int idx);
 
   void ResamplingTableLabels();
 
@@ -49,10 +62,11 @@ class ContextTreeManager {
 
   const std::vector<double>& stop_prior_path() const { return stop_prior_path_; }
   const std::vector<double>& lambda_path() const;
+  const std::vector<std::vector<double> >& depth2topic_predictives() const;
   ContextTreeAnalyzer GetCTAnalyzer(const pfi::data::intern<std::string>& intern) {
     return ContextTreeAnalyzer(*this, intern);
   }
-  const std::vector<std::set<Node*> >& GetDepth2Nodes() const { return ct_.depth2nodes(); }
+  const Depth2Nodes& GetDepth2Nodes() const { return ct_.depth2nodes(); }
   const std::vector<Node*>& current_node_path() const;
   const std::vector<std::pair<double, double> >& cache_path() const;
 
@@ -61,6 +75,19 @@ class ContextTreeManager {
   RestaurantManager& rmanager();
   TableBasedSampler& tsampler();
   const LambdaManagerInterface& lmanager() const;
+  const ContextTree& ct() const { return ct_; }
+  ContextTree& ct() { return ct_; }
+  TreeType tree_type() const { return tree_type_; }
+  double zero_order_pred() const { return zero_order_pred_; }
+
+  /**
+   * A restaurant manager which walks on the given node_path and computes
+   * lambdas with the given lmanager. Used by sampling workers, which read
+   * the tree concurrently with their own buffers and context.
+   */
+  RestaurantManager* NewRestaurantManager(const std::vector<Node*>& node_path,
+                                          LambdaManagerInterface& lmanager,
+                                          SamplerContext& context) const;
   
  private:
   ContextTree ct_;
@@ -69,6 +96,8 @@ class ContextTreeManager {
   std::unique_ptr<TableBasedSampler> table_based_sampler_;
   
   const Parameters& parameters_;
+  SamplerContext& context_;
+  const TreeType tree_type_;
   const int lexicon_;
   const int num_topics_;
   const double zero_order_pred_;
@@ -78,6 +107,11 @@ class ContextTreeManager {
   // buffer
   std::vector<Node*> node_path_;
   std::vector<double> stop_prior_path_;
+  // the sentence and the position of the last CalcTestPredictives, whose
+  // path is advanced if the next call is on the following word
+  const int* test_sent_;
+  int test_idx_;
+  int test_depth_;
 
   friend class pfi::data::serialization::access;
   template <typename Archive>
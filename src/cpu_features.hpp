@@ -0,0 +1,28 @@
+#ifndef _TOPICLM_CPU_FEATURES_HPP_
+#define _TOPICLM_CPU_FEATURES_HPP_
+
+/**
+ * Runtime dispatch of vectorized loops: a function marked TOPICLM_TARGET_AVX2
+ * is compiled for AVX2 whatever the flags of the build, and is only called
+ * when HasAvx2() tells that the CPU running it supports the instructions.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TOPICLM_AVX2_DISPATCH 1
+#define TOPICLM_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+namespace topiclm {
+
+inline bool HasAvx2() {
+#ifdef TOPICLM_AVX2_DISPATCH
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+#else
+  return false;
+#endif
+}
+
+} // namespace topiclm
+
+#endif /* _TOPICLM_CPU_FEATURES_HPP_ */
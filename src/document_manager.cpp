@@ -6,8 +6,6 @@ using namespace std;
 
 namespace topiclm {
 
-vector<double> DocumentManager::buffer_;
-
 void DocumentManager::Read(std::shared_ptr<Reader> reader) {
   // string unk_type = "__unk__";
   // intern_.clear();
@@ -15,16 +13,24 @@ void DocumentManager::Read(std::shared_ptr<Reader> reader) {
   // intern_.key2id(unk_type);
   // doc2token_seq_ = ReadDocs(fn, "__unk__", intern_, true);
 
-  doc2token_seq_ = reader->ReadDocuments(intern_);
-  
-  doc2topic_seq_ = doc2token_seq_;
-  for (auto& doc : doc2topic_seq_) {
-    for (auto& sent : doc) {
-      for (size_t i = 0; i < sent.size(); ++i) sent[i] = -1;
+  tokens_.clear();
+  sent_offsets_.assign(1, 0);
+  doc_offsets_.assign(1, 0);
+  for (vector<string> doc; !(doc = reader->NextDocument()).empty(); ) {
+    for (auto& sentence : doc) {
+      auto token_ids = reader->Read(intern_, sentence);
+      tokens_.insert(tokens_.end(), token_ids.begin(), token_ids.end());
+      sent_offsets_.push_back(tokens_.size());
     }
+    doc_offsets_.push_back(sent_offsets_.size() - 1);
   }
-  doc2topic_count_.resize(doc2token_seq_.size());
-  doc2topic2tables_.resize(doc2token_seq_.size());
+  tokens_.shrink_to_fit();
+  sent_offsets_.shrink_to_fit();
+  doc_offsets_.shrink_to_fit();
+  
+  doc2topic_count_.resize(num_docs());
+  doc2topics_.assign(num_docs(), {});
+  doc2topic2tables_.resize(num_docs());
   for (size_t i = 0; i < doc2topic_count_.size(); ++i) {
     doc2topic_count_[i].first = 0;
     doc2topic_count_[i].second.assign(num_topics_ + 1, 0);
@@ -34,16 +40,19 @@ void DocumentManager::Read(std::shared_ptr<Reader> reader) {
   BuildWords();
   cerr << "lexicon: " << intern_.size() << endl;
   cerr << "tokens: " << words_.size() << endl;
-  cerr << "documents: " << doc2token_seq_.size() << endl;
+  cerr << "documents: " << num_docs() << endl;
 }
 void DocumentManager::OutputTopicAssign(ostream& os) const {
-  for (auto& doc : doc2topic_seq_) {
-    for (auto& sent : doc) {
+  word_id_t word = 0; // words are in the corpus order, except the first token of each sentence
+  for (int d = 0; d < num_docs(); ++d) {
+    for (size_t s = doc_offsets_[d]; s < doc_offsets_[d + 1]; ++s) {
+      auto sent = sentence_at(s);
       for (size_t i = 0; i < sent.size(); ++i) {
-        if (sent[i] == -1) {
+        int topic = i == 0 ? -1 : words_.topic(word++);
+        if (topic == -1) {
           os << "- ";
         } else {
-          os << sent[i] << " ";
+          os << topic << " ";
         }
       }
       os << endl;
@@ -63,19 +72,18 @@ void DocumentManager::OutputTopicCount(ostream& os) const {
 
 vector<int> DocumentManager::GetUnigramCounts() const {
   vector<int> unigram_counts(lexicon());
-  for (auto& word : words_) {
-    ++unigram_counts[token(*word)];
+  for (word_id_t word = 0; word < words_.size(); ++word) {
+    ++unigram_counts[token(word)];
   }
   return unigram_counts;
 }
 
 void DocumentManager::BuildWords() {
   words_.clear();
-  for (size_t i = 0; i < doc2token_seq_.size(); ++i) {
-    auto& observed_seq = doc2token_seq_[i];
-    for (size_t j = 0; j < observed_seq.size(); ++j) {
-      for (size_t k = 1; k < observed_seq[j].size(); ++k) {
-        words_.push_back(std::make_shared<Word>(0, i, j, k));
+  for (int d = 0; d < num_docs(); ++d) {
+    for (size_t s = doc_offsets_[d]; s < doc_offsets_[d + 1]; ++s) {
+      for (size_t k = 1; k < sent_offsets_[s + 1] - sent_offsets_[s]; ++k) {
+        words_.Add(d, s, k);
       }
     }
   }
@@ -3,9 +3,11 @@
 
 #include <vector>
 #include <string>
+#include <algorithm>
 #include <pficommon/data/intern.h>
 #include "word.hpp"
-#include "random_util.hpp"
+#include "span.hpp"
+#include "sampler_context.hpp"
 #include "util.hpp"
 
 namespace topiclm {
@@ -15,18 +17,22 @@ class Reader;
 
 class DocumentManager {
  public:
-  DocumentManager() : num_topics_(0), ngram_order_(0) {}
+  DocumentManager()
+      : sent_offsets_(1, 0), doc_offsets_(1, 0), num_topics_(0), ngram_order_(0) {}
   DocumentManager(DocumentManager&& other) 
     : words_{std::move(other.words_)},
-      doc2token_seq_{std::move(other.doc2token_seq_)},
-      doc2topic_seq_{std::move(other.doc2topic_seq_)},
+      tokens_{std::move(other.tokens_)},
+      sent_offsets_{std::move(other.sent_offsets_)},
+      doc_offsets_{std::move(other.doc_offsets_)},
       doc2topic_count_{std::move(other.doc2topic_count_)},
+      doc2topics_{std::move(other.doc2topics_)},
       intern_{std::move(other.intern_)},
       num_topics_{other.num_topics_},
-      ngram_order_{ngram_order_}
+      ngram_order_{other.ngram_order_}
   {}
   DocumentManager(int num_topics, int ngram_order)
-      : num_topics_(num_topics), ngram_order_(ngram_order) {}
+      : sent_offsets_(1, 0), doc_offsets_(1, 0),
+        num_topics_(num_topics), ngram_order_(ngram_order) {}
   ~DocumentManager() {}
   
   void Read(std::shared_ptr<Reader> reader);
@@ -43,7 +49,9 @@ class DocumentManager {
         AddCustomer(doc_id, topic, alpha_k);
       }
     }
-    ++doc2topic_count_[doc_id].second[topic];
+    if (++doc2topic_count_[doc_id].second[topic] == 1) {
+      doc2topics_[doc_id].push_back(topic);
+    }
   }
   void DecrementTopicCount(int doc_id,
                            int topic,
@@ -52,7 +60,14 @@ class DocumentManager {
       assert(--doc2topic_count_[doc_id].first >= 0);
       RemoveCustomer(doc_id, topic);
     }
-    assert(--doc2topic_count_[doc_id].second[topic] >= 0);
+    int count = --doc2topic_count_[doc_id].second[topic];
+    assert(count >= 0);
+    if (count == 0) {
+      auto& topics = doc2topics_[doc_id];
+      auto it = std::find(topics.begin(), topics.end(), topic);
+      *it = topics.back();
+      topics.pop_back();
+    }
   }
   void AddCustomer(int doc_id, int topic, double alpha_k) {
     if (doc2topic_count_[doc_id].first == 1) {
@@ -61,12 +76,14 @@ class DocumentManager {
       return;
     }
     auto& tables = doc2topic2tables_[doc_id][topic];
-    if (buffer_.size() <= tables.size() + 1) {
-      buffer_.resize(tables.size() + 1);
+    auto& context = SamplerContext::current();
+    auto& table_pdf = context.doc_table_pdf();
+    if (table_pdf.size() <= tables.size() + 1) {
+      table_pdf.resize(tables.size() + 1);
     }
-    for (size_t i = 0; i < tables.size(); ++i) buffer_[i] = tables[i];
-    buffer_[tables.size()] = alpha_k;
-    size_t sample = random->SampleUnnormalizedPdfRef(buffer_, tables.size());
+    for (size_t i = 0; i < tables.size(); ++i) table_pdf[i] = tables[i];
+    table_pdf[tables.size()] = alpha_k;
+    size_t sample = context.random().SampleUnnormalizedPdfRef(table_pdf, tables.size());
     if (sample == tables.size()) {
       tables.push_back(1);
     } else {
@@ -81,11 +98,13 @@ class DocumentManager {
       return;
     }
     auto& tables = doc2topic2tables_[doc_id][topic];
-    if (buffer_.size() <= tables.size()) {
-      buffer_.resize(tables.size());
+    auto& context = SamplerContext::current();
+    auto& table_pdf = context.doc_table_pdf();
+    if (table_pdf.size() <= tables.size()) {
+      table_pdf.resize(tables.size());
     }
-    for (size_t i = 0; i < tables.size(); ++i) buffer_[i] = tables[i];
-    auto sample = random->SampleUnnormalizedPdfRef(buffer_, tables.size() - 1);
+    for (size_t i = 0; i < tables.size(); ++i) table_pdf[i] = tables[i];
+    auto sample = context.random().SampleUnnormalizedPdfRef(table_pdf, tables.size() - 1);
     if (--tables[sample] == 0) {
       EraseAndShrink(tables, tables.begin() + sample);
     }
@@ -94,7 +113,7 @@ class DocumentManager {
   std::vector<int> GetUnigramCounts() const;
 
   int num_words() const { return words_.size(); }
-  int num_docs() const { return doc2token_seq_.size(); }
+  int num_docs() const { return doc_offsets_.size() - 1; }
   int lexicon() const { return intern_.size(); }
 
   int eos_id() { return intern_.key2id(kEosKey); }
@@ -105,36 +124,39 @@ class DocumentManager {
   const std::vector<std::pair<int, std::vector<int> > >& doc2topic_count() const {
     return doc2topic_count_;
   }
+  /**
+   * Topics with nonzero second of doc2topic_count, in no particular order.
+   */
+  const std::vector<std::vector<topic_t> >& doc2topics() const { return doc2topics_; }
   const std::vector<std::vector<std::vector<int> > >& doc2topic2tables() const {
     return doc2topic2tables_;
   }
-  const std::shared_ptr<Word> word(int word_idx) { return words_[word_idx]; }
-  int token(const Word& word) const {
-    return doc2token_seq_[word.doc_id][word.sent_idx][word.token_idx];
-  }
-  int topic(const Word& word) const {
-    return doc2topic_seq_[word.doc_id][word.sent_idx][word.token_idx];
+  WordTable& words() { return words_; }
+  const WordTable& words() const { return words_; }
+  int token(word_id_t word) const {
+    return tokens_[sent_offsets_[words_.sent_id(word)] + words_.token_idx(word)];
   }
-  const std::vector<int>& sentence(const Word& word) const {
-    return doc2token_seq_[word.doc_id][word.sent_idx];
+  int topic(word_id_t word) const { return words_.topic(word); }
+  Span<int> sentence(word_id_t word) const { return sentence_at(words_.sent_id(word)); }
+  Span<int> sentence_at(int sent_id) const {
+    return {tokens_.data() + sent_offsets_[sent_id], tokens_.data() + sent_offsets_[sent_id + 1]};
   }
 
-  void set_topic(Word& word, int topic) {
-    doc2topic_seq_[word.doc_id][word.sent_idx][word.token_idx] = topic;
-  }
+  void set_topic(word_id_t word, int topic) { words_.set_topic(word, topic); }
 
  private:
   void BuildWords();
   
-  std::vector<std::shared_ptr<Word> > words_;
-  std::vector<std::vector<std::vector<int> > > doc2token_seq_;
-  std::vector<std::vector<std::vector<int> > > doc2topic_seq_;
+  WordTable words_;
+  // packed corpus (compressed sparse rows): all sentences in a row in tokens_
+  std::vector<int> tokens_;
+  std::vector<uint32_t> sent_offsets_; // [sent_id] -> first token, [num sentences] -> end
+  std::vector<uint32_t> doc_offsets_; // [doc_id] -> first sentence, [num_docs] -> end
   
   std::vector<std::pair<int, std::vector<int> > > doc2topic_count_;
+  std::vector<std::vector<topic_t> > doc2topics_; // sparse view of doc2topic_count_
   std::vector<std::vector<std::vector<int> > > doc2topic2tables_;
 
-  static std::vector<double> buffer_;
-
   pfi::data::intern<std::string> intern_;
   const int num_topics_;
   const int ngram_order_;
@@ -1,6 +1,7 @@
 #include "util.hpp"
 #include "random_util.hpp"
 #include "floor_sampler.hpp"
+#include "sampler_context.hpp"
 
 using namespace std;
 
@@ -109,8 +110,8 @@ double TopicPriorCalculator::log_p(
  * FloorSampler
  *
  *==================================*/
-FloorSampler::FloorSampler(size_t num_topics, bool include_zero)
-  : pdf_(num_topics + 1), include_zero_(include_zero) {}
+FloorSampler::FloorSampler(size_t num_topics, bool include_zero, SamplerContext& context)
+  : pdf_(num_topics + 1), include_zero_(include_zero), context_(context) {}
 
 void FloorSampler::ResetArrangementCache(const vector<double>& depth2discounts,
                                          const vector<double>& depth2concentrations) {
@@ -204,7 +205,7 @@ int FloorSampler::Sample(int current) {
   }
   if (!include_zero_) pdf_[0] = -INFINITY;
   normalize_logpdf(pdf_.begin(), pdf_.end());
-  return random->SampleUnnormalizedPdfRef(pdf_);
+  return context_.random().SampleUnnormalizedPdfRef(pdf_);
 }
 
 } // topiclm
@@ -12,6 +12,8 @@
 
 namespace topiclm {
 
+class SamplerContext;
+
 class CachedVector {
  public:
   virtual double redidual(int i) = 0;
@@ -108,7 +110,7 @@ class TopicPriorCalculator {
 
 class FloorSampler {
  public:
-  FloorSampler(size_t num_topics, bool include_zero);
+  FloorSampler(size_t num_topics, bool include_zero, SamplerContext& context);
   
   // should be called when the hyper parameters is changed.
   void ResetArrangementCache(const std::vector<double>& depth2discounts,
@@ -145,6 +147,7 @@ class FloorSampler {
  private:
   std::vector<double> pdf_;
   bool include_zero_;
+  SamplerContext& context_;
   std::vector<std::unique_ptr<SeatingArrangementProbCalculator> > arrangement_part_;
   std::unique_ptr<TopicPriorCalculator> topic_part_;
   
@@ -0,0 +1,80 @@
+#ifndef _TOPICLM_FROZEN_ARRAY_HPP_
+#define _TOPICLM_FROZEN_ARRAY_HPP_
+
+#include <vector>
+#include <cassert>
+#include "serialization.hpp"
+
+namespace topiclm {
+
+/**
+ * Read-only array of a FrozenModel, either owning its elements (built by
+ * compilation or read from an archive) or viewing a mapped model image.
+ * Serialized as a std::vector.
+ */
+template <typename T>
+class FrozenArray {
+ public:
+  FrozenArray() : data_(nullptr), size_(0), mapped_(false) {}
+  FrozenArray(const FrozenArray&) = delete;
+  FrozenArray& operator=(const FrozenArray&) = delete;
+
+  const T* begin() const { return data_; }
+  const T* end() const { return data_ + size_; }
+  const T* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T& operator[](size_t i) const { return data_[i]; }
+  bool mapped() const { return mapped_; }
+
+  void push_back(const T& value) {
+    assert(!mapped_);
+    owned_.push_back(value);
+    Own();
+  }
+  template <typename Iter>
+  void assign(Iter begin, Iter end) {
+    owned_.assign(begin, end);
+    mapped_ = false;
+    Own();
+  }
+  /**
+   * View size elements at data, which must outlive this array.
+   */
+  void Map(const T* data, size_t size) {
+    std::vector<T>().swap(owned_);
+    data_ = data;
+    size_ = size;
+    mapped_ = true;
+  }
+
+ private:
+  void Own() {
+    data_ = owned_.data();
+    size_ = owned_.size();
+  }
+
+  const T* data_;
+  size_t size_;
+  bool mapped_;
+  std::vector<T> owned_;
+
+  friend class pfi::data::serialization::access;
+  template <class Archive>
+  void serialize(Archive& ar) {
+    if (ar.is_read) {
+      ar & owned_;
+      mapped_ = false;
+      Own();
+    } else if (mapped_) {
+      std::vector<T> elements(begin(), end());
+      ar & elements;
+    } else {
+      ar & owned_;
+    }
+  }
+};
+
+} // topiclm
+
+#endif /* _TOPICLM_FROZEN_ARRAY_HPP_ */
@@ -0,0 +1,497 @@
+#include <algorithm>
+#include <cstring>
+#include "frozen_model.hpp"
+#include "mapped_image.hpp"
+#include "test_predictive_cache.hpp"
+#include "context_tree_manager.hpp"
+#include "parameters.hpp"
+#include "node.hpp"
+
+using namespace std;
+
+namespace topiclm {
+
+FrozenModel::FrozenModel(const ContextTreeManager& cmanager,
+                         const Parameters& parameters,
+                         LambdaType lambda_type)
+    : num_topics_(parameters.topic_parameter().num_topics),
+      ngram_order_(parameters.ngram_order()),
+      eos_id_(cmanager.ct().eos_id()),
+      tree_type_(cmanager.tree_type()),
+      zero_order_pred_(cmanager.zero_order_pred()),
+      zero_order_predictives_(num_topics_ + 1, zero_order_pred_) {
+  if (lambda_type != kHierarchical) {
+    throw string("only models with hierarchical lambdas can be compiled");
+  }
+  auto& hpy_parameter = parameters.hpy_parameter();
+  for (int depth = 0; depth < ngram_order_; ++depth) {
+    for (int floor_id = 0; floor_id <= num_topics_; ++floor_id) {
+      discounts_.push_back(hpy_parameter.discount(depth, floor_id));
+      concentrations_.push_back(hpy_parameter.concentration(depth, floor_id));
+    }
+  }
+  prior_stop_ = hpy_parameter.prior_stop();
+  prior_pass_ = hpy_parameter.prior_pass();
+  auto& lambda_parameter = parameters.lambda_parameter();
+  root_lambda_ = lambda_parameter.a / (lambda_parameter.a + lambda_parameter.b);
+  lambda_c_.assign(lambda_parameter.c.begin(), lambda_parameter.c.end());
+
+  vector<Node*> nodes(1, cmanager.ct().root());
+  node_types_.push_back(nodes[0]->type());
+  floor_begin_.push_back(0);
+  type_begin_.push_back(0);
+  section_begin_.push_back(0);
+  vector<int> types;
+  for (size_t n = 0; n < nodes.size(); ++n) {
+    Node* node = nodes[n];
+    child_begin_.push_back(nodes.size());
+    for (auto& type2child : node->children()) {
+      nodes.push_back(type2child.second);
+      node_types_.push_back(type2child.first);
+    }
+
+    auto& restaurant = node->restaurant();
+    stop_customers_.push_back(restaurant.stop_customers());
+    pass_customers_.push_back(restaurant.pass_customers());
+    local_labeled_tables_.push_back(restaurant.local_labeled_tables());
+    global_labeled_tables_.push_back(restaurant.global_labeled_tables());
+
+    for (auto& floor2c_t : restaurant.floor2c_t()) {
+      floor_ids_.push_back(floor2c_t.first);
+      floor_customers_.push_back(floor2c_t.second.first);
+      floor_tables_.push_back(floor2c_t.second.second);
+    }
+    floor_begin_.push_back(floor_ids_.size());
+
+    // the type index of a restaurant is not sorted once it is hashed
+    auto& type2internal = restaurant.type2internal();
+    types.clear();
+    for (auto& kv : type2internal) {
+      types.push_back(kv.first);
+    }
+    sort(types.begin(), types.end());
+    for (int type : types) {
+      types_.push_back(type);
+      for (auto& section : (*type2internal.find(type)).second.sections()) {
+        section_floors_.push_back(section.first);
+        section_customers_.push_back(section.second.customers);
+        section_tables_.push_back(section.second.tables);
+      }
+      section_begin_.push_back(section_floors_.size());
+    }
+    type_begin_.push_back(types_.size());
+  }
+  child_begin_.push_back(nodes.size());
+}
+
+size_t FrozenModel::memory_size() const {
+  return sizeof(double) * (discounts_.size() + concentrations_.size() + lambda_c_.size())
+      + sizeof(int32_t) * (node_types_.size() + stop_customers_.size() + pass_customers_.size()
+                           + local_labeled_tables_.size() + global_labeled_tables_.size()
+                           + floor_customers_.size() + floor_tables_.size() + types_.size()
+                           + section_customers_.size() + section_tables_.size())
+      + sizeof(uint32_t) * (child_begin_.size() + floor_begin_.size()
+                            + type_begin_.size() + section_begin_.size())
+      + sizeof(topic_t) * (floor_ids_.size() + section_floors_.size());
+}
+
+namespace {
+
+const int kNumImageArrays = 19;
+
+struct FrozenImageHeader {
+  int32_t num_topics;
+  int32_t ngram_order;
+  int32_t eos_id;
+  int32_t tree_type;
+  double zero_order_pred;
+  double prior_stop;
+  double prior_pass;
+  double root_lambda;
+  uint32_t num_arrays;
+  uint32_t reserved;
+  struct {
+    uint64_t offset; // from the beginning of the header
+    uint64_t size;   // # elements
+  } arrays[kNumImageArrays];
+};
+
+struct ImageLayout {
+  FrozenImageHeader& header;
+  uint64_t offset;
+  int i;
+  template <typename T>
+  void operator()(const FrozenArray<T>& array) {
+    header.arrays[i].offset = offset;
+    header.arrays[i].size = array.size();
+    offset = AlignImageOffset(offset + sizeof(T) * array.size());
+    ++i;
+  }
+};
+
+struct ImageArrayWriter {
+  ImageWriter& writer;
+  template <typename T>
+  void operator()(const FrozenArray<T>& array) {
+    writer.Align();
+    writer.Write(array.data(), sizeof(T) * array.size());
+  }
+};
+
+struct ImageArrayMapper {
+  const FrozenImageHeader& header;
+  const char* data;
+  size_t size;
+  int i;
+  template <typename T>
+  void operator()(FrozenArray<T>& array) {
+    uint64_t offset = header.arrays[i].offset;
+    uint64_t num_elements = header.arrays[i].size;
+    if (offset % kImageAlignment != 0 || offset > size
+        || num_elements > (size - offset) / sizeof(T)) {
+      throw std::string("broken frozen model image");
+    }
+    array.Map(reinterpret_cast<const T*>(data + offset), num_elements);
+    ++i;
+  }
+};
+
+// begin is the CSR index of num_entries entries into num_elements elements
+bool IsIndex(const FrozenArray<uint32_t>& begin, size_t num_entries, size_t num_elements) {
+  if (begin.size() != num_entries + 1 || begin[num_entries] != num_elements) {
+    return false;
+  }
+  for (size_t i = 0; i < num_entries; ++i) {
+    if (begin[i] > begin[i + 1]) return false;
+  }
+  return true;
+}
+
+bool AreTopics(const FrozenArray<topic_t>& floors, int num_topics) {
+  for (auto floor_id : floors) {
+    if (floor_id < 0 || floor_id > num_topics) return false;
+  }
+  return true;
+}
+
+} // namespace
+
+template <class Model, class Visitor>
+void FrozenModel::VisitArrays(Model& model, Visitor& visitor) {
+  visitor(model.discounts_);
+  visitor(model.concentrations_);
+  visitor(model.lambda_c_);
+  visitor(model.node_types_);
+  visitor(model.child_begin_);
+  visitor(model.stop_customers_);
+  visitor(model.pass_customers_);
+  visitor(model.local_labeled_tables_);
+  visitor(model.global_labeled_tables_);
+  visitor(model.floor_begin_);
+  visitor(model.floor_ids_);
+  visitor(model.floor_customers_);
+  visitor(model.floor_tables_);
+  visitor(model.type_begin_);
+  visitor(model.types_);
+  visitor(model.section_begin_);
+  visitor(model.section_floors_);
+  visitor(model.section_customers_);
+  visitor(model.section_tables_);
+}
+
+void FrozenModel::WriteImage(ImageWriter& writer) const {
+  FrozenImageHeader header;
+  memset(&header, 0, sizeof(header));
+  header.num_topics = num_topics_;
+  header.ngram_order = ngram_order_;
+  header.eos_id = eos_id_;
+  header.tree_type = int32_t(tree_type_);
+  header.zero_order_pred = zero_order_pred_;
+  header.prior_stop = prior_stop_;
+  header.prior_pass = prior_pass_;
+  header.root_lambda = root_lambda_;
+  header.num_arrays = kNumImageArrays;
+  ImageLayout layout = {header, AlignImageOffset(sizeof(header)), 0};
+  VisitArrays(*this, layout);
+
+  writer.Align();
+  writer.Write(&header, sizeof(header));
+  ImageArrayWriter array_writer = {writer};
+  VisitArrays(*this, array_writer);
+}
+
+void FrozenModel::MapImage(const char* data, size_t size) {
+  if (size < sizeof(FrozenImageHeader)) {
+    throw std::string("broken frozen model image");
+  }
+  auto& header = *reinterpret_cast<const FrozenImageHeader*>(data);
+  if (header.num_arrays != kNumImageArrays) {
+    throw std::string("broken frozen model image");
+  }
+  num_topics_ = header.num_topics;
+  ngram_order_ = header.ngram_order;
+  eos_id_ = header.eos_id;
+  tree_type_ = TreeType(header.tree_type);
+  zero_order_pred_ = header.zero_order_pred;
+  prior_stop_ = header.prior_stop;
+  prior_pass_ = header.prior_pass;
+  root_lambda_ = header.root_lambda;
+  ImageArrayMapper mapper = {header, data, size, 0};
+  VisitArrays(*this, mapper);
+  if (!IsConsistent()) {
+    throw std::string("broken frozen model image");
+  }
+  zero_order_predictives_.assign(num_topics_ + 1, zero_order_pred_);
+}
+
+bool FrozenModel::IsConsistent() const {
+  if (num_topics_ <= 0 || ngram_order_ <= 0
+      || (tree_type_ != kGraphical && tree_type_ != kNonGraphical)) {
+    return false;
+  }
+  size_t num_hyperparameters = size_t(ngram_order_) * (num_topics_ + 1);
+  if (discounts_.size() != num_hyperparameters
+      || concentrations_.size() != num_hyperparameters
+      || lambda_c_.size() < size_t(ngram_order_)) {
+    return false;
+  }
+  size_t num_nodes = node_types_.size();
+  if (num_nodes == 0
+      || stop_customers_.size() != num_nodes
+      || pass_customers_.size() != num_nodes
+      || local_labeled_tables_.size() != num_nodes
+      || global_labeled_tables_.size() != num_nodes) {
+    return false;
+  }
+  // children come after their parent in BFS order, and the walk from the
+  // root never goes deeper than the buffers of a predictor
+  if (!IsIndex(child_begin_, num_nodes, num_nodes)) return false;
+  vector<int> depths(num_nodes, 0);
+  for (size_t n = 0; n < num_nodes; ++n) {
+    if (child_begin_[n] <= n && child_begin_[n] != child_begin_[n + 1]) return false;
+    for (uint32_t c = child_begin_[n]; c < child_begin_[n + 1]; ++c) {
+      depths[c] = depths[n] + 1;
+      if (depths[c] >= ngram_order_) return false;
+    }
+  }
+  if (!IsIndex(floor_begin_, num_nodes, floor_ids_.size())
+      || floor_customers_.size() != floor_ids_.size()
+      || floor_tables_.size() != floor_ids_.size()
+      || !AreTopics(floor_ids_, num_topics_)) {
+    return false;
+  }
+  if (!IsIndex(type_begin_, num_nodes, types_.size())
+      || !IsIndex(section_begin_, types_.size(), section_floors_.size())
+      || section_customers_.size() != section_floors_.size()
+      || section_tables_.size() != section_floors_.size()
+      || !AreTopics(section_floors_, num_topics_)) {
+    return false;
+  }
+  return true;
+}
+
+int FrozenModel::child(int node, int type) const {
+  auto begin = node_types_.begin() + child_begin_[node];
+  auto end = node_types_.begin() + child_begin_[node + 1];
+  auto it = lower_bound(begin, end, type);
+  return (it != end && *it == type) ? it - node_types_.begin() : -1;
+}
+
+int FrozenModel::WalkTree(Span<int> sent, int idx, vector<int>& node_path) const {
+  int current = 0;
+  int current_depth = 0;
+  node_path[0] = current;
+  for (;; --idx, ++current_depth) {
+    int t = (idx >= 0) ? sent[idx] : eos_id_;
+    int child_node = child(current, t);
+    if (child_node < 0) {
+      return current_depth;
+    }
+    current = child_node;
+    node_path[current_depth + 1] = current;
+  }
+  return current_depth;
+}
+
+void FrozenModel::CalcTestStopPriorPath(const vector<int>& node_path,
+                                        int word_depth,
+                                        vector<double>& stop_prior_path) const {
+  double pass_prob = 1;
+  double p_sum = 0;
+  for (int i = 0; i <= word_depth; ++i) {
+    int node = node_path[i];
+    double node_stop_prob = (stop_customers_[node] + prior_stop_)
+        / (stop_customers_[node] + pass_customers_[node] + prior_stop_ + prior_pass_);
+    stop_prior_path[i] = pass_prob * node_stop_prob;
+    pass_prob *= (1 - node_stop_prob);
+    p_sum += stop_prior_path[i];
+  }
+  if (p_sum == 0) stop_prior_path[word_depth] = 1;
+  else {
+    for (int i = 0; i <= word_depth; ++i) {
+      stop_prior_path[i] /= p_sum;
+    }
+  }
+  for (size_t i = word_depth + 1; i < stop_prior_path.size(); ++i) {
+    stop_prior_path[i] = 0;
+  }
+}
+
+void FrozenModel::CalcLambdaPath(const vector<int>& node_path,
+                                 int word_depth,
+                                 vector<double>& lambda_path) const {
+  double lambda = root_lambda_;
+  for (int j = 0; j <= word_depth; ++j) {
+    double c = lambda_c_[j];
+    double local_tables = local_labeled_tables_[node_path[j]];
+    double global_tables = global_labeled_tables_[node_path[j]];
+    lambda = (local_tables + c * lambda) / (local_tables + global_tables + c);
+    lambda_path[j] = lambda;
+  }
+  for (size_t j = word_depth + 1; j < lambda_path.size(); ++j) {
+    lambda_path[j] = lambda_path[j - 1];
+  }
+}
+
+void FrozenModel::CalcDepth2TopicPredictives(int type,
+                                             const vector<int>& node_path,
+                                             int word_depth,
+                                             const vector<double>& lambda_path,
+                                             vector<vector<double> >& depth2topic_predictives,
+                                             vector<int>& floor_customers) const {
+  auto parent_predictives = &zero_order_predictives_;
+  for (int i = 0; i <= word_depth; ++i) {
+    if (tree_type_ == kGraphical) {
+      FillInPredictives(node_path[i], type, i, lambda_path[i], *parent_predictives,
+                        depth2topic_predictives[i], floor_customers);
+    } else {
+      FillInPredictivesNonGraphical(node_path[i], type, i, *parent_predictives,
+                                    depth2topic_predictives[i], floor_customers);
+    }
+    parent_predictives = &depth2topic_predictives[i];
+  }
+  for (size_t i = word_depth + 1; i < depth2topic_predictives.size(); ++i) {
+    fill(depth2topic_predictives[i].begin(), depth2topic_predictives[i].end(), 0.0);
+  }
+}
+
+pair<uint32_t, uint32_t> FrozenModel::FindSections(int node, int type) const {
+  auto begin = types_.begin() + type_begin_[node];
+  auto end = types_.begin() + type_begin_[node + 1];
+  auto it = lower_bound(begin, end, type);
+  if (it == end || *it != type) return {0, 0};
+  size_t entry = it - types_.begin();
+  return {section_begin_[entry], section_begin_[entry + 1]};
+}
+
+// same computation as Restaurant::FillInPredictives
+void FrozenModel::FillInPredictives(int node,
+                                    int type,
+                                    int depth,
+                                    double lambda,
+                                    const vector<double>& parent_predictives,
+                                    vector<double>& predictives,
+                                    vector<int>& floor_customers) const {
+  uint32_t floor_it = floor_begin_[node];
+  uint32_t floor_end = floor_begin_[node + 1];
+  auto sections = FindSections(node, type);
+  predictives[0] = parent_predictives[0];
+  if (floor_it == floor_end) {
+    for (size_t i = 1; i < predictives.size(); ++i) {
+      predictives[i] = lambda * parent_predictives[i] + (1 - lambda) * predictives[0];
+    }
+    return;
+  }
+  if (floor_ids_[floor_it] == 0) {
+    int c = floor_customers_[floor_it];
+    int t = floor_tables_[floor_it];
+    predictives[0] *= (concentration(depth, 0) + discount(depth, 0) * t) / (c + concentration(depth, 0));
+    if (sections.first != sections.second && section_floors_[sections.first] == 0) {
+      int cw = section_customers_[sections.first];
+      int tw = section_tables_[sections.first];
+      predictives[0] += (cw - discount(depth, 0) * tw) / (c + concentration(depth, 0));
+    }
+    ++floor_it;
+  }
+  for (size_t i = 1; i < predictives.size(); ++i) {
+    predictives[i] = lambda * parent_predictives[i] + (1 - lambda) * predictives[0];
+  }
+  for (; floor_it != floor_end; ++floor_it) {
+    auto floor_id = floor_ids_[floor_it];
+    floor_customers[floor_id] = floor_customers_[floor_it];
+    predictives[floor_id] *=
+        (concentration(depth, floor_id) + discount(depth, floor_id) * floor_tables_[floor_it])
+        / (floor_customers_[floor_it] + concentration(depth, floor_id));
+  }
+  uint32_t section_it = sections.first;
+  if (section_it != sections.second && section_floors_[section_it] == 0) {
+    ++section_it;
+  }
+  for (; section_it != sections.second; ++section_it) {
+    auto floor_id = section_floors_[section_it];
+    int cw = section_customers_[section_it];
+    int tw = section_tables_[section_it];
+    predictives[floor_id] +=
+        (cw - discount(depth, floor_id) * tw)
+        / (floor_customers[floor_id] + concentration(depth, floor_id));
+  }
+}
+
+// same computation as Restaurant::FillInPredictivesNonGraphical
+void FrozenModel::FillInPredictivesNonGraphical(int node,
+                                                int type,
+                                                int depth,
+                                                const vector<double>& parent_predictives,
+                                                vector<double>& predictives,
+                                                vector<int>& floor_customers) const {
+  for (size_t i = 0; i < parent_predictives.size(); ++i) {
+    predictives[i] = parent_predictives[i];
+  }
+  for (uint32_t floor_it = floor_begin_[node]; floor_it != floor_begin_[node + 1]; ++floor_it) {
+    auto floor_id = floor_ids_[floor_it];
+    floor_customers[floor_id] = floor_customers_[floor_it];
+    predictives[floor_id] *=
+        (concentration(depth, floor_id) + discount(depth, floor_id) * floor_tables_[floor_it])
+        / (floor_customers_[floor_it] + concentration(depth, floor_id));
+  }
+  auto sections = FindSections(node, type);
+  for (uint32_t section_it = sections.first; section_it != sections.second; ++section_it) {
+    auto floor_id = section_floors_[section_it];
+    int cw = section_customers_[section_it];
+    int tw = section_tables_[section_it];
+    predictives[floor_id] +=
+        (cw - discount(depth, floor_id) * tw)
+        / (floor_customers[floor_id] + concentration(depth, floor_id));
+  }
+}
+
+FrozenPredictor::FrozenPredictor(const FrozenModel& model, TestPredictiveCache* cache)
+    : model_(model),
+      cache_(cache),
+      node_path_(model.ngram_order(), 0),
+      stop_prior_path_(model.ngram_order()),
+      lambda_path_(model.ngram_order()),
+      depth2topic_predictives_(model.ngram_order(),
+                               vector<double>(model.num_topics() + 1)),
+      floor_customers_(model.num_topics() + 1) {}
+
+int FrozenPredictor::CalcTestPredictives(Span<int> sent, int idx) {
+  int word_depth = model_.WalkTree(sent, idx - 1, node_path_);
+  int node = node_path_[word_depth];
+  if (cache_ != nullptr
+      && cache_->Find(node, sent[idx], word_depth,
+                      stop_prior_path_, lambda_path_, depth2topic_predictives_)) {
+    return word_depth;
+  }
+  model_.CalcTestStopPriorPath(node_path_, word_depth, stop_prior_path_);
+  model_.CalcLambdaPath(node_path_, word_depth, lambda_path_);
+  model_.CalcDepth2TopicPredictives(sent[idx], node_path_, word_depth, lambda_path_,
+                                    depth2topic_predictives_, floor_customers_);
+  if (cache_ != nullptr) {
+    cache_->Insert(node, sent[idx], word_depth,
+                   stop_prior_path_, lambda_path_, depth2topic_predictives_);
+  }
+  return word_depth;
+}
+
+} // topiclm
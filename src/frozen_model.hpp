@@ -0,0 +1,233 @@
+#ifndef _TOPICLM_FROZEN_MODEL_HPP_
+#define _TOPICLM_FROZEN_MODEL_HPP_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "config.hpp"
+#include "serialization.hpp"
+#include "span.hpp"
+#include "frozen_array.hpp"
+#include "test_predictor.hpp"
+
+namespace topiclm {
+
+class ContextTreeManager;
+class Parameters;
+class ImageWriter;
+class TestPredictiveCache;
+
+/**
+ * Read-only copy of a trained context tree for prediction.
+ *
+ * Only the counts used in test mode are kept, in contiguous arrays indexed by
+ * node ids in BFS order (the root is 0). The children of a node have
+ * consecutive ids and are sorted by their type; floor totals (c, t) of a node
+ * and per-type sections (cw, tw) are stored in CSR form, types sorted within
+ * a node. The results are identical to those of ContextTreeManager and the
+ * restaurant managers in test mode.
+ *
+ * All methods are const and take the buffers of the caller, so one model can
+ * be shared among threads. Only hierarchical lambdas are supported.
+ *
+ * Besides the archive format, a model can be written as an image whose
+ * arrays are used in place after mapping the file (see MapImage).
+ */
+class FrozenModel {
+ public:
+  FrozenModel() : num_topics_(0), ngram_order_(0), eos_id_(-1), tree_type_(kGraphical) {}
+  FrozenModel(const ContextTreeManager& cmanager,
+              const Parameters& parameters,
+              LambdaType lambda_type);
+
+  int num_nodes() const { return node_types_.size(); }
+  int num_topics() const { return num_topics_; }
+  int ngram_order() const { return ngram_order_; }
+  int eos_id() const { return eos_id_; }
+  // the type on the edge from the parent
+  int node_type(int node) const { return node_types_[node]; }
+  // the children of node are [child_begin(node), child_end(node))
+  int child_begin(int node) const { return child_begin_[node]; }
+  int child_end(int node) const { return child_begin_[node + 1]; }
+  TreeType tree_type() const { return tree_type_; }
+  /**
+   * bytes held by the arrays
+   */
+  size_t memory_size() const;
+
+  void WriteImage(ImageWriter& writer) const;
+  /**
+   * Use the image of size bytes at data (aligned to kImageAlignment) in
+   * place; it must outlive this model.
+   */
+  void MapImage(const char* data, size_t size);
+
+  /**
+   * returns the node id, or -1 if there is no such child
+   */
+  int child(int node, int type) const;
+  /**
+   * Walk the context preceding sent[idx] from the root into node_path (as
+   * ContextTree::WalkTreeNoCreate). Returns the word depth.
+   */
+  int WalkTree(Span<int> sent, int idx, std::vector<int>& node_path) const;
+  void CalcTestStopPriorPath(const std::vector<int>& node_path,
+                             int word_depth,
+                             std::vector<double>& stop_prior_path) const;
+  void CalcLambdaPath(const std::vector<int>& node_path,
+                      int word_depth,
+                      std::vector<double>& lambda_path) const;
+  // floor_customers is a buffer of (# topics + 1) elements
+  void CalcDepth2TopicPredictives(int type,
+                                  const std::vector<int>& node_path,
+                                  int word_depth,
+                                  const std::vector<double>& lambda_path,
+                                  std::vector<std::vector<double> >& depth2topic_predictives,
+                                  std::vector<int>& floor_customers) const;
+
+ private:
+  double discount(int depth, int floor_id) const {
+    return discounts_[depth * (num_topics_ + 1) + floor_id];
+  }
+  double concentration(int depth, int floor_id) const {
+    return concentrations_[depth * (num_topics_ + 1) + floor_id];
+  }
+  template <class Model, class Visitor>
+  static void VisitArrays(Model& model, Visitor& visitor);
+  /**
+   * Whether the sizes of the arrays agree and every index stays inside the
+   * array it points into (checked on the arrays of an image)
+   */
+  bool IsConsistent() const;
+
+  // [begin, end) of the sections of type in node; empty if not found
+  std::pair<uint32_t, uint32_t> FindSections(int node, int type) const;
+  void FillInPredictives(int node,
+                         int type,
+                         int depth,
+                         double lambda,
+                         const std::vector<double>& parent_predictives,
+                         std::vector<double>& predictives,
+                         std::vector<int>& floor_customers) const;
+  void FillInPredictivesNonGraphical(int node,
+                                     int type,
+                                     int depth,
+                                     const std::vector<double>& parent_predictives,
+                                     std::vector<double>& predictives,
+                                     std::vector<int>& floor_customers) const;
+
+  int num_topics_;
+  int ngram_order_;
+  int eos_id_;
+  TreeType tree_type_;
+  double zero_order_pred_;
+
+  // hyperparameters, [depth * (num_topics + 1) + floor]
+  FrozenArray<double> discounts_;
+  FrozenArray<double> concentrations_;
+  double prior_stop_;
+  double prior_pass_;
+  double root_lambda_;
+  FrozenArray<double> lambda_c_;
+
+  // nodes
+  FrozenArray<int32_t> node_types_;
+  FrozenArray<uint32_t> child_begin_; // # nodes + 1
+  FrozenArray<int32_t> stop_customers_;
+  FrozenArray<int32_t> pass_customers_;
+  FrozenArray<int32_t> local_labeled_tables_;
+  FrozenArray<int32_t> global_labeled_tables_;
+
+  // floors of node n: [floor_begin_[n], floor_begin_[n + 1])
+  FrozenArray<uint32_t> floor_begin_;
+  FrozenArray<topic_t> floor_ids_;
+  FrozenArray<int32_t> floor_customers_;
+  FrozenArray<int32_t> floor_tables_;
+
+  // types of node n: [type_begin_[n], type_begin_[n + 1]);
+  // sections of type entry e: [section_begin_[e], section_begin_[e + 1])
+  FrozenArray<uint32_t> type_begin_;
+  FrozenArray<int32_t> types_;
+  FrozenArray<uint32_t> section_begin_;
+  FrozenArray<topic_t> section_floors_;
+  FrozenArray<int32_t> section_customers_;
+  FrozenArray<int32_t> section_tables_;
+
+  std::vector<double> zero_order_predictives_; // not serialized
+
+  friend class pfi::data::serialization::access;
+  template <typename Archive>
+  void serialize(Archive& ar) {
+    std::string format = "frozen1";
+    ar & format;
+    if (format != "frozen1") {
+      throw std::string("not a compiled model (run topiclm_compile)");
+    }
+    int tree_type = int(tree_type_);
+    ar & MEMBER(num_topics_)
+        & MEMBER(ngram_order_)
+        & MEMBER(eos_id_)
+        & tree_type
+        & MEMBER(zero_order_pred_)
+        & MEMBER(discounts_)
+        & MEMBER(concentrations_)
+        & MEMBER(prior_stop_)
+        & MEMBER(prior_pass_)
+        & MEMBER(root_lambda_)
+        & MEMBER(lambda_c_)
+        & MEMBER(node_types_)
+        & MEMBER(child_begin_)
+        & MEMBER(stop_customers_)
+        & MEMBER(pass_customers_)
+        & MEMBER(local_labeled_tables_)
+        & MEMBER(global_labeled_tables_)
+        & MEMBER(floor_begin_)
+        & MEMBER(floor_ids_)
+        & MEMBER(floor_customers_)
+        & MEMBER(floor_tables_)
+        & MEMBER(type_begin_)
+        & MEMBER(types_)
+        & MEMBER(section_begin_)
+        & MEMBER(section_floors_)
+        & MEMBER(section_customers_)
+        & MEMBER(section_tables_);
+    if (ar.is_read) {
+      tree_type_ = TreeType(tree_type);
+      zero_order_predictives_.assign(num_topics_ + 1, zero_order_pred_);
+    }
+  }
+};
+
+/**
+ * TestPredictor on a FrozenModel, holding the buffers of one thread. The
+ * predictives of a (deepest node, type) are looked up in cache first and
+ * stored there after they are computed, if cache is given; predictors on
+ * other threads may share it.
+ */
+class FrozenPredictor : public TestPredictor {
+ public:
+  explicit FrozenPredictor(const FrozenModel& model, TestPredictiveCache* cache = nullptr);
+
+  virtual int CalcTestPredictives(Span<int> sent, int idx);
+
+  virtual const std::vector<std::vector<double> >& depth2topic_predictives() const {
+    return depth2topic_predictives_;
+  }
+  virtual const std::vector<double>& stop_prior_path() const { return stop_prior_path_; }
+  virtual const std::vector<double>& lambda_path() const { return lambda_path_; }
+
+ private:
+  const FrozenModel& model_;
+  TestPredictiveCache* cache_;
+
+  // buffer
+  std::vector<int> node_path_;
+  std::vector<double> stop_prior_path_;
+  std::vector<double> lambda_path_;
+  std::vector<std::vector<double> > depth2topic_predictives_;
+  std::vector<int> floor_customers_;
+};
+
+} // topiclm
+
+#endif /* _TOPICLM_FROZEN_MODEL_HPP_ */
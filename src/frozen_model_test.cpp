@@ -0,0 +1,156 @@
+#include <vector>
+#include <string>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstddef>
+#include <memory>
+#include <unistd.h>
+#include "topiclm_model.hpp"
+#include "test_corpus.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace topiclm;
+using namespace std;
+
+namespace {
+
+const int kNumTopics = 3;
+const int kOrder = 3;
+const int kVocabulary = 12;
+
+// (offset, size) of the arrays in the frozen image header follow 4 int32,
+// 4 doubles and 2 uint32; see FrozenModel::VisitArrays for their order
+const size_t kFrozenArraysOffset = 56;
+const int kChildBegin = 4;
+const int kFloorBegin = 9;
+const int kTypeBegin = 13;
+const int kSectionBegin = 15;
+
+class FrozenModelImageTest : public ::testing::Test {
+ protected:
+  FrozenModelImageTest() : corpus_(8, 6, kVocabulary) {}
+  virtual void TearDown() {
+    unlink(image_fn().c_str());
+    unlink(broken_fn().c_str());
+  }
+
+  std::unique_ptr<HpyLdaModel<HpyLdaSampler> > Train(TreeType tree_type) {
+    return corpus_.Train(kNumTopics, kOrder, tree_type);
+  }
+
+  string image_fn() const { return corpus_.dir() + "/model.image"; }
+  string broken_fn() const { return corpus_.dir() + "/broken.image"; }
+
+  string ReadImage() const {
+    ifstream ifs(image_fn(), ios::binary);
+    stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str();
+  }
+  // the error of loading bytes as a compiled model, or "" if it is loaded
+  string LoadError(const string& bytes) const {
+    {
+      ofstream ofs(broken_fn(), ios::binary);
+      ofs.write(bytes.data(), bytes.size());
+    }
+    try {
+      LoadFrozenModel(broken_fn());
+    } catch (const string& what) {
+      return what;
+    }
+    return "";
+  }
+
+  TestCorpus corpus_;
+};
+
+void ExpectSamePredictives(const FrozenModel& expected, const FrozenModel& actual) {
+  ASSERT_EQ(expected.num_nodes(), actual.num_nodes());
+  FrozenPredictor expected_predictor(expected);
+  FrozenPredictor actual_predictor(actual);
+  mt19937 random(5);
+  for (int s = 0; s < 50; ++s) {
+    vector<int> sent(2 + random() % 6);
+    for (auto& w : sent) w = random() % (kVocabulary + 1);
+    for (int i = 0; i < int(sent.size()); ++i) {
+      int depth = expected_predictor.CalcTestPredictives(sent, i);
+      ASSERT_EQ(depth, actual_predictor.CalcTestPredictives(sent, i));
+      EXPECT_EQ(expected_predictor.stop_prior_path(), actual_predictor.stop_prior_path());
+      EXPECT_EQ(expected_predictor.lambda_path(), actual_predictor.lambda_path());
+      EXPECT_EQ(expected_predictor.depth2topic_predictives(),
+                actual_predictor.depth2topic_predictives());
+    }
+  }
+}
+
+void SetUint32(string& bytes, size_t offset, uint32_t value) {
+  memcpy(&bytes[offset], &value, sizeof(value));
+}
+
+uint64_t GetUint64(const string& bytes, size_t offset) {
+  uint64_t value;
+  memcpy(&value, &bytes[offset], sizeof(value));
+  return value;
+}
+
+} // namespace
+
+TEST_F(FrozenModelImageTest, mapped_predictives_are_identical) {
+  for (auto tree_type : {kGraphical, kNonGraphical}) {
+    auto model = Train(tree_type);
+    FrozenHpyLdaSampler frozen(model->sampler());
+    model->SaveCompiledImage<FrozenHpyLdaSampler>(image_fn());
+
+    auto mapped = LoadFrozenModel(image_fn());
+    EXPECT_EQ(tree_type, mapped.sampler().model().tree_type());
+    EXPECT_GT(mapped.sampler().model().num_nodes(), 1);
+    ExpectSamePredictives(frozen.model(), mapped.sampler().model());
+  }
+}
+
+TEST_F(FrozenModelImageTest, rejects_broken_headers) {
+  Train(kGraphical)->SaveCompiledImage<FrozenHpyLdaSampler>(image_fn());
+  string image = ReadImage();
+  ASSERT_EQ("", LoadError(image));
+
+  EXPECT_EQ("not a model image", LoadError(image.substr(0, sizeof(ModelImageHeader) - 1)));
+  EXPECT_EQ("broken model image", LoadError(image.substr(0, image.size() / 2)));
+  EXPECT_EQ("broken model image", LoadError(image.substr(0, image.size() - 1)));
+
+  string wrong_version = image;
+  SetUint32(wrong_version, offsetof(ModelImageHeader, version), ModelImageHeader::kVersion + 1);
+  EXPECT_EQ("unsupported model image version " + to_string(ModelImageHeader::kVersion + 1),
+            LoadError(wrong_version));
+
+  string wrong_byte_order = image;
+  uint32_t byte_order;
+  memcpy(&byte_order, &image[offsetof(ModelImageHeader, byte_order)], sizeof(byte_order));
+  SetUint32(wrong_byte_order, offsetof(ModelImageHeader, byte_order), __builtin_bswap32(byte_order));
+  EXPECT_EQ("model image of another byte order", LoadError(wrong_byte_order));
+
+  // the end of the range would wrap around
+  string huge_offset = image;
+  uint64_t setting_offset = ~uint64_t(0) - 7;
+  memcpy(&huge_offset[offsetof(ModelImageHeader, setting_offset)], &setting_offset, sizeof(setting_offset));
+  EXPECT_EQ("broken model image", LoadError(huge_offset));
+}
+
+TEST_F(FrozenModelImageTest, rejects_indices_out_of_arrays) {
+  Train(kNonGraphical)->SaveCompiledImage<FrozenHpyLdaSampler>(image_fn());
+  string image = ReadImage();
+  uint64_t sampler_offset = GetUint64(image, offsetof(ModelImageHeader, sampler_offset));
+  for (int array : {kChildBegin, kFloorBegin, kTypeBegin, kSectionBegin}) {
+    size_t entry = sampler_offset + kFrozenArraysOffset + 16 * array;
+    uint64_t offset = GetUint64(image, entry);
+    uint64_t size = GetUint64(image, entry + 8);
+    ASSERT_GT(size, 2u);
+    for (uint64_t i : {uint64_t(1), size - 1}) {
+      string broken = image;
+      SetUint32(broken, sampler_offset + offset + sizeof(uint32_t) * i, 0xFFFFFFFF);
+      EXPECT_EQ("broken frozen model image", LoadError(broken)) << "array " << array << " [" << i << "]";
+    }
+  }
+}
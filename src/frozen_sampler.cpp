@@ -0,0 +1,164 @@
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "frozen_sampler.hpp"
+#include "topiclm.hpp"
+#include "parameters.hpp"
+#include "mapped_image.hpp"
+#include "test_predictive_cache.hpp"
+
+namespace topiclm {
+
+FrozenSession::FrozenSession(const FrozenModel& model,
+                             const Parameters& parameters,
+                             ParticleFilterDocumentManager&& pf_dmanager,
+                             int step_size,
+                             int seed,
+                             uint64_t stream,
+                             TestPredictiveCache* cache)
+    : context_(seed, (uint64_t(2) << 32) + stream),
+      predictor_(model, cache),
+      pf_dmanager_(std::move(pf_dmanager)),
+      sampler_(predictor_, parameters, model.tree_type(), context_, pf_dmanager_, step_size) {
+  pf_dmanager_.Reset();
+}
+
+FrozenSession::~FrozenSession() {}
+
+FrozenHpyLdaSampler::FrozenHpyLdaSampler(LambdaType /*lambda_type*/,
+                                         TreeType tree_type,
+                                         DocumentManager& /*dmanager*/,
+                                         Parameters& parameters)
+    : parameters_(parameters),
+      tree_type_(tree_type),
+      num_pf_samplers_(0) {}
+
+FrozenHpyLdaSampler::FrozenHpyLdaSampler(const HpyLdaSampler& sampler)
+    : parameters_(sampler.parameters()),
+      context_(sampler.seed()),
+      model_(sampler.cmanager(), sampler.parameters(), sampler.lambda_type()),
+      predictor_(new FrozenPredictor(model_, cache_.get())),
+      tree_type_(model_.tree_type()),
+      num_pf_samplers_(0) {}
+
+FrozenHpyLdaSampler::~FrozenHpyLdaSampler() {}
+
+std::unique_ptr<FrozenSession>
+FrozenHpyLdaSampler::NewSession(ParticleFilterDocumentManager&& pf_dmanager,
+                                int step_size,
+                                uint64_t stream) const {
+  return std::unique_ptr<FrozenSession>(
+      new FrozenSession(model_, parameters_, std::move(pf_dmanager), step_size,
+                        context_.seed(), stream, cache_.get()));
+}
+
+void FrozenHpyLdaSampler::set_predictive_cache(size_t max_bytes, int num_shards) {
+  predictor_.reset();
+  if (max_bytes == 0) {
+    cache_.reset();
+  } else {
+    cache_.reset(new TestPredictiveCache(max_bytes, num_shards));
+  }
+  predictor_.reset(new FrozenPredictor(model_, cache_.get()));
+}
+
+double FrozenHpyLdaSampler::Run(const ParticleFilterDocumentManager& pf_dmanager,
+                                int step_size,
+                                const RejuvenationPolicy& rejuvenation,
+                                int num_threads,
+                                std::ostream& os) const {
+  struct Result {
+    bool done = false;
+    double ll = 0;
+    int num_words = 0;
+    std::string output;
+  };
+  int num_docs = pf_dmanager.num_docs();
+  std::vector<Result> results(num_docs);
+  std::mutex mutex;
+  std::condition_variable cond;
+  int next_doc = 0;
+  std::string error;
+
+  auto work = [&] {
+    SamplerContext context(context_.seed());
+    FrozenPredictor predictor(model_, cache_.get());
+    ParticleFilterDocumentManager documents(pf_dmanager);
+    ParticleFilterSampler sampler(predictor, parameters_, tree_type_, context, documents, step_size);
+    sampler.set_rejuvenation(rejuvenation);
+    while (true) {
+      int d;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (next_doc == num_docs || !error.empty()) return;
+        d = next_doc++;
+      }
+      Result result;
+      std::string what;
+      try {
+        std::ostringstream oss;
+        result.ll = sampler.RunDocument(d, oss);
+        result.num_words = documents.doc_num_words();
+        result.output = oss.str();
+      } catch (std::string& e) {
+        what = e;
+      } catch (const char* e) {
+        what = e;
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!what.empty()) error = what;
+      result.done = true;
+      results[d] = std::move(result);
+      cond.notify_all();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 0; i < std::max(num_threads, 1); ++i) {
+    threads.emplace_back(work);
+  }
+
+  // merge in document order, as documents are done
+  double ll = 0;
+  int num_words = 0;
+  for (int d = 0; d < num_docs; ++d) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&] { return results[d].done || !error.empty(); });
+    if (!error.empty()) break;
+    Result result = std::move(results[d]);
+    lock.unlock();
+    std::cerr << std::setw(2) << d << "/" << num_docs << "\r";
+    os << result.output;
+    ll += result.ll;
+    num_words += result.num_words;
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (!error.empty()) throw error;
+  return std::exp(-ll / num_words);
+}
+
+void FrozenHpyLdaSampler::WriteImage(ImageWriter& writer) const {
+  model_.WriteImage(writer);
+}
+
+void FrozenHpyLdaSampler::MapImage(std::shared_ptr<const MappedFile> file,
+                                   size_t offset,
+                                   size_t size) {
+  model_.MapImage(file->data() + offset, size);
+  file_ = file;
+  predictor_.reset(new FrozenPredictor(model_, cache_.get()));
+}
+
+ParticleFilterSampler
+FrozenHpyLdaSampler::GetParticleFilterSampler(ParticleFilterDocumentManager& pf_dmanager, int step_size) {
+  return ParticleFilterSampler(*predictor_, parameters_, tree_type_, context_.seed(),
+                               (uint64_t(3) << 32) + num_pf_samplers_++,
+                               pf_dmanager, step_size);
+}
+
+} // namespace topiclm
@@ -0,0 +1,127 @@
+#ifndef _TOPICLM_FROZEN_SAMPLER_HPP_
+#define _TOPICLM_FROZEN_SAMPLER_HPP_
+
+#include <memory>
+#include <ostream>
+#include "config.hpp"
+#include "serialization.hpp"
+#include "frozen_model.hpp"
+#include "particle_filter_sampler.hpp"
+#include "particle_filter_document_manager.hpp"
+#include "sampler_context.hpp"
+
+namespace topiclm {
+
+class HpyLdaSampler;
+class MappedFile;
+class ImageWriter;
+class TestPredictiveCache;
+class Parameters;
+class DocumentManager;
+
+/**
+ * Particle filter state of one document on a shared FrozenModel, with its
+ * own buffers, topic kernel and random stream. Sessions on the same model
+ * may run on different threads.
+ */
+class FrozenSession {
+ public:
+  FrozenSession(const FrozenModel& model,
+                const Parameters& parameters,
+                ParticleFilterDocumentManager&& pf_dmanager,
+                int step_size,
+                int seed,
+                uint64_t stream,
+                TestPredictiveCache* cache = nullptr);
+  ~FrozenSession();
+
+  ParticleFilterSampler& sampler() { return sampler_; }
+  ParticleFilterDocumentManager& pf_dmanager() { return pf_dmanager_; }
+
+ private:
+  SamplerContext context_;
+  FrozenPredictor predictor_;
+  ParticleFilterDocumentManager pf_dmanager_;
+  ParticleFilterSampler sampler_;
+};
+
+/**
+ * Prediction-only counterpart of HpyLdaSampler on a FrozenModel. Models are
+ * saved with it by topiclm_compile and loaded as HpyLdaModel<FrozenHpyLdaSampler>,
+ * either from an archive or by mapping an image (LoadFrozenModel).
+ */
+class FrozenHpyLdaSampler {
+ public:
+  FrozenHpyLdaSampler(LambdaType lambda_type, TreeType tree_type, DocumentManager& dmanager, Parameters& parameters);
+  /**
+   * Compile the tree of a trained sampler (with the same seed).
+   */
+  explicit FrozenHpyLdaSampler(const HpyLdaSampler& sampler);
+  ~FrozenHpyLdaSampler();
+
+  /**
+   * A sampler with a random stream of its own, sharing the buffers of the
+   * predictor of this sampler; NewSession is for other threads.
+   */
+  ParticleFilterSampler GetParticleFilterSampler(ParticleFilterDocumentManager& pf_dmanager, int step_size);
+  /**
+   * A session independent of this sampler and of other sessions; sessions
+   * with different streams draw different random numbers.
+   */
+  std::unique_ptr<FrozenSession> NewSession(ParticleFilterDocumentManager&& pf_dmanager,
+                                            int step_size,
+                                            uint64_t stream) const;
+  /**
+   * ParticleFilterSampler::Run over the documents of pf_dmanager on
+   * num_threads threads, each with its own sampler. Documents keep their
+   * random streams and are written to os in order, so neither the output
+   * nor the perplexity depends on num_threads.
+   */
+  double Run(const ParticleFilterDocumentManager& pf_dmanager,
+             int step_size,
+             const RejuvenationPolicy& rejuvenation,
+             int num_threads,
+             std::ostream& os) const;
+
+  const FrozenModel& model() const { return model_; }
+  int num_nodes() const { return model_.num_nodes(); }
+  const Parameters& parameters() const { return parameters_; }
+  /**
+   * Share a predictive cache of up to max_bytes in num_shards shards among
+   * the predictors, sessions and threads of Run made after this (0 bytes for
+   * none). To be called after the model is loaded, and not while they are
+   * running.
+   */
+  void set_predictive_cache(size_t max_bytes, int num_shards);
+  // nullptr if none
+  const TestPredictiveCache* predictive_cache() const { return cache_.get(); }
+
+  void WriteImage(ImageWriter& writer) const;
+  /**
+   * Use the sampler image at [offset, offset + size) of file in place.
+   */
+  void MapImage(std::shared_ptr<const MappedFile> file, size_t offset, size_t size);
+
+ private:
+  const Parameters& parameters_;
+  SamplerContext context_;
+  std::shared_ptr<const MappedFile> file_; // must outlive model_
+  FrozenModel model_;
+  std::unique_ptr<TestPredictiveCache> cache_; // must outlive predictor_
+  std::unique_ptr<FrozenPredictor> predictor_;
+  TreeType tree_type_;
+  uint64_t num_pf_samplers_;
+
+  friend class pfi::data::serialization::access;
+  template <typename Archive>
+  void serialize(Archive& ar) {
+    ar & MEMBER(model_);
+    if (ar.is_read) {
+      predictor_.reset(new FrozenPredictor(model_, cache_.get()));
+    }
+  }
+};
+
+} // namespace topiclm
+
+#endif /* _TOPICLM_FROZEN_SAMPLER_HPP_ */
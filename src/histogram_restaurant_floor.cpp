@@ -40,7 +40,7 @@ pair<AddRemoveResult, topic_t> HistogramRestaurantFloor::AddCustomer(
     if (sample_label == (topic_t)labels_size) {
       sample_label = -1;
     }
-    histogram.push_back({sample_label, {1, {1, 1}}});
+    histogram.push_back({sample_label, {{1, 1}}});
     ++section.tables;
 
     return {sample_label == -1 ? LocalTableChanged : GlobalTableChanged, sample_label};
@@ -199,7 +199,7 @@ class HistogramTableRestaurant {
   std::vector<std::pair<BinaryHistoKey, int> > global_histogram_; // num_customers -> num_tables
   std::vector<std::pair<BinaryHistoKey, int> > local_histogram_;
 
-  static std::vector<double> table_probs_;
+  static thread_local std::vector<double> table_probs_;
 
   friend class pfi::data::serialization::access;
   template <class Archive>
@@ -12,7 +12,7 @@ namespace topiclm {
 //const size_t hyper_threathold = 4;
 
 void UniformHpySampler::Update(
-      const std::vector<std::set<Node*> >& depth2wnodes,
+      const Depth2Nodes& depth2wnodes,
       HPYParameter& hpy_parameter) {
   //size_t len = min(hyper_threathold, depth2wnodes.size());
   for (size_t i = 0; i < depth2wnodes.size(); ++i) {
@@ -43,8 +43,8 @@ void UniformHpySampler::Update(
   }
 }
 double UniformHpySampler::SampleConcentration(
-    std::vector<std::set<Node*> >::const_iterator depth_node_begin,
-    std::vector<std::set<Node*> >::const_iterator depth_node_end,
+    Depth2Nodes::const_iterator depth_node_begin,
+    Depth2Nodes::const_iterator depth_node_end,
     double concentration,
     double discount) {
   double hpy_yi = 0;
@@ -71,8 +71,8 @@ double UniformHpySampler::SampleConcentration(
   return random->NextGamma(1 + hpy_yi, 1 - hpy_logx);
 }
 double UniformHpySampler::SampleDiscount(
-    std::vector<std::set<Node*> >::const_iterator depth_node_begin,
-    std::vector<std::set<Node*> >::const_iterator depth_node_end,
+    Depth2Nodes::const_iterator depth_node_begin,
+    Depth2Nodes::const_iterator depth_node_end,
     double concentration,
     double discount) {
   double hpy_yi_inv = 0;
@@ -105,7 +105,7 @@ double UniformHpySampler::SampleDiscount(
   return random->NextBeta(1 + hpy_yi_inv, 1 + hpy_zwkj_inv);
 }
 double UniformHpySampler::SampleCacheConcentration(
-    const vector<set<Node*> >& depth2wnodes,
+    const Depth2Nodes& depth2wnodes,
     double concentration,
     double discount) {
   double hpy_yi = 0;
@@ -132,7 +132,7 @@ double UniformHpySampler::SampleCacheConcentration(
   return random->NextGamma(1 + hpy_yi, 1 - hpy_logx);
 }
 double UniformHpySampler::SampleCacheDiscount(
-    const vector<set<Node*> >& depth2wnodes,
+    const Depth2Nodes& depth2wnodes,
     double concentration,
     double discount) {
   double hpy_yi_inv = 0;
@@ -168,7 +168,7 @@ double UniformHpySampler::SampleCacheDiscount(
 }
 
 void NonUniformHpySampler::Update(
-    const std::vector<std::set<Node*> >& depth2wnodes,
+    const Depth2Nodes& depth2wnodes,
     HPYParameter& hpy_parameter) {
   for (size_t i = 0; i < depth2wnodes.size(); ++i) {
     for (int j = 0; j < num_topics_ + 1; ++j) {
@@ -200,8 +200,8 @@ void NonUniformHpySampler::Update(
   }
 }
 double NonUniformHpySampler::SampleConcentration(
-    std::vector<std::set<Node*> >::const_iterator depth_node_begin,
-    std::vector<std::set<Node*> >::const_iterator depth_node_end,
+    Depth2Nodes::const_iterator depth_node_begin,
+    Depth2Nodes::const_iterator depth_node_end,
     int topic,
     double concentration,
     double discount) {
@@ -231,8 +231,8 @@ double NonUniformHpySampler::SampleConcentration(
   return random->NextGamma(1 + hpy_yi, 1 - hpy_logx);
 }
 double NonUniformHpySampler::SampleDiscount(
-    std::vector<std::set<Node*> >::const_iterator depth_node_begin,
-    std::vector<std::set<Node*> >::const_iterator depth_node_end,
+    Depth2Nodes::const_iterator depth_node_begin,
+    Depth2Nodes::const_iterator depth_node_end,
     int topic,
     double concentration,
     double discount) {
@@ -3,7 +3,7 @@
 
 #include <vector>
 #include <memory>
-#include <set>
+#include "config.hpp"
 
 namespace topiclm {
 
@@ -14,7 +14,7 @@ class HpySamplerInterface {
  public:
   virtual ~HpySamplerInterface() {}
   virtual void Update(
-      const std::vector<std::set<Node*> >& depth2wnodes,
+      const Depth2Nodes& depth2wnodes,
       HPYParameter& hpy_parameter) = 0;
 };
 
@@ -22,25 +22,25 @@ class UniformHpySampler : public HpySamplerInterface {
  public:
   UniformHpySampler(int num_topics) : num_topics_(num_topics) {}
   void Update(
-      const std::vector<std::set<Node*> >& depth2wnodes,
+      const Depth2Nodes& depth2wnodes,
       HPYParameter& hpy_parameter);
  private:
   double SampleConcentration(
-      std::vector<std::set<Node*> >::const_iterator depth_node_begin,
-      std::vector<std::set<Node*> >::const_iterator depth_node_end,
+      Depth2Nodes::const_iterator depth_node_begin,
+      Depth2Nodes::const_iterator depth_node_end,
       double concentration,
       double discount);
   double SampleDiscount(
-      std::vector<std::set<Node*> >::const_iterator depth_node_begin,
-      std::vector<std::set<Node*> >::const_iterator depth_node_end,
+      Depth2Nodes::const_iterator depth_node_begin,
+      Depth2Nodes::const_iterator depth_node_end,
       double concentration,
       double discount);
   double SampleCacheConcentration(
-      const std::vector<std::set<Node*> >& depth2wnodes,
+      const Depth2Nodes& depth2wnodes,
       double concentration,
       double discount);
   double SampleCacheDiscount(
-      const std::vector<std::set<Node*> >& some_depth_nodes,
+      const Depth2Nodes& some_depth_nodes,
       double concentration,
       double discount);
   
@@ -51,18 +51,18 @@ class NonUniformHpySampler : public HpySamplerInterface {
  public:
   NonUniformHpySampler(int num_topics) : num_topics_(num_topics) {}
   void Update(
-      const std::vector<std::set<Node*> >& depth2wnodes,
+      const Depth2Nodes& depth2wnodes,
       HPYParameter& hpy_parameter);
  private:
   double SampleConcentration(
-      std::vector<std::set<Node*> >::const_iterator depth_node_begin,
-      std::vector<std::set<Node*> >::const_iterator depth_node_end,
+      Depth2Nodes::const_iterator depth_node_begin,
+      Depth2Nodes::const_iterator depth_node_end,
       int topic,
       double concentration,
       double discount);
   double SampleDiscount(
-      std::vector<std::set<Node*> >::const_iterator depth_node_begin,
-      std::vector<std::set<Node*> >::const_iterator depth_node_end,
+      Depth2Nodes::const_iterator depth_node_begin,
+      Depth2Nodes::const_iterator depth_node_end,
       int topic,
       double concentration,
       double discount);
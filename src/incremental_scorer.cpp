@@ -0,0 +1,154 @@
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include "incremental_scorer.hpp"
+#include "frozen_model.hpp"
+#include "particle_filter_document_manager.hpp"
+#include "parameters.hpp"
+
+using namespace std;
+
+namespace topiclm {
+
+namespace {
+uint64_t ExtensionKey(int node, int word) {
+  return (uint64_t(uint32_t(node)) << 32) | uint32_t(word);
+}
+}
+
+DocumentTopicSnapshot::DocumentTopicSnapshot(int num_topics)
+    : particle2topic_count_(1, make_pair(0, vector<int>(num_topics + 1, 0))) {}
+
+DocumentTopicSnapshot::DocumentTopicSnapshot(const ParticleFilterDocumentManager& pf_dmanager) {
+  for (int m = 0; m < pf_dmanager.num_particles(); ++m) {
+    particle2topic_count_.push_back(pf_dmanager.topic_count(m));
+  }
+}
+
+IncrementalModel::IncrementalModel(const FrozenModel& model, const Parameters& parameters)
+    : model_(model),
+      parameters_(parameters),
+      history_size_(max(model.ngram_order() - 2, 0)),
+      parents_(model.num_nodes(), -1),
+      depths_(model.num_nodes(), 0) {
+  if (history_size_ > kMaxLmHistory) {
+    throw string("n-gram order is too large for incremental scoring");
+  }
+  int num_nodes = model.num_nodes();
+  for (int node = 0; node < num_nodes; ++node) {
+    for (int c = model.child_begin(node); c != model.child_end(node); ++c) {
+      parents_[c] = node;
+      depths_[c] = depths_[node] + 1;
+    }
+  }
+  // The context of node v is (x1, ..., xm) with x1 the most recent word;
+  // suffix[v] is the node of (x2, ..., xm), if any. Nodes are in BFS order,
+  // so the suffix of the parent is known before v.
+  vector<int32_t> suffix(num_nodes, -1);
+  vector<int32_t> first(num_nodes, -1);
+  extensions_.reserve(num_nodes);
+  for (int v = 1; v < num_nodes; ++v) {
+    int p = parents_[v];
+    if (p == 0) {
+      suffix[v] = 0;
+      first[v] = model.node_type(v);
+    } else {
+      first[v] = first[p];
+      suffix[v] = suffix[p] < 0 ? -1 : model.child(suffix[p], model.node_type(v));
+    }
+    if (suffix[v] >= 0) {
+      extensions_[ExtensionKey(suffix[v], first[v])] = v;
+    }
+  }
+}
+
+int IncrementalModel::extension(int node, int word) const {
+  auto it = extensions_.find(ExtensionKey(node, word));
+  return it == extensions_.end() ? -1 : it->second;
+}
+
+LmState IncrementalModel::BeginSentenceState() const {
+  LmState state;
+  fill(state.history, state.history + kMaxLmHistory, 0);
+  fill(state.history, state.history + history_size_, model_.eos_id());
+  state.node = 0;
+  for (int depth = 0; depth < model_.ngram_order() - 1; ++depth) {
+    int c = model_.child(state.node, model_.eos_id());
+    if (c < 0) break;
+    state.node = c;
+  }
+  return state;
+}
+
+LmState IncrementalModel::Advance(const LmState& state, int word) const {
+  LmState next;
+  fill(next.history, next.history + kMaxLmHistory, 0);
+  if (history_size_ > 0) {
+    next.history[0] = word;
+    copy(state.history, state.history + history_size_ - 1, next.history + 1);
+  }
+  next.node = 0;
+  if (model_.ngram_order() < 2) return next;
+
+  // the deepest node of (h1, ..., h_{n-2}); (word, h1, ..., h_j) exists only
+  // if its extension from the node of (h1, ..., h_j) does
+  int base = state.node;
+  while (depths_[base] > history_size_) base = parents_[base];
+  for (int u = base; ; u = parents_[u]) {
+    int v = extension(u, word);
+    if (v >= 0) {
+      if (u == base) {
+        // the new context may match deeper than the old one did
+        for (int d = depths_[v]; d <= history_size_; ++d) {
+          int c = model_.child(v, state.history[d - 1]);
+          if (c < 0) break;
+          v = c;
+        }
+      }
+      next.node = v;
+      return next;
+    }
+    if (u == 0) break;
+  }
+  return next;
+}
+
+int IncrementalModel::NodePath(int node, std::vector<int>& node_path) const {
+  int depth = depths_[node];
+  for (int d = depth; d >= 0; --d) {
+    node_path[d] = node;
+    node = parents_[node];
+  }
+  return depth;
+}
+
+IncrementalScorer::IncrementalScorer(const IncrementalModel& model)
+    : model_(model),
+      kernel_(model.parameters(), model.model().tree_type(), context_),
+      node_path_(model.model().ngram_order(), 0),
+      stop_prior_path_(model.model().ngram_order()),
+      lambda_path_(model.model().ngram_order()),
+      depth2topic_predictives_(model.model().ngram_order(),
+                               vector<double>(model.model().num_topics() + 1)),
+      floor_customers_(model.model().num_topics() + 1) {}
+
+IncrementalScorer::~IncrementalScorer() {}
+
+double IncrementalScorer::Score(const LmState& state,
+                                int word,
+                                const DocumentTopicSnapshot& snapshot,
+                                LmState& out) {
+  auto& model = model_.model();
+  int word_depth = model_.NodePath(state.node, node_path_);
+  model.CalcTestStopPriorPath(node_path_, word_depth, stop_prior_path_);
+  model.CalcLambdaPath(node_path_, word_depth, lambda_path_);
+  model.CalcDepth2TopicPredictives(word, node_path_, word_depth, lambda_path_,
+                                   depth2topic_predictives_, floor_customers_);
+  kernel_.TakeInWord(stop_prior_path_, depth2topic_predictives_, lambda_path_, word_depth);
+  double p_w = kernel_.CalcMarginals(snapshot.particle2topic_count());
+  assert(p_w > 0 && p_w <= 1.0);
+  out = model_.Advance(state, word);
+  return std::log(p_w);
+}
+
+} // topiclm
@@ -0,0 +1,141 @@
+#ifndef _TOPICLM_INCREMENTAL_SCORER_HPP_
+#define _TOPICLM_INCREMENTAL_SCORER_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "sampler_context.hpp"
+#include "particle_topic_kernel.hpp"
+
+namespace topiclm {
+
+class FrozenModel;
+class Parameters;
+class ParticleFilterDocumentManager;
+
+const int kMaxLmHistory = 7; // enough for the infinite (8-gram) models
+
+/**
+ * Context of the next word: the deepest node of the context tree matched by
+ * the history, and the last (n-2) words of the history (most recent first,
+ * padded with EOS). Two equal states predict the same future, so a decoder
+ * may recombine hypotheses with equal states.
+ */
+struct LmState {
+  int32_t node;
+  int32_t history[kMaxLmHistory];
+
+  bool operator==(const LmState& o) const {
+    if (node != o.node) return false;
+    for (int i = 0; i < kMaxLmHistory; ++i) {
+      if (history[i] != o.history[i]) return false;
+    }
+    return true;
+  }
+  bool operator!=(const LmState& o) const { return !(*this == o); }
+};
+
+struct LmStateHash {
+  size_t operator()(const LmState& state) const {
+    uint64_t h = uint64_t(uint32_t(state.node)) * 0x9e3779b97f4a7c15ULL;
+    for (int i = 0; i < kMaxLmHistory; ++i) {
+      h = (h ^ uint32_t(state.history[i])) * 0x100000001b3ULL;
+    }
+    return h ^ (h >> 29);
+  }
+};
+
+/**
+ * Topic counts of each particle of a document, copied so that scoring does
+ * not depend on (or modify) the document session.
+ */
+class DocumentTopicSnapshot {
+ public:
+  /**
+   * An empty document with one particle.
+   */
+  explicit DocumentTopicSnapshot(int num_topics);
+  explicit DocumentTopicSnapshot(const ParticleFilterDocumentManager& pf_dmanager);
+
+  int num_particles() const { return particle2topic_count_.size(); }
+  const std::pair<int, std::vector<int> >& topic_count(int particle) const {
+    return particle2topic_count_[particle];
+  }
+  const std::vector<std::pair<int, std::vector<int> > >& particle2topic_count() const {
+    return particle2topic_count_;
+  }
+
+ private:
+  std::vector<std::pair<int, std::vector<int> > > particle2topic_count_;
+};
+
+/**
+ * Read-only index over a FrozenModel for word-by-word scoring. Besides the
+ * parent of each node, it holds the extension links (node of context c, w)
+ * -> node of context (w, c), so that the state is advanced by one hash
+ * lookup instead of walking from the root. Shared among threads.
+ */
+class IncrementalModel {
+ public:
+  IncrementalModel(const FrozenModel& model, const Parameters& parameters);
+
+  const FrozenModel& model() const { return model_; }
+  const Parameters& parameters() const { return parameters_; }
+
+  LmState BeginSentenceState() const;
+  /**
+   * The state after appending word to the history of state.
+   */
+  LmState Advance(const LmState& state, int word) const;
+  /**
+   * Fill node_path with the nodes from the root to node; returns its depth.
+   */
+  int NodePath(int node, std::vector<int>& node_path) const;
+
+ private:
+  int extension(int node, int word) const;
+
+  const FrozenModel& model_;
+  const Parameters& parameters_;
+  const int history_size_;
+  std::vector<int32_t> parents_;
+  std::vector<int8_t> depths_;
+  std::unordered_map<uint64_t, int32_t> extensions_;
+};
+
+/**
+ * Scores words on an IncrementalModel with its own buffers; use one per
+ * thread. The cost of a word is one predictive evaluation on the path of
+ * the state plus (mostly) one extension lookup.
+ */
+class IncrementalScorer {
+ public:
+  explicit IncrementalScorer(const IncrementalModel& model);
+  ~IncrementalScorer();
+
+  /**
+   * Returns the log probability of word after state for the document of
+   * snapshot (averaged over its particles), and the next state in out.
+   * out may be the same object as state.
+   */
+  double Score(const LmState& state,
+               int word,
+               const DocumentTopicSnapshot& snapshot,
+               LmState& out);
+
+ private:
+  const IncrementalModel& model_;
+  SamplerContext context_; // the kernel is only used for marginals
+  ParticleTopicKernel kernel_;
+
+  // buffer
+  std::vector<int> node_path_;
+  std::vector<double> stop_prior_path_;
+  std::vector<double> lambda_path_;
+  std::vector<std::vector<double> > depth2topic_predictives_;
+  std::vector<int> floor_customers_;
+};
+
+} // topiclm
+
+#endif /* _TOPICLM_INCREMENTAL_SCORER_HPP_ */
@@ -17,10 +17,10 @@ namespace topiclm {
 struct SampleTableInfo {
   topic_t label;
   int customers;
-  std::vector<std::shared_ptr<Word> > observeds;
+  std::vector<word_id_t> observeds;
   bool exist;
   SampleTableInfo() : label(0), customers(0), exist(false) {}
-  SampleTableInfo(topic_t label, int customers, std::vector<std::shared_ptr<Word> > observeds)
+  SampleTableInfo(topic_t label, int customers, std::vector<word_id_t> observeds)
       : label(label), customers(customers), observeds(observeds), exist(true) {}
 };
 
@@ -55,8 +55,8 @@ class InternalRestaurant {
   size_t GetTableSeqFromSection(std::vector<TableInfo>& table_seq,
                                 bool consider_zero = false);
 
-  void CombineSectionToWord(K type, const std::shared_ptr<Word>& word_ptr, bool cache = false);
-  void SeparateWordFromSection(K type, const std::shared_ptr<Word>& word_ptr, bool cache = false);
+  void CombineSectionToWord(K type, word_id_t word, bool cache = false);
+  void SeparateWordFromSection(K type, word_id_t word, bool cache = false);
 
   void ResetCache() {
     //boost::container::flat_map<K, HistgramSection>().swap(cache_sections_);
@@ -133,6 +133,7 @@ class InternalRestaurant {
     return type_vector;
   }
   HistgramSection& section(K type) { return sections_[type]; }
+  const boost::container::flat_map<K, HistgramSection>& sections() const { return sections_; }
   
   std::string to_string() const {
     std::stringstream ss;
@@ -168,10 +169,10 @@ class InternalRestaurant {
   boost::container::flat_map<K, HistgramSection> sections_;
   //boost::container::flat_map<K, HistgramSection> cache_sections_;
 
-  //buffer
-  static std::vector<double> table_probs_;
-  static std::vector<size_t> table_label_idxs_;
-  static std::vector<size_t> table_customer_idxs_;
+  //buffer (per thread)
+  static thread_local std::vector<double> table_probs_;
+  static thread_local std::vector<size_t> table_label_idxs_;
+  static thread_local std::vector<size_t> table_customer_idxs_;
 
   friend class pfi::data::serialization::access;
   template <class Archive>
@@ -180,11 +181,11 @@ class InternalRestaurant {
   }
 };
 template <typename K>
-std::vector<double> InternalRestaurant<K>::table_probs_;
+thread_local std::vector<double> InternalRestaurant<K>::table_probs_;
 template <typename K>
-std::vector<size_t> InternalRestaurant<K>::table_label_idxs_;
+thread_local std::vector<size_t> InternalRestaurant<K>::table_label_idxs_;
 template <typename K>
-std::vector<size_t> InternalRestaurant<K>::table_customer_idxs_;
+thread_local std::vector<size_t> InternalRestaurant<K>::table_customer_idxs_;
 
 template <typename K>
 std::pair<AddRemoveResult, topic_t> InternalRestaurant<K>::AddCustomer(
@@ -215,7 +216,7 @@ std::pair<AddRemoveResult, topic_t> InternalRestaurant<K>::AddCustomer(
     if (sample_label == (topic_t)labels_size) {
       sample_label = -1;
     }
-    histogram.push_back({sample_label, {1, {1, 1}}});
+    histogram.push_back({sample_label, {{1, 1}}});
     ++section.tables;
     return {sample_label == -1 ? LocalTableChanged : GlobalTableChanged, sample_label};
   }
@@ -425,7 +426,7 @@ SampleTableInfo InternalRestaurant<K>::SampleTableAtRandom(K type) {
   topic_t label = histogram[table_label_idxs_[sample]].first;
   int c = histogram[table_label_idxs_[sample]].second[table_customer_idxs_[sample]].first;
   bool observed = random->NextBernoille(double(section.observeds.size()) / double(section.customers));
-  std::vector<std::shared_ptr<Word> > observeds;
+  std::vector<word_id_t> observeds;
   if (observed) {
     if (table_label_idxs_.size() < section.observeds.size()) {
       ResizeBuffer(section.observeds.size());
@@ -500,32 +501,31 @@ size_t InternalRestaurant<K>::GetTableSeqFromSection(std::vector<TableInfo>& tab
   return i;
 }
 template <typename K>
-void InternalRestaurant<K>::CombineSectionToWord(K type, const std::shared_ptr<Word>& word_ptr, bool /*cache*/) {
+void InternalRestaurant<K>::CombineSectionToWord(K type, word_id_t word, bool /*cache*/) {
   //auto& target_sections = cache ? cache_sections_ : sections_;
   auto& target_sections = sections_;
   auto& section = target_sections[type];
   
-  auto it = std::lower_bound(section.observeds.begin(), section.observeds.end(), word_ptr);
-  assert(it == section.observeds.end() || *it != word_ptr);
-  section.observeds.insert(it, word_ptr);
+  auto it = std::lower_bound(section.observeds.begin(), section.observeds.end(), word);
+  assert(it == section.observeds.end() || *it != word);
+  section.observeds.insert(it, word);
 }
 template <typename K>
-void InternalRestaurant<K>::SeparateWordFromSection(K type, const std::shared_ptr<Word>& word_ptr, bool /*cache*/) {
+void InternalRestaurant<K>::SeparateWordFromSection(K type, word_id_t word, bool /*cache*/) {
   //auto& target_sections = cache ? cache_sections_ : sections_;
   auto& target_sections = sections_;
   auto& section = target_sections[type];
 
-  auto it = std::lower_bound(section.observeds.begin(), section.observeds.end(), word_ptr);
-  if (!(it != section.observeds.end() && *it == word_ptr)) {
-    std::cerr << "\nword_ptr: " << word_ptr.get() << std::endl;
-    std::cerr << "find: " << (*it).get() << std::endl;
-    for (auto& word : section.observeds) {
-      std::cerr << word.get() << " ";
+  auto it = std::lower_bound(section.observeds.begin(), section.observeds.end(), word);
+  if (!(it != section.observeds.end() && *it == word)) {
+    std::cerr << "\nword: " << word << std::endl;
+    for (auto observed : section.observeds) {
+      std::cerr << observed << " ";
     }
     std::cerr << std::endl;
     throw "hoge";
   }
-  assert(it != section.observeds.end() && *it == word_ptr);
+  assert(it != section.observeds.end() && *it == word);
   EraseAndShrink(section.observeds, it);
 }
 
@@ -26,7 +26,7 @@ void LambdaManager::CalcLambdaPath(const vector<Node*>& /*node_path*/, int targe
   }
 }
 string LambdaManager::PrintDepth2Tables(
-    const vector<set<Node*> >& /*depth2wnodes*/) const {
+    const Depth2Nodes& /*depth2wnodes*/) const {
   stringstream ss;
   ss << "global_tables\tlocal_tables" << endl;
   for (size_t i = 0; i < depth2topic2local_tables_.size(); ++i) {
@@ -67,9 +67,17 @@ double LambdaManager::root_lambda() const {
       / (double)(lambda_parameter_.a + lambda_parameter_.b);
 }
 
+namespace {
+unique_lock<mutex> LockIfRoot(mutex* root_mutex, int depth) {
+  return root_mutex != nullptr && depth == 0 ?
+      unique_lock<mutex>(*root_mutex) : unique_lock<mutex>();
+}
+}
+
 HierarchicalLambdaManager::HierarchicalLambdaManager(
     const LambdaParameter& lambda_parameter, int ngram_order)
     : lambda_parameter_(lambda_parameter),
+      root_mutex_(nullptr),
       lambda_path_(ngram_order),
       global_lambda_path_(ngram_order),
       depth2global_local_num_tables_(ngram_order) {}
@@ -83,6 +91,7 @@ void HierarchicalLambdaManager::CalcLambdaPath(const std::vector<Node*>& node_pa
   for (int j = 0; j <= target_depth; ++j) {
     double c = lambda_parameter_.c[j];
     auto& restaurant = node_path[j]->restaurant();
+    auto root_lock = LockIfRoot(root_mutex_, j);
     double local_tables = restaurant.local_labeled_tables();
     double global_tables = restaurant.global_labeled_tables();
     lambda = (local_tables + c * lambda) / (local_tables + global_tables + c);
@@ -122,6 +131,7 @@ void HierarchicalLambdaManager::AddNewTable(
     const vector<Node*>& node_path, int /*topic*/, int depth, bool is_global) {
   for (int i = depth; i >= 0; --i) {
     auto& restaurant = node_path[i]->restaurant();
+    auto root_lock = LockIfRoot(root_mutex_, i);
     double parent_prob = 0;
     if (i == 0) {
       parent_prob = lambda_parameter_.a
@@ -143,6 +153,7 @@ void HierarchicalLambdaManager::AddNewTableAtRandom(
     const vector<Node*>& node_path, int /*topic*/, int depth, bool is_global) {
   for (int i = depth; i >= 0; --i) {
     auto& restaurant = node_path[i]->restaurant();
+    auto root_lock = LockIfRoot(root_mutex_, i);
     restaurant.AddTableNewTable(is_global, 1.0);
   }
 }
@@ -170,6 +181,7 @@ void HierarchicalLambdaManager::RemoveTable(
     const vector<Node*>& node_path, int /*topic*/, int depth, bool is_global) {
   for (int i = depth; i >= 0; --i) {
     auto& restaurant = node_path[i]->restaurant();
+    auto root_lock = LockIfRoot(root_mutex_, i);
     auto remove_result = restaurant.RemoveTable(is_global);
     if (remove_result == TableUnchanged) {
       break;
@@ -179,7 +191,7 @@ void HierarchicalLambdaManager::RemoveTable(
 }
 
 string HierarchicalLambdaManager::PrintDepth2Tables(
-    const vector<set<Node*> >& depth2wnodes) const {
+    const Depth2Nodes& depth2wnodes) const {
   depth2global_local_num_tables_.assign(depth2wnodes.size(), {0,0});
   for (size_t i = 0; i < depth2wnodes.size(); ++i) {
     for (auto node : depth2wnodes[i]) {
@@ -2,8 +2,9 @@
 #define _TOPICLM_LAMBDA_MANAGER_HPP_
 
 #include <vector>
-#include <set>
 #include <sstream>
+#include <mutex>
+#include "config.hpp"
 
 namespace topiclm {
 
@@ -14,6 +15,7 @@ struct LambdaParameter;
 class LambdaManagerInterface {
  public:
   virtual ~LambdaManagerInterface();
+  virtual LambdaManagerInterface* Clone() const = 0;
   virtual void CalcLambdaPath(const std::vector<Node*>& node_path,
                               int target_depth) = 0;
   virtual void CalcLambdaPathFractionary(const std::vector<Node*>&, int) {}
@@ -32,7 +34,7 @@ class LambdaManagerInterface {
                            bool is_global) = 0;
   
   virtual std::string PrintDepth2Tables(
-      const std::vector<std::set<Node*> >& depth2nodes) const = 0;
+      const Depth2Nodes& depth2nodes) const = 0;
   virtual std::string AnalyzeLambdaPath(
       const std::vector<Node*>& node_path, int target_depth) const = 0;
   virtual std::vector<std::pair<double, std::vector<int> > >
@@ -48,6 +50,11 @@ class LambdaManagerInterface {
   virtual const std::vector<double>& lambda_path() const = 0;
   virtual const std::vector<double>& global_lambda_path() const = 0;
   virtual double root_lambda() const = 0;
+  /**
+   * See RestaurantManager::set_root_mutex; lambdas kept in the restaurants
+   * of the tree lock the root restaurant when they reach it.
+   */
+  virtual void set_root_mutex(std::mutex*) {}
  private:
   std::vector<std::vector<int> > dummy_v_;
 };
@@ -61,6 +68,7 @@ class LambdaManager : public LambdaManagerInterface {
         depth2topic2lambda_(ngram_order, std::vector<double>(num_topics + 1, 0.0)) ,
         dummy_lambda_path_(ngram_order) {}
   virtual ~LambdaManager();
+  virtual LambdaManagerInterface* Clone() const { return new LambdaManager(*this); }
   virtual void CalcLambdaPath(const std::vector<Node*>& node_path, int target_depth);
   virtual void AddNewTable(
       const std::vector<Node*>& /*node_path*/, int topic, int depth, bool is_global) {
@@ -84,7 +92,7 @@ class LambdaManager : public LambdaManagerInterface {
   }
   
   virtual std::string PrintDepth2Tables(
-      const std::vector<std::set<Node*> >& depth2nodes) const;
+      const Depth2Nodes& depth2nodes) const;
   virtual std::string AnalyzeLambdaPath(
       const std::vector<Node*>& node_path, int target_depth) const;
   virtual std::vector<std::pair<double, std::vector<int> > >
@@ -116,6 +124,7 @@ class HierarchicalLambdaManager : public LambdaManagerInterface {
  public:
   HierarchicalLambdaManager(const LambdaParameter& lambda_parameter, int ngram_order);
   virtual ~HierarchicalLambdaManager();
+  virtual LambdaManagerInterface* Clone() const { return new HierarchicalLambdaManager(*this); }
   virtual void CalcLambdaPath(const std::vector<Node*>& node_path,
                               int target_depth);
   virtual void CalcLambdaPathFractionary(const std::vector<Node*>& node_path,
@@ -130,7 +139,7 @@ class HierarchicalLambdaManager : public LambdaManagerInterface {
       const std::vector<Node*>& node_path, int topic, int depth, bool is_global);
   
   virtual std::string PrintDepth2Tables(
-      const std::vector<std::set<Node*> >& depth2nodes) const;
+      const Depth2Nodes& depth2nodes) const;
   virtual std::string AnalyzeLambdaPath(
       const std::vector<Node*>& node_path, int target_depth) const;
   virtual std::vector<std::pair<double, std::vector<int> > >
@@ -143,9 +152,11 @@ class HierarchicalLambdaManager : public LambdaManagerInterface {
   virtual const std::vector<double>& lambda_path() const { return lambda_path_; }
   virtual const std::vector<double>& global_lambda_path() const { return global_lambda_path_; }
   virtual double root_lambda() const;
+  virtual void set_root_mutex(std::mutex* root_mutex) { root_mutex_ = root_mutex; }
 
  protected:
   const LambdaParameter& lambda_parameter_;
+  std::mutex* root_mutex_;
   // buffer
   std::vector<double> lambda_path_;
   std::vector<double> global_lambda_path_; // for fractional caluculation only
@@ -3,6 +3,7 @@
 #include "cmdline.h"
 #include "random_util.hpp"
 #include "topiclm_model.hpp"
+#include "rejuvenation_options.hpp"
 #include "log.hpp"
 #include "particle_filter_document_manager.hpp"
 #include "io_util.hpp"
@@ -81,15 +82,46 @@ void CalcDocumentProbability(const std::string& fn,
   cout << "perplexity: " << perplexity << endl;
 }
 
+template <class SamplerType>
+void Run(topiclm::HpyLdaModel<SamplerType>& model, const cmdline::parser& p, bool store) {
+  auto& sampler = model.sampler();
+  cerr << "tree node size: " << sampler.num_nodes() << endl;
+
+  auto pf_dmanager = model.GetPFDocumentManager(p.get<int>("particles"));
+  pf_dmanager.Reset();
+  auto rejuvenation = topiclm::GetRejuvenationPolicy(p);
+  auto pf_sampler = sampler.GetParticleFilterSampler(pf_dmanager, p.get<int>("step"));
+  pf_sampler.set_rejuvenation(rejuvenation);
+
+  auto reader = model.reader_for_test();
+
+  std::cerr << std::endl;
+  if (!p.exist("file")) {
+    RunShell(pf_sampler, pf_dmanager.intern(), reader, store, p.get<bool>("calc_eos"));
+  } else {
+    CalcDocumentProbability(
+        p.get<string>("file"), pf_sampler, pf_dmanager.intern(), reader, p.get<bool>("calc_eos"));
+  }
+}
+
+struct Runner {
+  const cmdline::parser& p;
+  bool store;
+  template <class SamplerType>
+  void operator()(topiclm::HpyLdaModel<SamplerType>& model) const { Run(model, p, store); }
+};
+
 int main(int argc, char *argv[])
 {
   cmdline::parser p;
   p.add<string>("file", 'f', "input file (treated as one document); run shell-mode if omitted", false);
   p.add<int>("particles", 'p', "nubmer of particles", false, 1);
   p.add<int>("step", 's', "reestimate each after storing this number of sentences", false, 1);
+  topiclm::AddRejuvenationOptions(p);
   p.add<string>("mode", 'M', "initial model (store|readonly)", false, "store");
   p.add<string>("model", 'm', "model file name (not directory)", true);
   p.add<bool>("calc_eos", 'e', "Whether the sentence probability contains each EOS probability", false, true);
+  p.add("frozen", '\0', "the model is compiled by topiclm_compile (archive or mapped image)");
   p.parse_check(argc, argv);
 
   try {
@@ -97,27 +129,7 @@ int main(int argc, char *argv[])
 
     bool store = init_store(p.get<string>("mode"));
 
-    auto model = topiclm::LoadModel<topiclm::HpyLdaSampler>(p.get<string>("model"));
-
-    auto& sampler = model.sampler();
-    auto ct_analyzer = sampler.GetCTAnalyzer();
-    
-    cerr << "tree node size: " << ct_analyzer.CountNodes() << endl;
-
-    auto pf_dmanager = model.GetPFDocumentManager(p.get<int>("particles"));
-    pf_dmanager.Reset();
-    auto pf_sampler = sampler.GetParticleFilterSampler(pf_dmanager, p.get<int>("step"));
-
-    auto reader = model.reader_for_test();
-
-    std::cerr << std::endl;
-    if (!p.exist("file")) {
-      RunShell(pf_sampler, pf_dmanager.intern(), reader, store, p.get<bool>("calc_eos"));
-    } else {
-      CalcDocumentProbability(
-          p.get<string>("file"), pf_sampler, pf_dmanager.intern(), reader, p.get<bool>("calc_eos"));
-    }
-    
+    topiclm::RunOnModel(p.get<string>("model"), p.exist("frozen"), Runner{p, store});
   } catch (string& what) {
     cerr << what << endl;
     return 1;
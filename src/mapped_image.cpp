@@ -0,0 +1,100 @@
+#include <cstring>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mapped_image.hpp"
+
+using namespace std;
+
+namespace topiclm {
+
+namespace {
+const char kImageMagic[8] = {'T', 'L', 'M', 'I', 'M', 'A', 'G', 'E'};
+const uint32_t kByteOrderMark = 0x01020304;
+}
+
+MappedFile::MappedFile(const std::string& fn) : data_(nullptr), size_(0) {
+  int fd = open(fn.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw "cannot read model file " + fn;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw "cannot stat model file " + fn;
+  }
+  size_ = st.st_size;
+  if (size_ > 0) {
+    void* p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+      close(fd);
+      throw "cannot map model file " + fn;
+    }
+    data_ = static_cast<const char*>(p);
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+ModelImageHeader::ModelImageHeader()
+    : version(kVersion),
+      byte_order(kByteOrderMark),
+      setting_offset(0),
+      setting_size(0),
+      sampler_offset(0),
+      sampler_size(0) {
+  memcpy(magic, kImageMagic, sizeof(magic));
+}
+
+const ModelImageHeader& ModelImageHeader::Check(const char* data, size_t size) {
+  if (size < sizeof(ModelImageHeader) || memcmp(data, kImageMagic, sizeof(kImageMagic)) != 0) {
+    throw string("not a model image");
+  }
+  auto& header = *reinterpret_cast<const ModelImageHeader*>(data);
+  if (header.byte_order != kByteOrderMark) {
+    throw string("model image of another byte order");
+  }
+  if (header.version != kVersion) {
+    throw "unsupported model image version " + to_string(header.version);
+  }
+  if (header.setting_offset > size || header.setting_size > size - header.setting_offset
+      || header.sampler_offset > size || header.sampler_size > size - header.sampler_offset
+      || header.sampler_offset % kImageAlignment != 0) {
+    throw string("broken model image");
+  }
+  return header;
+}
+
+bool IsModelImage(const std::string& fn) {
+  ifstream ifs(fn, ios::binary);
+  char magic[sizeof(kImageMagic)];
+  return ifs.read(magic, sizeof(magic)) && memcmp(magic, kImageMagic, sizeof(magic)) == 0;
+}
+
+uint64_t ImageWriter::Align() {
+  static const char zeros[kImageAlignment] = {};
+  uint64_t aligned = AlignImageOffset(offset_);
+  Write(zeros, aligned - offset_);
+  return offset_;
+}
+
+void ImageWriter::Write(const void* data, size_t size) {
+  os_.write(static_cast<const char*>(data), size);
+  offset_ += size;
+}
+
+void ImageWriter::Rewrite(uint64_t offset, const void* data, size_t size) {
+  auto current = os_.tellp();
+  os_.seekp(offset);
+  os_.write(static_cast<const char*>(data), size);
+  os_.seekp(current);
+}
+
+} // topiclm
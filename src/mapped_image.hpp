@@ -0,0 +1,104 @@
+#ifndef _TOPICLM_MAPPED_IMAGE_HPP_
+#define _TOPICLM_MAPPED_IMAGE_HPP_
+
+#include <string>
+#include <ostream>
+#include <streambuf>
+#include <cstdint>
+
+namespace topiclm {
+
+/**
+ * Offsets of the parts of a model image are multiples of this, from the
+ * beginning of the file.
+ */
+const uint64_t kImageAlignment = 64;
+
+inline uint64_t AlignImageOffset(uint64_t offset) {
+  return (offset + kImageAlignment - 1) / kImageAlignment * kImageAlignment;
+}
+
+/**
+ * Read-only mapping of a whole file. Processes mapping the same file share
+ * its pages in the page cache.
+ */
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& fn);
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const char* data_;
+  size_t size_;
+};
+
+/**
+ * Header at the beginning of a model image (see
+ * HpyLdaModel::SaveCompiledImage): the setting of the model as an archive,
+ * followed by the image of the sampler. Images are read on hosts of the same
+ * byte order only.
+ */
+struct ModelImageHeader {
+  static const uint32_t kVersion = 1;
+
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t setting_offset;
+  uint64_t setting_size;
+  uint64_t sampler_offset;
+  uint64_t sampler_size;
+
+  ModelImageHeader();
+  /**
+   * Validate the header of an image of size bytes; throws a string.
+   */
+  static const ModelImageHeader& Check(const char* data, size_t size);
+};
+
+/**
+ * Whether fn begins with the magic of a model image.
+ */
+bool IsModelImage(const std::string& fn);
+
+/**
+ * Writes the parts of an image, padding each to kImageAlignment.
+ */
+class ImageWriter {
+ public:
+  explicit ImageWriter(std::ostream& os) : os_(os), offset_(0) {}
+  uint64_t offset() const { return offset_; }
+  /**
+   * Pad with zeros up to the next aligned offset, which is returned.
+   */
+  uint64_t Align();
+  void Write(const void* data, size_t size);
+  /**
+   * Overwrite size bytes at offset (e.g. a header completed at the end).
+   */
+  void Rewrite(uint64_t offset, const void* data, size_t size);
+
+ private:
+  std::ostream& os_;
+  uint64_t offset_;
+};
+
+/**
+ * Input stream buffer on a memory block, to read an archive in an image.
+ */
+class MemoryStreamBuf : public std::streambuf {
+ public:
+  MemoryStreamBuf(const char* data, size_t size) {
+    char* p = const_cast<char*>(data);
+    setg(p, p, p + size);
+  }
+};
+
+} // topiclm
+
+#endif /* _TOPICLM_MAPPED_IMAGE_HPP_ */
@@ -0,0 +1,174 @@
+#include <cassert>
+#include <numeric>
+#include <algorithm>
+#include "mh_topic_sampler.hpp"
+#include "parameters.hpp"
+#include "document_manager.hpp"
+#include "restaurant_manager.hpp"
+#include "sampler_context.hpp"
+#include "random_util.hpp"
+
+using namespace std;
+
+namespace topiclm {
+
+void AliasTable::Build(const vector<double>& weights) {
+  int n = weights.size();
+  weights_ = weights;
+  probs_.assign(n, 0.0);
+  aliases_.assign(n, 0);
+  double sum = accumulate(weights.begin(), weights.end(), 0.0);
+  assert(sum > 0);
+
+  vector<int> small, large;
+  for (int i = 0; i < n; ++i) {
+    probs_[i] = weights[i] * n / sum;
+    if (probs_[i] < 1) small.push_back(i);
+    else large.push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    int s = small.back(); small.pop_back();
+    int l = large.back();
+    aliases_[s] = l;
+    probs_[l] -= 1 - probs_[s];
+    if (probs_[l] < 1) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // the rest are 1 up to rounding
+  for (int i : small) probs_[i] = 1;
+  for (int i : large) probs_[i] = 1;
+}
+
+int AliasTable::Sample(RandomBase& random) const {
+  double u = random.NextDouble() * probs_.size();
+  int i = u;
+  return u - i < probs_[i] ? i : aliases_[i];
+}
+
+MHTopicDepthSampler::MHTopicDepthSampler(const Parameters& parameters,
+                                         TreeType tree_type,
+                                         RestaurantManager& rmanager,
+                                         const vector<double>& lambda_path,
+                                         SamplerContext& context,
+                                         int num_steps)
+    : num_topics_(parameters.topic_parameter().num_topics),
+      ngram_order_(parameters.ngram_order()),
+      non_graphical_(tree_type == kNonGraphical),
+      topic_parameter_(parameters.topic_parameter()),
+      rmanager_(rmanager),
+      lambda_path_(lambda_path),
+      context_(context),
+      num_steps_(num_steps),
+      depth_weights_(ngram_order_) {}
+
+void MHTopicDepthSampler::BeginIteration(const DocumentManager& dmanager) {
+  alpha_table_.Build(topic_parameter_.alpha);
+  type2proposal_.clear();
+  if (doc_begins_.empty()) {
+    // words of a document are contiguous (see DocumentManager::BuildWords)
+    auto& words = dmanager.words();
+    doc_begins_.assign(dmanager.num_docs() + 1, words.size());
+    for (int word = words.size() - 1; word >= 0; --word) {
+      doc_begins_[words.doc_id(word)] = word;
+    }
+    for (int d = dmanager.num_docs() - 1; d >= 0; --d) {
+      doc_begins_[d] = min(doc_begins_[d], doc_begins_[d + 1]);
+    }
+  }
+}
+
+MHTopicDepthSampler::WordProposal& MHTopicDepthSampler::GetWordProposal(int type) {
+  auto it = type2proposal_.find(type);
+  if (it == type2proposal_.end() || it->second.num_draws > num_topics_) {
+    // stale after as many draws as it costs to build
+    rmanager_.CalcDepth2TopicPredictives(type, 0);
+    auto& proposal = type2proposal_[type];
+    proposal.table.Build(rmanager_.depth_predictives(0));
+    proposal.num_draws = 0;
+    return proposal;
+  }
+  return it->second;
+}
+
+int MHTopicDepthSampler::ProposeFromDocument(const DocumentManager& dmanager, word_id_t word) {
+  // n_dj + alpha_j, where n_dj excludes word
+  auto& words = dmanager.words();
+  int doc_id = words.doc_id(word);
+  int num_others = doc_begins_[doc_id + 1] - doc_begins_[doc_id] - 1;
+  double u = context_.random().NextDouble() * (num_others + topic_parameter_.alpha_1);
+  if (u >= num_others) return alpha_table_.Sample(context_.random());
+  word_id_t other = doc_begins_[doc_id] + static_cast<int>(u);
+  if (other >= word) ++other;
+  return words.topic(other);
+}
+
+double MHTopicDepthSampler::TopicWeight(const pair<int, vector<int> >& topic_count,
+                                        int type,
+                                        int topic,
+                                        const vector<double>& stop_prior_path,
+                                        int word_depth) {
+  rmanager_.CalcTopicPredictivePath(type, topic, word_depth);
+  double prior = (topic_count.second[topic] + topic_parameter_.alpha[topic])
+      / (topic_count.first + topic_parameter_.alpha_1);
+  double sum = 0;
+  for (int i = 0; i < ngram_order_; ++i) {
+    double w = stop_prior_path[i] * rmanager_.predictive(i, topic);
+    if (non_graphical_) {
+      w *= topic == 0 ? 1 - lambda_path_[i] : lambda_path_[i] * prior;
+    } else {
+      w *= prior;
+    }
+    depth_weights_[i] = w;
+    sum += w;
+  }
+  return sum;
+}
+
+SampleInfo MHTopicDepthSampler::Sample(const DocumentManager& dmanager,
+                                       word_id_t word,
+                                       int type,
+                                       int current_topic,
+                                       const vector<double>& stop_prior_path,
+                                       int word_depth) {
+  auto& proposal = GetWordProposal(type);
+  rmanager_.CalcLambdaAndGlobalPredictivePath(type, word_depth);
+  auto& topic_count = dmanager.doc2topic_count()[dmanager.words().doc_id(word)];
+
+  int topic = current_topic;
+  double weight = TopicWeight(topic_count, type, topic, stop_prior_path, word_depth);
+  int weight_topic = topic; // of the predictives left in rmanager_
+  for (int step = 0; step < num_steps_; ++step) {
+    bool from_document = step % 2 == 0;
+    int proposed;
+    double q_forward, q_backward;
+    if (from_document) {
+      proposed = ProposeFromDocument(dmanager, word);
+      q_forward = DocumentProposal(topic_count, proposed);
+      q_backward = DocumentProposal(topic_count, topic);
+    } else {
+      proposed = proposal.table.Sample(context_.random());
+      ++proposal.num_draws;
+      q_forward = proposal.table.weight(proposed);
+      q_backward = proposal.table.weight(topic);
+    }
+    if (proposed == topic) continue;
+    double proposed_weight = TopicWeight(topic_count, type, proposed, stop_prior_path, word_depth);
+    weight_topic = proposed;
+    double accept = proposed_weight * q_backward;
+    double reject = weight * q_forward;
+    if (accept >= reject || context_.random().NextDouble() * reject < accept) {
+      topic = proposed;
+      weight = proposed_weight;
+    }
+  }
+  if (weight_topic != topic) {
+    weight = TopicWeight(topic_count, type, topic, stop_prior_path, word_depth);
+  }
+  assert(weight > 0);
+  int depth = context_.random().SampleUnnormalizedPdfRef(depth_weights_);
+  return {false, depth, topic, weight};
+}
+
+} // namespace topiclm
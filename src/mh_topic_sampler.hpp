@@ -0,0 +1,103 @@
+#ifndef _TOPICLM_MH_TOPIC_SAMPLER_HPP_
+#define _TOPICLM_MH_TOPIC_SAMPLER_HPP_
+
+#include <vector>
+#include <unordered_map>
+#include "config.hpp"
+#include "word.hpp"
+#include "topic_sampler.hpp"
+
+namespace topiclm {
+
+class Parameters;
+class DocumentManager;
+class RestaurantManager;
+
+/**
+ * Walker's alias table: a draw from n weights in O(1) after an O(n) build.
+ */
+class AliasTable {
+ public:
+  void Build(const std::vector<double>& weights);
+  int Sample(RandomBase& random) const;
+  double weight(int i) const { return weights_[i]; }
+
+ private:
+  std::vector<double> weights_;
+  std::vector<double> probs_;
+  std::vector<int> aliases_;
+};
+
+/**
+ * Topic-depth sampler for training with many topics (LightLDA-style
+ * Metropolis-Hastings). From the previous topic of a word, num_steps steps
+ * propose a topic alternately from the document (n_dj + alpha_j: the topic
+ * of another word of the document, or an alias table of alpha) and from the
+ * word (an alias table of the root predictives of its type, rebuilt after
+ * num_topics + 1 draws), and accept it by the exact posterior of that one
+ * topic, which costs O(order) instead of O(num_topics * order). The depth is
+ * then drawn exactly for the topic. The p_w of a sample is the joint
+ * probability of the word and its topic, not the marginal.
+ */
+class MHTopicDepthSampler {
+ public:
+  MHTopicDepthSampler(const Parameters& parameters,
+                      TreeType tree_type,
+                      RestaurantManager& rmanager,
+                      const std::vector<double>& lambda_path,
+                      SamplerContext& context,
+                      int num_steps);
+
+  /**
+   * Rebuild what depends on alpha or on the previous iteration.
+   */
+  void BeginIteration(const DocumentManager& dmanager);
+  /**
+   * Sample the topic and depth of word (removed from the tree and counts),
+   * on the path after CalcStopPriorPath. Leaves the predictives of the
+   * sampled topic as AddCustomerToPath reads them.
+   */
+  SampleInfo Sample(const DocumentManager& dmanager,
+                    word_id_t word,
+                    int type,
+                    int current_topic,
+                    const std::vector<double>& stop_prior_path,
+                    int word_depth);
+
+ private:
+  struct WordProposal {
+    AliasTable table;
+    int num_draws;
+  };
+  WordProposal& GetWordProposal(int type);
+  int ProposeFromDocument(const DocumentManager& dmanager, word_id_t word);
+  double DocumentProposal(const std::pair<int, std::vector<int> >& topic_count, int topic) const {
+    return topic_count.second[topic] + topic_parameter_.alpha[topic];
+  }
+  /**
+   * Posterior of topic summed over depths; fills depth_weights_.
+   */
+  double TopicWeight(const std::pair<int, std::vector<int> >& topic_count,
+                     int type,
+                     int topic,
+                     const std::vector<double>& stop_prior_path,
+                     int word_depth);
+
+  const int num_topics_;
+  const int ngram_order_;
+  const bool non_graphical_;
+  const DirichletParameter& topic_parameter_;
+  RestaurantManager& rmanager_;
+  const std::vector<double>& lambda_path_;
+  SamplerContext& context_;
+  const int num_steps_;
+
+  AliasTable alpha_table_;
+  std::vector<int> doc_begins_; // [doc_id] -> first word, [num_docs] -> end
+  std::unordered_map<int, WordProposal> type2proposal_;
+  std::vector<double> depth_weights_;
+};
+
+} // namespace topiclm
+
+#endif /* _TOPICLM_MH_TOPIC_SAMPLER_HPP_ */
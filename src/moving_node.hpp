@@ -3,11 +3,11 @@
 
 #include <vector>
 #include <memory>
+#include "word.hpp"
 
 namespace topiclm {
 
 class Node;
-class Word;
 
 struct MovingNode {
   MovingNode() {}
@@ -15,7 +15,7 @@ struct MovingNode {
   Node* node;
   int depth;
   std::vector<int> table_customers;
-  std::vector<std::shared_ptr<Word> > observeds;
+  std::vector<word_id_t> observeds;
 };
  
 
@@ -14,13 +14,20 @@ namespace topiclm {
 class Node {
  public:
   friend class ChildIterator;
-  Node(int type, Node* parent) : type_(type), parent_(parent) {}
+  friend class ContextTree;
+  Node(int type, Node* parent)
+      : type_(type), parent_(parent), suffix_(nullptr), registry_idx_(-1) {}
   ~Node() {}
 
-  void EraseChild(int type) {
+  /**
+   * Detach the child of type; the returned node has to be retired by the caller.
+   */
+  Node* EraseChild(int type) {
     DeleteRegisteredChildType(type);
     auto child_it = children_.find(type);
+    Node* child = (*child_it).second;
     children_.erase(child_it);
+    return child;
   }
 
   Node* parent() const {
@@ -29,11 +36,28 @@ class Node {
   Node* child(int type) {
     auto child_it = children_.find(type);
     if (child_it != children_.end()) {
-      return (*child_it).second.get();
+      return (*child_it).second;
     } else {
       return nullptr;
     }
   }
+  /**
+   * The node of this context without its most recent word (the root for the
+   * nodes of depth 1), or nullptr if it is not in the tree. The parent is the
+   * context without its oldest word.
+   */
+  Node* suffix_link() const {
+    return suffix_;
+  }
+  /**
+   * The node of the context (type, this context), i.e. the node whose suffix
+   * link is this, or nullptr.
+   */
+  Node* extension(int type) {
+    if (parent_ == nullptr) return child(type);
+    auto it = extensions_.find(type);
+    return it != extensions_.end() ? (*it).second : nullptr;
+  }
   int depth() const {
     int depth = 0;
     for (Node* current = parent_;
@@ -44,9 +68,9 @@ class Node {
   ChildMapType::iterator begin() { return children_.begin(); }
   ChildMapType::iterator end() { return children_.end(); }
 
-  Node* set_child(int type, Node* parent) {
-    children_[type].reset(new Node(type, parent));
-    return children_[type].get();
+  Node* set_child(int type, Node* child) {
+    children_[type] = child;
+    return child;
   }
   void add_type2child(int type, Node* child) {
     auto& child_nodes = type2child_nodes_[type];
@@ -93,6 +117,13 @@ class Node {
   
   int type_;
   Node* parent_;
+  // maintained by the tree; not serialized but rebuilt on reading
+  Node* suffix_;
+  ChildMapType extensions_; // most recent word -> node (unused at the root)
+  // children of the nodes whose suffix link is this, waiting for their own
+  // suffix (the child of this of the same type) to be created
+  boost::container::flat_map<int, std::vector<Node*> > orphans_;
+  int registry_idx_; // position in the depth2nodes of the tree
 
   friend class pfi::data::serialization::access;
   template <typename Archive>
@@ -101,8 +132,9 @@ class Node {
     std::vector<int> type_vec;
     if (ar.is_read) {
       ar & type_vec;
+      // children are allocated by the tree when it reads them
       for (int type : type_vec) {
-        children_[type].reset(new Node(type, this));
+        children_[type] = nullptr;
       }
     } else {
       for (auto& child : children_) {
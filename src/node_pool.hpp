@@ -0,0 +1,95 @@
+#ifndef _TOPICLM_NODE_POOL_HPP_
+#define _TOPICLM_NODE_POOL_HPP_
+
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include "node.hpp"
+
+namespace topiclm {
+
+/**
+ * Slab arena of the nodes (and their restaurants) of a ContextTree.
+ *
+ * Nodes erased from the tree are only retired; they are destroyed and put on
+ * the free list at Reclaim(), which is called once per iteration. Contexts
+ * which disappear and come back during an iteration are then served from the
+ * free list instead of the heap, and a retired node stays readable until the
+ * end of the epoch.
+ */
+class NodePool {
+ public:
+  struct Stats {
+    size_t created = 0;   // nodes constructed
+    size_t reused = 0;    // of which served from the free list (heap allocations avoided)
+    size_t retired = 0;
+    size_t reclaimed = 0;
+    size_t slabs = 0;
+  };
+  static const size_t kSlabSize = 1024;
+
+  NodePool() : slab_used_(kSlabSize) {}
+  ~NodePool() {
+    Reclaim();
+  }
+
+  Node* New(int type, Node* parent) {
+    void* slot;
+    if (!free_.empty()) {
+      slot = free_.back();
+      free_.pop_back();
+      ++stats_.reused;
+    } else {
+      if (slab_used_ == kSlabSize) {
+        slabs_.emplace_back(new Slot[kSlabSize]);
+        slab_used_ = 0;
+        ++stats_.slabs;
+      }
+      slot = &slabs_.back()[slab_used_++];
+    }
+    ++stats_.created;
+    return new (slot) Node(type, parent);
+  }
+  /**
+   * The node must already be detached from the tree.
+   */
+  void Retire(Node* node) {
+    retired_.push_back(node);
+    ++stats_.retired;
+  }
+  /**
+   * Destroy immediately (the node must not be referenced anymore).
+   */
+  void Delete(Node* node) {
+    node->~Node();
+    free_.push_back(node);
+  }
+  void Reclaim() {
+    for (Node* node : retired_) {
+      Delete(node);
+    }
+    stats_.reclaimed += retired_.size();
+    retired_.clear();
+  }
+
+  size_t num_live() const {
+    return stats_.slabs * kSlabSize - (kSlabSize - slab_used_) - free_.size() - retired_.size();
+  }
+  const Stats& stats() const { return stats_; }
+
+ private:
+  typedef std::aligned_storage<sizeof(Node), alignof(Node)>::type Slot;
+
+  NodePool(const NodePool&);
+  NodePool& operator=(const NodePool&);
+
+  std::vector<std::unique_ptr<Slot[]> > slabs_;
+  size_t slab_used_; // slots handed out from the last slab
+  std::vector<void*> free_;
+  std::vector<Node*> retired_;
+  Stats stats_;
+};
+
+} // namespace topiclm
+
+#endif /* _TOPICLM_NODE_POOL_HPP_ */
@@ -7,7 +7,7 @@ using namespace std;
 namespace topiclm {
 
 double CalcLambdaCPosterior(
-    const std::set<Node*>& some_depth_nodes,
+    const std::vector<Node*>& some_depth_nodes,
     double c,
     double gamma_a,
     double gamma_b);
@@ -52,7 +52,7 @@ void Parameters::SamplingAlpha(
   alpha_sampler_->Update(doc2topic_counts, topic_parameter_);
 }
 void Parameters::SamplingLambdaConcentration(
-    const std::vector<std::set<Node*> >& depth2wnodes) {
+    const Depth2Nodes& depth2wnodes) {
   for (size_t i = 0; i < depth2wnodes.size(); ++i) {
     double posterior
         = CalcLambdaCPosterior(depth2wnodes[i], lambda_parameter_.c[i], 1.0, 1.0);
@@ -69,7 +69,7 @@ void Parameters::SetHpySampler(HyperSamplerType sampler_type) {
   }
 }
 void Parameters::SamplingHpyParameter(
-    const std::vector<std::set<Node*> >& depth2wnodes) {
+    const Depth2Nodes& depth2wnodes) {
   hpy_sampler_->Update(depth2wnodes, hpy_parameter_);
 }
 
@@ -96,7 +96,7 @@ string Parameters::OutputHypers() {
 }
 
 double CalcLambdaCPosterior(
-    const std::set<Node*>& some_depth_nodes,
+    const std::vector<Node*>& some_depth_nodes,
     double c,
     double gamma_a,
     double gamma_b) {
@@ -32,7 +32,9 @@ class HPYParameter {
         depth2cache_discounts(ngram_order, discount),
         depth2cache_concentrations(ngram_order, concentration),
         prior_pass_(prior_pass),
-        prior_stop_(prior_stop) {}
+        prior_stop_(prior_stop) {
+    BuildDepthMajor();
+  }
   double discount(int depth, int floor_id) const {
     return topic_depth2discounts[floor_id][depth];
   }
@@ -51,11 +53,22 @@ class HPYParameter {
   double prior_stop() const {
     return prior_stop_;
   }
+  /**
+   * Discounts and concentrations of all floors at depth, contiguous (for
+   * dense floors).
+   */
+  const double* depth_discounts(int depth) const {
+    return depth2topic_discounts[depth].data();
+  }
+  const double* depth_concentrations(int depth) const {
+    return depth2topic_concentrations[depth].data();
+  }
   const std::vector<double>& depth2discount() const { return topic_depth2discounts[0]; }
   const std::vector<double>& depth2concentration() const { return topic_depth2concentrations[0]; }
   
   void set_discount(int depth, int floor_id, double discount) {
     topic_depth2discounts[floor_id][depth] = discount;
+    depth2topic_discounts[depth][floor_id] = discount;
   }
   void set_cache_discount(int depth, double discount) {
     depth2cache_discounts[depth] = discount;
@@ -65,12 +78,30 @@ class HPYParameter {
   }
   void set_concentration(int depth, int floor_id, double concentration) {
     topic_depth2concentrations[floor_id][depth] = concentration;
+    depth2topic_concentrations[depth][floor_id] = concentration;
   }
  private:
+  void BuildDepthMajor() {
+    int num_floors = topic_depth2discounts.size();
+    int ngram_order = num_floors > 0 ? topic_depth2discounts[0].size() : 0;
+    depth2topic_discounts.assign(ngram_order, std::vector<double>(num_floors));
+    depth2topic_concentrations.assign(ngram_order, std::vector<double>(num_floors));
+    for (int j = 0; j < num_floors; ++j) {
+      for (int i = 0; i < ngram_order; ++i) {
+        depth2topic_discounts[i][j] = topic_depth2discounts[j][i];
+        depth2topic_concentrations[i][j] = topic_depth2concentrations[j][i];
+      }
+    }
+  }
+
+
   std::vector<std::vector<double> > topic_depth2discounts;
   std::vector<std::vector<double> > topic_depth2concentrations;
   std::vector<double> depth2cache_discounts;
   std::vector<double> depth2cache_concentrations;
+  // transposed copies of the above, not serialized
+  std::vector<std::vector<double> > depth2topic_discounts;
+  std::vector<std::vector<double> > depth2topic_concentrations;
   
   double prior_pass_;
   double prior_stop_;
@@ -84,6 +115,7 @@ class HPYParameter {
         & MEMBER(depth2cache_concentrations)
         & MEMBER(prior_pass_)
         & MEMBER(prior_stop_);
+    if (ar.is_read) BuildDepthMajor();
   }
 };
 
@@ -159,9 +191,9 @@ class Parameters {
       const std::vector<std::pair<int, std::vector<int> > >& doc2topic_counts,
       const std::vector<std::vector<std::vector<int> > >& doc2topic2tables);
   void SamplingLambdaConcentration(
-      const std::vector<std::set<Node*> >& depth2wnodes);
+      const Depth2Nodes& depth2wnodes);
   void SamplingHpyParameter(
-      const std::vector<std::set<Node*> >& depth2wnodes);
+      const Depth2Nodes& depth2wnodes);
 
   std::string OutputHypers();
   
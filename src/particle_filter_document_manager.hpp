@@ -1,6 +1,7 @@
 #ifndef _TOPICLM_PARTICLE_FILTER_DOCUMENT_MANAGER_HPP_
 #define _TOPICLM_PARTICLE_FILTER_DOCUMENT_MANAGER_HPP_
 
+#include <memory>
 #include <pficommon/data/intern.h>
 #include "word.hpp"
 
@@ -8,13 +9,18 @@ namespace topiclm {
 
 class Reader;
 
+/**
+ * Documents and topics of the particles of the current document. Copies
+ * share the documents given by Read (e.g. to evaluate them on several
+ * threads); Reset gives a copy its own empty document.
+ */
 class ParticleFilterDocumentManager {
  public:
   ParticleFilterDocumentManager(pfi::data::intern<std::string>& intern,
                                 int num_particles,
                                 int num_topics,
                                 int ngram_order)
-      : particle2topic_seq_(num_particles),
+      : doc2token_seq_(std::make_shared<Documents>()),
         particle2topic_count_(num_particles),
         intern_(intern),
         num_particles_(num_particles),
@@ -44,40 +50,66 @@ class ParticleFilterDocumentManager {
                      bool consider_global);
 
   void Reset();
+  /**
+   * Replace the topics of particle to with those of particle from.
+   */
+  void CopyParticle(int from, int to) {
+    for (size_t idx = 0; idx < words_.size(); ++idx) {
+      topics_[idx * num_particles_ + to] = topics_[idx * num_particles_ + from];
+      generals_[idx * num_particles_ + to] = generals_[idx * num_particles_ + from];
+    }
+    particle2topic_count_[to] = particle2topic_count_[from];
+  }
 
-  int doc_num_words() { return particle2words_[0].size(); }
-  int num_docs() const { return doc2token_seq_.size(); }
+  int doc_num_words() const { return words_.size(); }
+  int num_docs() const { return doc2token_seq_->size(); }
   int num_particles() const { return num_particles_; }
   int lexicon() const { return intern_.size(); }
   pfi::data::intern<std::string>& intern() { return intern_; }
-  int current_doc_size() const { return doc2token_seq_[current_doc_id_].size(); }
+  int current_doc_size() const { return (*doc2token_seq_)[current_doc_id_].size(); }
   
   const std::pair<int, std::vector<int> >& topic_count(int particle) const {
     return particle2topic_count_[particle];
   }
-  Word& word(int particle, int idx) {
-    return particle2words_[particle][idx];
+  const std::vector<std::pair<int, std::vector<int> > >& particle2topic_count() const {
+    return particle2topic_count_;
   }
+  /**
+   * idx-th word of the current document (shared by the particles; its
+   * is_general is not used).
+   */
+  const Word& word(int idx) const { return words_[idx]; }
   int token(const Word& word) const {
-    return doc2token_seq_[word.doc_id][word.sent_idx][word.token_idx];
-  }
-  int topic(int particle, const Word& word) const {
-    return particle2topic_seq_[particle][word.sent_idx][word.token_idx];
+    return (*doc2token_seq_)[word.doc_id][word.sent_idx][word.token_idx];
   }
   const std::vector<int>& sentence(const Word& word) const {
-    return doc2token_seq_[word.doc_id][word.sent_idx];
+    return (*doc2token_seq_)[word.doc_id][word.sent_idx];
+  }
+  int topic(int particle, int idx) const {
+    return topics_[idx * num_particles_ + particle];
+  }
+  bool is_general(int particle, int idx) const {
+    return generals_[idx * num_particles_ + particle];
   }
 
-  void set_topic(int particle, Word& word, int topic) {
-    particle2topic_seq_[particle][word.sent_idx][word.token_idx] = topic;
+  void set_topic(int particle, int idx, int topic) {
+    topics_[idx * num_particles_ + particle] = topic;
+  }
+  void set_general(int particle, int idx, bool is_general) {
+    generals_[idx * num_particles_ + particle] = is_general;
   }
 
  private:
-  std::vector<std::vector<std::vector<int> > > doc2token_seq_; // [doc_id][sent_idx][token_idx]
-  std::vector<std::vector<std::vector<int> > > particle2topic_seq_; // [particle][sent_idx][token_idx]
+  typedef std::vector<std::vector<std::vector<int> > > Documents; // [doc_id][sent_idx][token_idx]
+
+  std::shared_ptr<Documents> doc2token_seq_;
   std::vector<std::pair<int, std::vector<int> > > particle2topic_count_;
 
-  std::vector<std::vector<Word> > particle2words_;
+  // words of the current document, and the topics of all particles in
+  // [idx * num_particles + particle], so that a word's topics are adjacent
+  std::vector<Word> words_;
+  std::vector<topic_t> topics_;
+  std::vector<bool> generals_;
 
   int current_doc_id_;
   pfi::data::intern<std::string>& intern_;
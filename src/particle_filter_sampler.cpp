@@ -1,28 +1,61 @@
 #include <iostream>
 #include <cassert>
-#include "topiclm.hpp"
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
 #include "document_manager.hpp"
 #include "particle_filter_sampler.hpp"
 #include "particle_filter_document_manager.hpp"
-#include "topic_sampler.hpp"
+#include "sampler_context.hpp"
+#include "parameters.hpp"
+#include "test_predictor.hpp"
 #include "util.hpp"
-#include "restaurant_manager.hpp"
 
 using namespace std;
 
 namespace topiclm {
 
-ParticleFilterSampler::ParticleFilterSampler(HpyLdaSampler& hpy_lda_sampler,
+ParticleFilterSampler::ParticleFilterSampler(TestPredictor& predictor,
+                                             const Parameters& parameters,
+                                             TreeType tree_type,
+                                             SamplerContext& context,
                                              ParticleFilterDocumentManager& pf_dmanager,
                                              int step)
-    : hpy_lda_sampler_(hpy_lda_sampler),
+    : predictor_(predictor),
+      kernel_(parameters, tree_type, context),
+      context_(context),
+      consider_general_(tree_type == kNonGraphical),
       pf_dmanager_(pf_dmanager),
       num_particles_(pf_dmanager.num_particles()),
       step_(step),
+      log_weights_(pf_dmanager.num_particles(), 0.0),
+      doc_history_(parameters.topic_parameter().num_topics, parameters.ngram_order()),
       particle2sampled_topics_(pf_dmanager.num_particles()) {
   assert(step_ > 0);
 }
 
+ParticleFilterSampler::ParticleFilterSampler(TestPredictor& predictor,
+                                             const Parameters& parameters,
+                                             TreeType tree_type,
+                                             int seed,
+                                             uint64_t stream,
+                                             ParticleFilterDocumentManager& pf_dmanager,
+                                             int step)
+    : predictor_(predictor),
+      own_context_(new SamplerContext(seed, stream)),
+      kernel_(parameters, tree_type, *own_context_),
+      context_(*own_context_),
+      consider_general_(tree_type == kNonGraphical),
+      pf_dmanager_(pf_dmanager),
+      num_particles_(pf_dmanager.num_particles()),
+      step_(step),
+      log_weights_(pf_dmanager.num_particles(), 0.0),
+      doc_history_(parameters.topic_parameter().num_topics, parameters.ngram_order()),
+      particle2sampled_topics_(pf_dmanager.num_particles()) {
+  assert(step_ > 0);
+}
+
+ParticleFilterSampler::ParticleFilterSampler(ParticleFilterSampler&& other) = default;
 ParticleFilterSampler::~ParticleFilterSampler() {}
 
 double ParticleFilterSampler::Run(std::ostream& os) {
@@ -31,42 +64,52 @@ double ParticleFilterSampler::Run(std::ostream& os) {
   int num_docs = pf_dmanager_.num_docs();
   for (int d = 0; d < num_docs; ++d) {
     cerr << setw(2) << d << "/" << num_docs << "\r";
-    pf_dmanager_.SetCurrentDoc(d);
-    os << "doc" << d << ":" << endl;
+    ll += RunDocument(d, os);
+    num_samples += pf_dmanager_.doc_num_words();
+  }
+  return exp(-ll / num_samples);
+}
 
-    Reset();
+double ParticleFilterSampler::RunDocument(int d, std::ostream& os) {
+  SamplerContext::Scope scope(context_);
+  pf_dmanager_.SetCurrentDoc(d);
+  // each document has its own random stream (apart from those of training
+  // workers), so its result does not depend on the other documents
+  context_.set_stream((uint64_t(1) << 32) + d);
+  os << "doc" << d << ":" << endl;
+
+  Reset();
     
-    int num_words = pf_dmanager_.doc_num_words();
-    for (int i = 0; i < num_words; ++i) {
-      if (i % step_ == 0) {
-        Resample(i);
-      }
-      auto& word = pf_dmanager_.word(0, i);
-      CalcCurrentPredictives(word);
-      
-      double p_w = SampleTopic(i);
-      ll += log(p_w);
-      ++num_samples;
-      //os << getWord(pf_dmanager_.token(word), pf_dmanager_.intern()) << "\t" << p_w << endl;
-      os << getWord(pf_dmanager_.token(word), pf_dmanager_.intern()) << "\t" << p_w << "\t" << doc_lambda_paths_[i][doc_word_depths_[i]] << endl;
+  double ll = 0;
+  int num_words = pf_dmanager_.doc_num_words();
+  for (int i = 0; i < num_words; ++i) {
+    if (i % step_ == 0) {
+      Rejuvenate(i);
     }
+    auto& word = pf_dmanager_.word(i);
+    CalcCurrentPredictives(word);
+      
+    double p_w = SampleTopic(i);
+    ll += log(p_w);
+    //os << getWord(pf_dmanager_.token(word), pf_dmanager_.intern()) << "\t" << p_w << endl;
+    os << getWord(pf_dmanager_.token(word), pf_dmanager_.intern()) << "\t" << p_w << "\t" << predictor_.lambda_path()[doc_history_.word_depth(i)] << endl;
   }
-  return exp(-ll / num_samples);
+  return ll;
 }
 
 void ParticleFilterSampler::ResampleAll() {
+  SamplerContext::Scope scope(context_);
   int current_idx = pf_dmanager_.doc_num_words() - 1;
   Resample(current_idx);
 }
 
 void ParticleFilterSampler::Reset() {
-  doc_predictives_.clear();
-  doc_stop_priors_.clear();
-  doc_lambda_paths_.clear();
-  doc_word_depths_.clear();
+  doc_history_.clear();
+  fill(log_weights_.begin(), log_weights_.end(), 0.0);
 }
 
 double ParticleFilterSampler::log_probability(const std::vector<int>& sentence, bool store) {
+  SamplerContext::Scope scope(context_);
   double ll = 0;
 
   if (store) {
@@ -81,53 +124,39 @@ double ParticleFilterSampler::log_probability(const std::vector<int>& sentence,
   }
 
   for (size_t idx = 0; idx < sentence.size(); ++idx) {
-    int type = sentence[idx];
-    int word_depth = hpy_lda_sampler_.cmanager_.WalkTreeNoCreate(sentence, idx - 1, 0);
-    
-    hpy_lda_sampler_.cmanager_.CalcTestStopPriorPath(word_depth);
-    auto& rmanager = hpy_lda_sampler_.cmanager_.rmanager();
-    rmanager.CalcDepth2TopicPredictives(type, word_depth, true);
+    int word_depth = predictor_.CalcTestPredictives(sentence, idx);
     
-    auto& predictives = rmanager.depth2topic_predictives();
+    auto& predictives = predictor_.depth2topic_predictives();
     
-    auto& stop_prior_path = hpy_lda_sampler_.cmanager_.stop_prior_path();
-    auto& lambda_path = hpy_lda_sampler_.cmanager_.lambda_path();
+    auto& stop_prior_path = predictor_.stop_prior_path();
+    auto& lambda_path = predictor_.lambda_path();
 
-    double p_w = 0;
-
-    for (int particle = 0; particle < num_particles_; ++particle) {
-      auto& topic_sampler = hpy_lda_sampler_.topic_sampler_;
-      topic_sampler->InitWithTopicPrior(pf_dmanager_.topic_count(particle),
-                                        lambda_path,
-                                        word_depth);
-      topic_sampler->TakeInStopPrior(stop_prior_path);
-      topic_sampler->TakeInLikelihood(predictives);
-
-      p_w += topic_sampler->CalcMarginal();
+    kernel_.TakeInWord(stop_prior_path, predictives, lambda_path, word_depth);
+    double p_w = kernel_.CalcMarginals(pf_dmanager_.particle2topic_count());
+    if (rejuvenation_.bounded()) {
+      p_w = WeightedMarginal(store);
+    }
 
-      if (store) {
-        particle2sampled_topics_[particle][idx] = topic_sampler->Sample().topic;
-        sentence_word_depths_[idx] = word_depth;
+    if (store) {
+      for (int particle = 0; particle < num_particles_; ++particle) {
+        particle2sampled_topics_[particle][idx] = kernel_.Sample(particle).topic;
       }
+      sentence_word_depths_[idx] = word_depth;
     }
-    p_w /= num_particles_;
     assert(p_w > 0 && p_w <= 1.0);
     ll += std::log(p_w);
     
     if (store) {
-      doc_predictives_.push_back(predictives);
-      doc_stop_priors_.push_back(stop_prior_path);
-      doc_lambda_paths_.push_back(lambda_path);
-      doc_word_depths_.push_back(word_depth);
+      doc_history_.Push(stop_prior_path, predictives, lambda_path, word_depth);
     }
   }
   if (store) {
     pf_dmanager_.StoreSentence(sentence,
                                particle2sampled_topics_,
                                sentence_word_depths_,
-                               hpy_lda_sampler_.ConsiderGeneral());
+                               consider_general_);
     if (pf_dmanager_.current_doc_size() % step_ == 0) {
-      ResampleAll();
+      Rejuvenate(pf_dmanager_.doc_num_words() - 1);
     }
   }
   
@@ -136,65 +165,140 @@ double ParticleFilterSampler::log_probability(const std::vector<int>& sentence,
 
 void ParticleFilterSampler::Resample(int current_idx) {
   for (int i = 0; i < current_idx; ++i) {
+    ResampleWord(i);
+  }
+}
+
+void ParticleFilterSampler::Rejuvenate(int current_idx) {
+  if (!rejuvenation_.bounded()) {
+    Resample(current_idx);
+    return;
+  }
+  if (rejuvenation_.ess_threshold < 1.0 &&
+      EffectiveSampleSize() >= rejuvenation_.ess_threshold * num_particles_) {
+    return;
+  }
+  ResampleParticles();
+  int window_begin = max(current_idx - rejuvenation_.window, 0);
+  for (int i = 0; i < rejuvenation_.budget && window_begin > 0; ++i) {
+    ResampleWord(context_.random().NextMult(window_begin));
+  }
+  for (int i = window_begin; i < current_idx; ++i) {
+    ResampleWord(i);
+  }
+}
+
+void ParticleFilterSampler::ResampleWord(int idx) {
+  TakeInWord(idx);
+  for (int m = 0; m < num_particles_; ++m) {
+    pf_dmanager_.DecrementTopicCount(m, pf_dmanager_.topic(m, idx), pf_dmanager_.is_general(m, idx));
+  }
+  kernel_.CalcMarginals(pf_dmanager_.particle2topic_count());
+  for (int m = 0; m < num_particles_; ++m) {
+    auto sample = kernel_.Sample(m);
+    bool is_general = consider_general_ && sample.topic == 0;
+    pf_dmanager_.IncrementTopicCount(m, sample.topic, is_general);
+    pf_dmanager_.set_topic(m, idx, sample.topic);
+    pf_dmanager_.set_general(m, idx, is_general);
+  }
+}
+
+void ParticleFilterSampler::ResampleParticles() {
+  // systematic resampling
+  double max_log_weight = *max_element(log_weights_.begin(), log_weights_.end());
+  vector<double> weights(num_particles_);
+  double total = 0;
+  for (int m = 0; m < num_particles_; ++m) {
+    weights[m] = exp(log_weights_[m] - max_log_weight);
+    total += weights[m];
+  }
+  vector<int> offsprings(num_particles_, 0);
+  double interval = total / num_particles_;
+  double point = context_.random().NextDouble() * interval;
+  double cum = weights[0];
+  int m = 0;
+  for (int n = 0; n < num_particles_; ++n, point += interval) {
+    while (point >= cum && m < num_particles_ - 1) {
+      cum += weights[++m];
+    }
+    ++offsprings[m];
+  }
+  // a surviving particle stays in place, so that only the slots of the
+  // others are overwritten by its extra copies
+  int to = 0;
+  for (int from = 0; from < num_particles_; ++from) {
+    for (int i = 1; i < offsprings[from]; ++i) {
+      while (offsprings[to] != 0) ++to;
+      pf_dmanager_.CopyParticle(from, to);
+      offsprings[to] = -1;
+    }
+  }
+  fill(log_weights_.begin(), log_weights_.end(), 0.0);
+}
+
+double ParticleFilterSampler::EffectiveSampleSize() const {
+  double max_log_weight = *max_element(log_weights_.begin(), log_weights_.end());
+  double sum = 0, square_sum = 0;
+  for (double log_weight : log_weights_) {
+    double weight = exp(log_weight - max_log_weight);
+    sum += weight;
+    square_sum += weight * weight;
+  }
+  return sum * sum / square_sum;
+}
+
+double ParticleFilterSampler::WeightedMarginal(bool update) {
+  double max_log_weight = *max_element(log_weights_.begin(), log_weights_.end());
+  double total = 0;
+  double p_w = 0;
+  for (int m = 0; m < num_particles_; ++m) {
+    double weight = exp(log_weights_[m] - max_log_weight);
+    total += weight;
+    p_w += weight * kernel_.marginal(m);
+  }
+  if (update) {
     for (int m = 0; m < num_particles_; ++m) {
-      auto& word = pf_dmanager_.word(m, i);
-      int topic = pf_dmanager_.topic(m, word);
-      int word_depth = doc_word_depths_[i];
-      pf_dmanager_.DecrementTopicCount(m, topic, word.is_general);
-
-      hpy_lda_sampler_.topic_sampler_->InitWithTopicPrior(pf_dmanager_.topic_count(m),
-                                                          doc_lambda_paths_[i],
-                                                          word_depth);
-      hpy_lda_sampler_.topic_sampler_->TakeInStopPrior(doc_stop_priors_[i]);
-      hpy_lda_sampler_.topic_sampler_->TakeInLikelihood(doc_predictives_[i]);
-
-      auto sample = hpy_lda_sampler_.topic_sampler_->Sample();
-      if (hpy_lda_sampler_.ConsiderGeneral()) {
-        word.is_general = sample.topic == 0;
-      }
-      pf_dmanager_.IncrementTopicCount(m, sample.topic, word.is_general);
-      pf_dmanager_.set_topic(m, word, sample.topic);
+      log_weights_[m] += log(kernel_.marginal(m)) - max_log_weight;
     }
   }
+  return p_w / total;
 }
 
 void ParticleFilterSampler::CalcCurrentPredictives(const Word& word) {
   auto& sent = pf_dmanager_.sentence(word);
-  int type = pf_dmanager_.token(word);
-  int word_depth = hpy_lda_sampler_.cmanager_.WalkTreeNoCreate(sent, word.token_idx - 1, 0);
-  hpy_lda_sampler_.cmanager_.CalcTestStopPriorPath(word_depth);
-  hpy_lda_sampler_.cmanager_.rmanager().CalcDepth2TopicPredictives(type, word_depth, true);
-  auto& predictives = hpy_lda_sampler_.cmanager_.rmanager().depth2topic_predictives();
+  int word_depth = predictor_.CalcTestPredictives(sent, word.token_idx);
   
-  doc_predictives_.push_back(predictives);
-  doc_stop_priors_.push_back(hpy_lda_sampler_.cmanager_.stop_prior_path());
-  doc_lambda_paths_.push_back(hpy_lda_sampler_.cmanager_.lambda_path());
-  doc_word_depths_.push_back(word_depth);
+  doc_history_.Push(predictor_.stop_prior_path(),
+                    predictor_.depth2topic_predictives(),
+                    predictor_.lambda_path(),
+                    word_depth);
+}
+
+void ParticleFilterSampler::TakeInWord(int idx) {
+  kernel_.TakeInWord(doc_history_.stop_priors(idx),
+                     doc_history_.likelihoods(idx),
+                     doc_history_.lambdas(idx),
+                     doc_history_.num_depths(idx));
 }
 
 double ParticleFilterSampler::SampleTopic(int current_idx) {
-  assert(current_idx == (int)doc_predictives_.size() - 1);
-  double p_w = 0;
+  assert(current_idx == doc_history_.size() - 1);
+  // from the exact values of the predictor, not the history (see history_t)
+  kernel_.TakeInWord(predictor_.stop_prior_path(),
+                     predictor_.depth2topic_predictives(),
+                     predictor_.lambda_path(),
+                     doc_history_.word_depth(current_idx));
+  double p_w = kernel_.CalcMarginals(pf_dmanager_.particle2topic_count());
+  if (rejuvenation_.bounded()) {
+    p_w = WeightedMarginal(true);
+  }
   for (int m = 0; m < num_particles_; ++m) {
-    auto& word_m = pf_dmanager_.word(m, current_idx);
-    int word_depth = doc_word_depths_[current_idx];
-
-    hpy_lda_sampler_.topic_sampler_->InitWithTopicPrior(pf_dmanager_.topic_count(m),
-                                                        doc_lambda_paths_[current_idx],
-                                                        word_depth);
-    hpy_lda_sampler_.topic_sampler_->TakeInStopPrior(doc_stop_priors_[current_idx]);
-    hpy_lda_sampler_.topic_sampler_->TakeInLikelihood(doc_predictives_[current_idx]);
-    
-    auto sample = hpy_lda_sampler_.topic_sampler_->Sample();
-    if (hpy_lda_sampler_.ConsiderGeneral()) {
-      word_m.is_general = sample.topic == 0;
-    }
-    p_w += sample.p_w;
-
-    pf_dmanager_.IncrementTopicCount(m, sample.topic, word_m.is_general);
-    pf_dmanager_.set_topic(m, word_m, sample.topic);
+    auto sample = kernel_.Sample(m);
+    bool is_general = consider_general_ && sample.topic == 0;
+    pf_dmanager_.IncrementTopicCount(m, sample.topic, is_general);
+    pf_dmanager_.set_topic(m, current_idx, sample.topic);
+    pf_dmanager_.set_general(m, current_idx, is_general);
   }
-  p_w /= num_particles_;
   assert(p_w <= 1.0);
   return p_w;
 }
@@ -2,22 +2,71 @@
 #define _TOPICLM_PARTICLE_FILTER_SAMPLER_HPP_
 
 #include <vector>
+#include <memory>
 #include <ostream>
+#include "config.hpp"
+#include "particle_topic_kernel.hpp"
+#include "predictive_history.hpp"
 
 namespace topiclm {
 
-class HpyLdaSampler;
+class TestPredictor;
+class Parameters;
+class SamplerContext;
 class ParticleFilterDocumentManager;
 struct Word;
 
+/**
+ * Which past topics are resampled at each step. By default all past words
+ * are (O(n^2) in the document length with step 1). When bounded, a step
+ * resamples only the last window words and budget words drawn from the rest
+ * at random, and only when the effective sample size of the particle
+ * weights is below ess_threshold * (# particles); the particles themselves
+ * are then resampled by their weights first. ess_threshold 1 rejuvenates at
+ * every step.
+ */
+struct RejuvenationPolicy {
+  RejuvenationPolicy() : window(0), budget(0), ess_threshold(0.5) {}
+
+  bool bounded() const { return window > 0 || budget > 0; }
+
+  int window;
+  int budget;
+  double ess_threshold;
+};
+
 class ParticleFilterSampler {
  public:
-  ParticleFilterSampler(HpyLdaSampler& hpy_lda_sampler,
+  /**
+   * predictor is either the training tree (ContextTreeManager) or a
+   * compiled FrozenPredictor.
+   */
+  ParticleFilterSampler(TestPredictor& predictor,
+                        const Parameters& parameters,
+                        TreeType tree_type,
+                        SamplerContext& context,
                         ParticleFilterDocumentManager& pf_dmanager,
                         int step);
+  /**
+   * The same with a context of its own, drawing from stream of seed.
+   */
+  ParticleFilterSampler(TestPredictor& predictor,
+                        const Parameters& parameters,
+                        TreeType tree_type,
+                        int seed,
+                        uint64_t stream,
+                        ParticleFilterDocumentManager& pf_dmanager,
+                        int step);
+  ParticleFilterSampler(ParticleFilterSampler&& other);
   ~ParticleFilterSampler();
 
+  void set_rejuvenation(const RejuvenationPolicy& rejuvenation) { rejuvenation_ = rejuvenation; }
+
   double Run(std::ostream& os);
+  /**
+   * Evaluate document d as Run does; returns its log likelihood.
+   */
+  double RunDocument(int d, std::ostream& os);
 
   void ResampleAll();
   void Reset();
@@ -26,18 +75,31 @@ class ParticleFilterSampler {
   
  private:
   void Resample(int current_idx);
+  void Rejuvenate(int current_idx);
+  void ResampleWord(int idx);
+  void ResampleParticles();
+  double EffectiveSampleSize() const;
+  /**
+   * p(w) of the current word by the particle weights; then weight the
+   * particles by their marginals if update.
+   */
+  double WeightedMarginal(bool update);
   void CalcCurrentPredictives(const Word& word);
+  void TakeInWord(int idx);
   double SampleTopic(int current_idx);
   
-  HpyLdaSampler& hpy_lda_sampler_;
+  TestPredictor& predictor_;
+  std::unique_ptr<SamplerContext> own_context_; // if not given one
+  ParticleTopicKernel kernel_;
+  SamplerContext& context_;
+  const bool consider_general_;
   ParticleFilterDocumentManager& pf_dmanager_;
   const int num_particles_;
   const int step_;
+  RejuvenationPolicy rejuvenation_;
+  std::vector<double> log_weights_; // only tracked if rejuvenation_ is bounded
   
-  std::vector<std::vector<std::vector<double> > > doc_predictives_;
-  std::vector<std::vector<double> > doc_stop_priors_;
-  std::vector<std::vector<double> > doc_lambda_paths_;
-  std::vector<int> doc_word_depths_;
+  PredictiveHistory doc_history_;
 
   // local cache for one sentence
   std::vector<std::vector<int> > particle2sampled_topics_;
@@ -0,0 +1,196 @@
+#include <cassert>
+#include "particle_topic_kernel.hpp"
+#include "parameters.hpp"
+#include "sampler_context.hpp"
+#include "cpu_features.hpp"
+
+using namespace std;
+
+namespace topiclm {
+
+namespace {
+
+// products[j] = (n_j * column_sums[j] + alpha_sums[j]) * inv_total; both
+// versions sum them in four lanes (j mod 4) so that the results do not
+// depend on the CPU
+double FillProductsScalar(int n,
+                          const int* topic_count,
+                          const double* column_sums,
+                          const double* alpha_sums,
+                          double inv_total,
+                          double* products) {
+  double lanes[4] = {0, 0, 0, 0};
+  int j = 0;
+  for (; j + 4 <= n; j += 4) {
+    for (int k = 0; k < 4; ++k) {
+      products[j + k] = (topic_count[j + k] * column_sums[j + k] + alpha_sums[j + k]) * inv_total;
+      lanes[k] += products[j + k];
+    }
+  }
+  double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for (; j < n; ++j) {
+    products[j] = (topic_count[j] * column_sums[j] + alpha_sums[j]) * inv_total;
+    sum += products[j];
+  }
+  return sum;
+}
+
+#ifdef TOPICLM_AVX2_DISPATCH
+TOPICLM_TARGET_AVX2
+double FillProductsAvx2(int n,
+                        const int* topic_count,
+                        const double* column_sums,
+                        const double* alpha_sums,
+                        double inv_total,
+                        double* products) {
+  __m256d inv = _mm256_set1_pd(inv_total);
+  __m256d acc = _mm256_setzero_pd();
+  int j = 0;
+  for (; j + 4 <= n; j += 4) {
+    __m256d c = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(topic_count + j)));
+    __m256d p = _mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(c, _mm256_loadu_pd(column_sums + j)),
+                                            _mm256_loadu_pd(alpha_sums + j)),
+                              inv);
+    _mm256_storeu_pd(products + j, p);
+    acc = _mm256_add_pd(acc, p);
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, acc);
+  double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for (; j < n; ++j) {
+    products[j] = (topic_count[j] * column_sums[j] + alpha_sums[j]) * inv_total;
+    sum += products[j];
+  }
+  return sum;
+}
+#endif
+
+} // namespace
+
+ParticleTopicKernel::ParticleTopicKernel(const Parameters& parameters,
+                                         TreeType tree_type,
+                                         SamplerContext& context)
+    : num_topics_(parameters.topic_parameter().num_topics),
+      ngram_order_(parameters.ngram_order()),
+      non_graphical_(tree_type == kNonGraphical),
+      topic_parameter_(parameters.topic_parameter()),
+      context_(context),
+      current_max_depth_(0),
+      weights_((num_topics_ + 1) * ngram_order_),
+      column_sums_(num_topics_ + 1),
+      alpha_sums_(num_topics_ + 1) {}
+
+void ParticleTopicKernel::TakeInWord(const std::vector<double>& stop_prior_path,
+                                     const std::vector<std::vector<double> >& likelihoods,
+                                     const std::vector<double>& lambda_path,
+                                     int word_depth) {
+  current_max_depth_ = min(word_depth + 1, ngram_order_);
+  for (int i = 0; i < current_max_depth_; ++i) {
+    TakeInDepth(i, stop_prior_path[i], lambda_path[i], likelihoods[i].data());
+  }
+  SumColumns();
+}
+
+void ParticleTopicKernel::TakeInWord(const history_t* stop_priors,
+                                     const history_t* likelihoods,
+                                     const history_t* lambdas,
+                                     int num_depths) {
+  current_max_depth_ = num_depths;
+  for (int i = 0; i < current_max_depth_; ++i) {
+    TakeInDepth(i, stop_priors[i], lambdas[i], likelihoods + i * (num_topics_ + 1));
+  }
+  SumColumns();
+}
+
+template <typename T>
+void ParticleTopicKernel::TakeInDepth(int depth, double stop, double lambda, const T* likelihood) {
+  // the non-graphical prior of the global topic does not depend on the
+  // particles, and lambda is shared by the other topics
+  double global = non_graphical_ ? stop * (1 - lambda) : stop;
+  double local = non_graphical_ ? stop * lambda : stop;
+  double* weights = &weights_[depth * (num_topics_ + 1)];
+  weights[0] = global * likelihood[0];
+  for (int j = 1; j < num_topics_ + 1; ++j) {
+    weights[j] = local * likelihood[j];
+  }
+}
+
+void ParticleTopicKernel::SumColumns() {
+  fill(column_sums_.begin(), column_sums_.end(), 0.0);
+  for (int i = 0; i < current_max_depth_; ++i) {
+    const double* weights = &weights_[i * (num_topics_ + 1)];
+    for (int j = 0; j < num_topics_ + 1; ++j) {
+      column_sums_[j] += weights[j];
+    }
+  }
+  for (int j = 0; j < num_topics_ + 1; ++j) {
+    alpha_sums_[j] = topic_parameter_.alpha[j] * column_sums_[j];
+  }
+}
+
+double ParticleTopicKernel::FillProducts(const int* topic_count,
+                                         double inv_total,
+                                         double* products) const {
+  // products[j] = (n_j + alpha_j) / (n + alpha_1) * column_sums_[j]
+  const int n = num_topics_ + 1;
+  const double* column_sums = column_sums_.data();
+  const double* alpha_sums = alpha_sums_.data();
+#ifdef TOPICLM_AVX2_DISPATCH
+  double sum = HasAvx2() ?
+      FillProductsAvx2(n, topic_count, column_sums, alpha_sums, inv_total, products) :
+      FillProductsScalar(n, topic_count, column_sums, alpha_sums, inv_total, products);
+#else
+  double sum = FillProductsScalar(n, topic_count, column_sums, alpha_sums, inv_total, products);
+#endif
+  if (non_graphical_) {
+    sum += column_sums[0] - products[0];
+    products[0] = column_sums[0];
+  }
+  return sum;
+}
+
+double ParticleTopicKernel::CalcMarginals(
+    const std::vector<std::pair<int, std::vector<int> > >& particle2topic_count) {
+  int num_particles = particle2topic_count.size();
+  products_.resize(num_particles * (num_topics_ + 1));
+  marginals_.resize(num_particles);
+  double p_w = 0;
+  for (int m = 0; m < num_particles; ++m) {
+    auto& topic_count = particle2topic_count[m];
+    marginals_[m] = FillProducts(topic_count.second.data(),
+                                 1.0 / (topic_count.first + topic_parameter_.alpha_1),
+                                 &products_[m * (num_topics_ + 1)]);
+    p_w += marginals_[m];
+  }
+  return p_w / num_particles;
+}
+
+SampleInfo ParticleTopicKernel::Sample(int particle) {
+  const double* products = &products_[particle * (num_topics_ + 1)];
+  double p_w = marginals_[particle];
+  double u = context_.random().NextDouble() * p_w;
+
+  int topic = 0;
+  double cum = 0;
+  for (int j = 0; j < num_topics_ + 1; ++j) {
+    if (products[j] <= 0) continue;
+    topic = j;
+    if (u < cum + products[j]) break;
+    cum += products[j];
+  }
+  // the depth within the column, on the scale of the column sum
+  double v = (u - cum) / products[topic] * column_sums_[topic];
+  int depth = 0;
+  cum = 0;
+  for (int i = 0; i < current_max_depth_; ++i) {
+    double w = weights_[i * (num_topics_ + 1) + topic];
+    if (w <= 0) continue;
+    depth = i;
+    if (v < cum + w) break;
+    cum += w;
+  }
+  assert(products[topic] > 0);
+  return {false, depth, topic, p_w};
+}
+
+} // namespace topiclm
@@ -0,0 +1,75 @@
+#ifndef _TOPICLM_PARTICLE_TOPIC_KERNEL_HPP_
+#define _TOPICLM_PARTICLE_TOPIC_KERNEL_HPP_
+
+#include <vector>
+#include "config.hpp"
+#include "topic_sampler.hpp"
+
+namespace topiclm {
+
+class Parameters;
+class SamplerContext;
+
+/**
+ * Topic-depth posteriors of a word for all the particles at once (the test
+ * mode counterpart of TopicDepthSampler).
+ *
+ * The posterior of particle m is q_m[j] * W[i][j] for depth i and topic j,
+ * where W (stop prior x likelihood x lambda) is shared by the particles and
+ * q_m is the topic prior from the counts of m. W and its column sums are
+ * computed once per word (TakeInWord); then a particle costs one pass over
+ * its topics for the marginal (vectorized with AVX2 when the CPU has it),
+ * and a sample draws the topic first and then the depth in its column.
+ * The random temperature is not applied.
+ */
+class ParticleTopicKernel {
+ public:
+  ParticleTopicKernel(const Parameters& parameters, TreeType tree_type, SamplerContext& context);
+
+  void TakeInWord(const std::vector<double>& stop_prior_path,
+                  const std::vector<std::vector<double> >& likelihoods,
+                  const std::vector<double>& lambda_path,
+                  int word_depth);
+  /**
+   * The same from contiguous values of num_depths depths, likelihoods in
+   * [depth * (num_topics + 1) + topic] (see PredictiveHistory).
+   */
+  void TakeInWord(const history_t* stop_priors,
+                  const history_t* likelihoods,
+                  const history_t* lambdas,
+                  int num_depths);
+  /**
+   * Compute the marginal of each particle; returns their average.
+   */
+  double CalcMarginals(const std::vector<std::pair<int, std::vector<int> > >& particle2topic_count);
+  double marginal(int particle) const { return marginals_[particle]; }
+  /**
+   * Sample the topic and depth of particle (after CalcMarginals).
+   */
+  SampleInfo Sample(int particle);
+
+ private:
+  template <typename T>
+  void TakeInDepth(int depth, double stop, double lambda, const T* likelihood);
+  void SumColumns();
+  double FillProducts(const int* topic_count, double inv_total, double* products) const;
+
+  const int num_topics_;
+  const int ngram_order_;
+  const bool non_graphical_;
+  const DirichletParameter& topic_parameter_;
+  SamplerContext& context_;
+
+  int current_max_depth_;
+  std::vector<double> weights_; // W, [depth * (num_topics + 1) + topic]
+  std::vector<double> column_sums_;
+  std::vector<double> alpha_sums_; // alpha[j] * column_sums_[j]
+
+  // particle buffers
+  std::vector<double> products_; // q_m[j] * column_sums_[j], [particle * (num_topics + 1) + topic]
+  std::vector<double> marginals_;
+};
+
+} // namespace topiclm
+
+#endif /* _TOPICLM_PARTICLE_TOPIC_KERNEL_HPP_ */
@@ -0,0 +1,39 @@
+#include <vector>
+#include "random.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+TEST(philox, known_answer) {
+  // Random123 known-answer vector of philox4x32-10 (counter = key = 0)
+  uint32_t r[4];
+  RandomPhilox::Block(0, 0, 0, r);
+  EXPECT_EQ(0x6627e8d5u, r[0]);
+  EXPECT_EQ(0xe169c58du, r[1]);
+  EXPECT_EQ(0xbc57ac4cu, r[2]);
+  EXPECT_EQ(0x9b00dbd8u, r[3]);
+}
+
+TEST(philox, addressable) {
+  TemplatureManager t_manager;
+  RandomPhilox sequential(7, 3, t_manager);
+  vector<double> uniforms(300);
+  for (auto& u : uniforms) {
+    u = sequential.NextDouble();
+    EXPECT_LE(0.0, u);
+    EXPECT_GT(1.0, u);
+  }
+  // batched draws after a single draw give the same sequence
+  RandomPhilox batched(7, 3, t_manager);
+  vector<double> batch(uniforms.size());
+  batch[0] = batched.NextDouble();
+  batched.NextDoubles(&batch[1], batch.size() - 1);
+  EXPECT_EQ(uniforms, batch);
+  // the i-th draw of a stream is reached directly
+  batched.Seek(3, 131);
+  EXPECT_EQ(uniforms[131], batched.NextDouble());
+  // other streams are different
+  batched.Seek(4, 131);
+  EXPECT_NE(uniforms[131], batched.NextDouble());
+}
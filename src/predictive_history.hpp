@@ -0,0 +1,78 @@
+#ifndef _TOPICLM_PREDICTIVE_HISTORY_HPP_
+#define _TOPICLM_PREDICTIVE_HISTORY_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include "config.hpp"
+
+namespace topiclm {
+
+/**
+ * Predictives of the words of a document in the particle filter, kept for
+ * resampling their topics. The values of a word (stop priors, lambdas and
+ * likelihoods of each topic, up to the depth of the word) are appended to
+ * one arena of history_t, so that a word costs no allocation apart from the
+ * amortized growth of the arena. The values are only read to resample the
+ * topics of past words; the current word is scored from the predictor.
+ */
+class PredictiveHistory {
+ public:
+  PredictiveHistory(int num_topics, int ngram_order)
+      : num_topics_(num_topics), ngram_order_(ngram_order) {}
+
+  void Push(const std::vector<double>& stop_prior_path,
+            const std::vector<std::vector<double> >& likelihoods,
+            const std::vector<double>& lambda_path,
+            int word_depth) {
+    Entry entry;
+    entry.offset = arena_.size();
+    entry.word_depth = word_depth;
+    entry.num_depths = std::min(word_depth + 1, ngram_order_);
+    entries_.push_back(entry);
+
+    int n = entry.num_depths;
+    arena_.insert(arena_.end(), stop_prior_path.begin(), stop_prior_path.begin() + n);
+    arena_.insert(arena_.end(), lambda_path.begin(), lambda_path.begin() + n);
+    for (int i = 0; i < n; ++i) {
+      assert((int)likelihoods[i].size() == num_topics_ + 1);
+      arena_.insert(arena_.end(), likelihoods[i].begin(), likelihoods[i].end());
+    }
+  }
+  void clear() {
+    entries_.clear();
+    arena_.clear();
+  }
+
+  int size() const { return entries_.size(); }
+  int word_depth(int idx) const { return entries_[idx].word_depth; }
+  int num_depths(int idx) const { return entries_[idx].num_depths; }
+  const history_t* stop_priors(int idx) const {
+    return &arena_[entries_[idx].offset];
+  }
+  const history_t* lambdas(int idx) const {
+    return stop_priors(idx) + entries_[idx].num_depths;
+  }
+  /**
+   * [depth * (# topics + 1) + topic]
+   */
+  const history_t* likelihoods(int idx) const {
+    return stop_priors(idx) + 2 * entries_[idx].num_depths;
+  }
+
+ private:
+  struct Entry {
+    size_t offset;
+    int word_depth;
+    int num_depths;
+  };
+
+  const int num_topics_;
+  const int ngram_order_;
+  std::vector<Entry> entries_;
+  std::vector<history_t> arena_;
+};
+
+} // namespace topiclm
+
+#endif /* _TOPICLM_PREDICTIVE_HISTORY_HPP_ */
@@ -7,6 +7,9 @@
 #include <climits>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
 #include <unordered_map>
 
 namespace {
@@ -44,10 +47,27 @@ class TemplatureManager {
 
 class RandomBase {
 public:
-  RandomBase(TemplatureManager& t_manager) : t_manager_(t_manager) {}
+  RandomBase(TemplatureManager& t_manager)
+      : t_manager_(t_manager), uniform_pos_(kUniformBatch) {}
   virtual ~RandomBase() {}
 
-  virtual double NextDouble() = 0;
+  // uniform in [0, 1), served from a batch so that the virtual call is amortized
+  double NextDouble() {
+    if (uniform_pos_ == kUniformBatch) {
+      FillUniforms(uniforms_, kUniformBatch);
+      uniform_pos_ = 0;
+    }
+    return uniforms_[uniform_pos_++];
+  }
+  // n uniforms at once; the same values as n calls of NextDouble()
+  void NextDoubles(double* out, size_t n) {
+    size_t buffered = std::min(n, kUniformBatch - uniform_pos_);
+    std::memcpy(out, uniforms_ + uniform_pos_, buffered * sizeof(double));
+    uniform_pos_ += buffered;
+    if (n > buffered) {
+      FillUniforms(out + buffered, n - buffered);
+    }
+  }
   virtual double NextGaussian(double mean, double stddev) = 0;
 
   double operator()() {
@@ -259,7 +279,16 @@ public:
     return last;
   }
  protected:
+  // generate the next n uniforms of the underlying generator
+  virtual void FillUniforms(double* out, size_t n) = 0;
+  // drop the batched uniforms (after the generator is repositioned)
+  void DiscardUniforms() { uniform_pos_ = kUniformBatch; }
+
   TemplatureManager& t_manager_;
+ private:
+  static const size_t kUniformBatch = 64;
+  double uniforms_[kUniformBatch];
+  size_t uniform_pos_;
 };
 
 class RandomMT : public RandomBase {
@@ -269,13 +298,16 @@ public:
           std::mt19937(seed))),*/
       RandomBase(t_manager), gen_(seed), uniform_(0.0, 1.0) {
   }
-  virtual double NextDouble() {
-    return uniform_(gen_);
-  }
   virtual double NextGaussian(double mean, double stddev) {
     std::normal_distribution<> d(mean, stddev);
     return d(gen_);
   }
+protected:
+  virtual void FillUniforms(double* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = uniform_(gen_);
+    }
+  }
 private:
   //std::function<double(void)> gen;
   //std::random_device rd_;
@@ -287,14 +319,85 @@ class RandomRand : public RandomBase {
 public:
   RandomRand(int seed, TemplatureManager& t_manager)
       : RandomBase(t_manager), gen(rand) { srand(seed); }
-  virtual double NextDouble() {
-    return static_cast<double>(gen()) / static_cast<double>(RAND_MAX);
-  }
   virtual double NextGaussian(double, double) {
     throw std::string("RandomRand does not support NextGaussian()!!!");
   }
+protected:
+  virtual void FillUniforms(double* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = static_cast<double>(gen()) / static_cast<double>(RAND_MAX);
+    }
+  }
 private:
   std::function<double(void)> gen;
 };
 
+/**
+ * Counter-based generator (Philox4x32-10, Salmon et al. 2011). The i-th
+ * uniform of a stream is a pure function of (seed, stream, i), so streams
+ * given to documents, particles or workers are independent of each other and
+ * of the order in which threads consume them. Each counter block gives two
+ * 53-bit uniforms.
+ */
+class RandomPhilox : public RandomBase {
+public:
+  RandomPhilox(uint32_t seed, uint64_t stream, TemplatureManager& t_manager)
+      : RandomBase(t_manager), seed_(seed) {
+    Seek(stream, 0);
+  }
+
+  // the next uniform drawn is the counter-th one of the stream
+  void Seek(uint64_t stream, uint64_t counter) {
+    DiscardUniforms();
+    stream_ = stream;
+    counter_ = counter;
+  }
+  uint32_t seed() const { return seed_; }
+  uint64_t stream() const { return stream_; }
+
+  virtual double NextGaussian(double mean, double stddev) {
+    // Box-Muller; 1 - u is in (0, 1]
+    double r = std::sqrt(-2.0 * std::log(1.0 - NextDouble()));
+    return mean + stddev * r * std::cos(2.0 * M_PI * NextDouble());
+  }
+
+  static void Block(uint32_t seed, uint64_t stream, uint64_t block, uint32_t out[4]) {
+    uint32_t key0 = seed, key1 = 0;
+    out[0] = uint32_t(block);
+    out[1] = uint32_t(block >> 32);
+    out[2] = uint32_t(stream);
+    out[3] = uint32_t(stream >> 32);
+    for (int round = 0; round < 10; ++round) {
+      uint64_t p0 = uint64_t(0xD2511F53) * out[0];
+      uint64_t p1 = uint64_t(0xCD9E8D57) * out[2];
+      uint32_t c0 = uint32_t(p1 >> 32) ^ out[1] ^ key0;
+      uint32_t c2 = uint32_t(p0 >> 32) ^ out[3] ^ key1;
+      out[0] = c0;
+      out[1] = uint32_t(p1);
+      out[2] = c2;
+      out[3] = uint32_t(p0);
+      key0 += 0x9E3779B9;
+      key1 += 0xBB67AE85;
+    }
+  }
+protected:
+  virtual void FillUniforms(double* out, size_t n) {
+    uint32_t r[4];
+    size_t i = 0;
+    while (i < n) {
+      Block(seed_, stream_, counter_ >> 1, r);
+      for (int half = counter_ & 1; half < 2 && i < n; ++half, ++i, ++counter_) {
+        out[i] = ToDouble(r[2 * half], r[2 * half + 1]);
+      }
+    }
+  }
+  static double ToDouble(uint32_t hi, uint32_t lo) {
+    return ((hi >> 5) * 67108864.0 + (lo >> 6)) * (1.0 / 9007199254740992.0);
+  }
+private:
+  uint32_t seed_;
+  uint64_t stream_;
+  uint64_t counter_; // index of the next uniform to generate
+};
+
 #endif /* _RANDOM_H_ */
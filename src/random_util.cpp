@@ -1,23 +1,24 @@
 #include "random_util.hpp"
+#include "sampler_context.hpp"
 
 namespace topiclm {
 
-std::unique_ptr<RandomBase> random;
-std::unique_ptr<TemplatureManager> temp_manager;
+thread_local RandomBase* random = nullptr;
+std::unique_ptr<TemplatureManager> temp_manager(new TemplatureManager());
+
+namespace {
+thread_local std::unique_ptr<SamplerContext> default_context;
+} // namespace
 
 void init_rnd(int seed) {
-  if (temp_manager == nullptr) {
-    temp_manager.reset(new TemplatureManager());
-  }
-  random.reset(new RandomMT(seed, *temp_manager));
+  default_context.reset(new SamplerContext(seed));
+  SamplerContext::BindToThread(default_context.get());
 }
 void init_rnd() {
-  if (temp_manager == nullptr) {
-    temp_manager.reset(new TemplatureManager());
-  }  
-  std::random_device rd;
-  random.reset(new RandomMT(rd(), *temp_manager));
+  default_context.reset();
+  SamplerContext::BindToThread(nullptr);
+  default_context.reset(new SamplerContext());
+  SamplerContext::BindToThread(default_context.get());
 }
   
 } // namespace topiclm
-
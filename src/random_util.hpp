@@ -6,9 +6,11 @@
 
 namespace topiclm {
 
-extern std::unique_ptr<RandomBase> random;
+// generator of the SamplerContext bound to the calling thread (see sampler_context.hpp)
+extern thread_local RandomBase* random;
 extern std::unique_ptr<TemplatureManager> temp_manager;
 
+// bind a default context of the calling thread, used outside of any sampler
 void init_rnd(int seed);
 void init_rnd();
 
@@ -0,0 +1,30 @@
+#ifndef _TOPICLM_REJUVENATION_OPTIONS_HPP_
+#define _TOPICLM_REJUVENATION_OPTIONS_HPP_
+
+#include "cmdline.h"
+#include "particle_filter_sampler.hpp"
+
+namespace topiclm {
+
+/**
+ * Command line options of RejuvenationPolicy, shared by the tools which run
+ * particle filters; the defaults are those of RejuvenationPolicy.
+ */
+inline void AddRejuvenationOptions(cmdline::parser& p) {
+  RejuvenationPolicy defaults;
+  p.add<int>("rejuvenate-window", '\0', "resample only the topics of this number of last words at each step (0: all words)", false, defaults.window);
+  p.add<int>("rejuvenate-budget", '\0', "and of this number of older words at random", false, defaults.budget);
+  p.add<double>("ess-threshold", '\0', "with a window or budget, rejuvenate only when ESS / particles is below this", false, defaults.ess_threshold);
+}
+
+inline RejuvenationPolicy GetRejuvenationPolicy(const cmdline::parser& p) {
+  RejuvenationPolicy rejuvenation;
+  rejuvenation.window = p.get<int>("rejuvenate-window");
+  rejuvenation.budget = p.get<int>("rejuvenate-budget");
+  rejuvenation.ess_threshold = p.get<double>("ess-threshold");
+  return rejuvenation;
+}
+
+} // topiclm
+
+#endif /* _TOPICLM_REJUVENATION_OPTIONS_HPP_ */
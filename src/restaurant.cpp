@@ -1,14 +1,44 @@
 #include "restaurant.hpp"
 #include "random_util.hpp"
+#include "cpu_features.hpp"
 
 using namespace std;
 
 namespace topiclm {
 
-vector<double> HistogramTableRestaurant::table_probs_;// = vector<double>();
-vector<int> Restaurant::tmp_c_;// = vector<int>();
+namespace {
 
-void Restaurant::SetBufferSize(size_t s) { tmp_c_.resize(s); }
+// p[j] *= (concentrations[j] + discounts[j] * t[j]) / (c[j] + concentrations[j])
+// for j in [j, n) with c[j] > 0; returns where the vectorized part stops
+#ifdef TOPICLM_AVX2_DISPATCH
+TOPICLM_TARGET_AVX2
+size_t ScaleFloorsAvx2(size_t j,
+                       size_t n,
+                       const double* c,
+                       const double* t,
+                       const double* discounts,
+                       const double* concentrations,
+                       double* p) {
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d one = _mm256_set1_pd(1.0);
+  for (; j + 4 <= n; j += 4) {
+    __m256d cj = _mm256_loadu_pd(c + j);
+    __m256d concentration = _mm256_loadu_pd(concentrations + j);
+    __m256d ratio = _mm256_div_pd(
+        _mm256_add_pd(concentration, _mm256_mul_pd(_mm256_loadu_pd(discounts + j),
+                                                   _mm256_loadu_pd(t + j))),
+        _mm256_add_pd(cj, concentration));
+    ratio = _mm256_blendv_pd(one, ratio, _mm256_cmp_pd(cj, zero, _CMP_GT_OQ));
+    _mm256_storeu_pd(p + j, _mm256_mul_pd(_mm256_loadu_pd(p + j), ratio));
+  }
+  return j;
+}
+#endif
+
+} // namespace
+
+thread_local vector<double> HistogramTableRestaurant::table_probs_;// = vector<double>();
+size_t Restaurant::dense_floor_threshold_ = 64;
 
 pair<AddRemoveResult, topic_t> Restaurant::AddCustomer(
       topic_t floor_id,
@@ -34,6 +64,7 @@ pair<AddRemoveResult, topic_t> Restaurant::AddCustomer(
   if (add_result.first != TableUnchanged) {
     ++target_stat.second;
   }
+  SyncDenseFloor(floor_id);
   return add_result;
 }
 AddRemoveResult Restaurant::AddCustomerNewTable(topic_t floor_id, int type, double lambda) {
@@ -43,6 +74,7 @@ AddRemoveResult Restaurant::AddCustomerNewTable(topic_t floor_id, int type, doub
   auto add_result = target_internal.AddCustomerNewTable(floor_id, lambda);
   assert(add_result != TableUnchanged);
   ++target_stat.second;
+  SyncDenseFloor(floor_id);
 
   return add_result;
 }
@@ -60,6 +92,7 @@ pair<AddRemoveResult, topic_t> Restaurant::RemoveCustomer(topic_t floor_id, int
       EraseAndShrink(target_c_t, floor_id);
     }
   }
+  SyncDenseFloor(floor_id);
   return remove_result;
 }
 void Restaurant::ChangeTableLabelAtRandom(topic_t floor_id, int type, topic_t old_label, topic_t new_label) {
@@ -73,17 +106,17 @@ void Restaurant::ChangeTableLabel(topic_t floor_id, int type, int customers, top
 
 void Restaurant::CombineSectionToWord(topic_t floor_id,
                                       int type,
-                                      const std::shared_ptr<Word>& word_ptr,
+                                      word_id_t word,
                                       bool cache) {
   auto& target_internal = type2internal_[type];
-  target_internal.CombineSectionToWord(floor_id, word_ptr, cache);
+  target_internal.CombineSectionToWord(floor_id, word, cache);
 }
 void Restaurant::SeparateWordFromSection(topic_t floor_id,
                                          int type,
-                                         const std::shared_ptr<Word>& word_ptr,
+                                         word_id_t word,
                                          bool cache) {
   auto& target_internal = type2internal_[type];
-  target_internal.SeparateWordFromSection(floor_id, word_ptr, cache);
+  target_internal.SeparateWordFromSection(floor_id, word, cache);
 }
 void Restaurant::AddCustomerToCache(topic_t /*cache_id*/, int /*type*/, topic_t /*topic*/, double /*discount*/) {
   // auto& target_internal = type2internal_[type];
@@ -115,11 +148,53 @@ void Restaurant::ChangeTablesFloor(topic_t floor_id, int type, topic_t label, co
   auto& new_stat = floor2c_t_[new_floor_id];
   new_stat.first += move_customers;
   new_stat.second += table_customers.size();
+  SyncDenseFloor(floor_id);
+  SyncDenseFloor(new_floor_id);
   
   auto& target_internal = type2internal_[type];
   target_internal.ChangeTablesFloor(floor_id, new_floor_id, label, table_customers);
 }
 
+void Restaurant::SyncDenseFloor(topic_t floor_id) {
+  if (!dense_floors_) {
+    if (floor2c_t_.size() <= dense_floor_threshold_) return;
+    dense_floors_.reset(new DenseFloors());
+    for (auto& floor : floor2c_t_) {
+      dense_floors_->Set(floor.first, floor.second.first, floor.second.second);
+    }
+    return;
+  }
+  auto it = floor2c_t_.find(floor_id);
+  if (it != floor2c_t_.end()) {
+    dense_floors_->Set(floor_id, (*it).second.first, (*it).second.second);
+  } else {
+    dense_floors_->Set(floor_id, 0, 0);
+  }
+}
+
+void Restaurant::ScaleDenseFloors(size_t first_floor,
+                                  int depth,
+                                  const HPYParameter& hpy_parameter,
+                                  vector<double>& predictives) const {
+  // predictives[j] *= (concentration + discount * t) / (c + concentration)
+  // for the floors with customers; empty floors are left as their base
+  const double* c = dense_floors_->customers.data();
+  const double* t = dense_floors_->tables.data();
+  const double* discounts = hpy_parameter.depth_discounts(depth);
+  const double* concentrations = hpy_parameter.depth_concentrations(depth);
+  double* p = predictives.data();
+  size_t n = min(dense_floors_->customers.size(), predictives.size());
+  size_t j = first_floor;
+#ifdef TOPICLM_AVX2_DISPATCH
+  if (HasAvx2()) j = ScaleFloorsAvx2(j, n, c, t, discounts, concentrations, p);
+#endif
+  for (; j < n; ++j) {
+    if (c[j] > 0) {
+      p[j] *= (concentrations[j] + discounts[j] * t[j]) / (c[j] + concentrations[j]);
+    }
+  }
+}
+
 void Restaurant::CheckConsistency() const {
   map<topic_t, pair<int, int> > floor2c_t;
   for (auto& internal : type2internal_) {
@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <map>
+#include <memory>
 #include <vector>
 #include <unordered_map>
 #include <string>
@@ -14,6 +15,7 @@
 #include "config.hpp"
 #include "histogram_table_restaurant.hpp"
 #include "internal_restaurant.hpp"
+#include "type_map.hpp"
 #include "lambda_manager.hpp"
 #include "parameters.hpp"
 
@@ -28,11 +30,55 @@ double ComputePYPPredictive(int cw,
                             double discount,
                             double concentration);
 
+/**
+ * Totals of the floors of a restaurant with many floors (the root and other
+ * hot nodes) as dense arrays over floor ids, so that FillInPredictives
+ * scales all the floors in one straight pass instead of a walk over the
+ * floor map. Kept in step with floor2c_t_.
+ */
+struct DenseFloors {
+  void Set(topic_t floor_id, int c, int t) {
+    if (customers.size() <= static_cast<size_t>(floor_id)) {
+      customers.resize(floor_id + 1, 0.0);
+      tables.resize(floor_id + 1, 0.0);
+    }
+    customers[floor_id] = c;
+    tables[floor_id] = t;
+  }
+  std::vector<double> customers;
+  std::vector<double> tables;
+};
+
 //class Restaurant : public PoolObject<Restaurant> {
 class Restaurant {
  public:
-  static void SetBufferSize(size_t s);
   Restaurant() : num_stop_customers_(0), num_pass_customers_(0) {}
+  Restaurant(const Restaurant& other)
+      : type2internal_(other.type2internal_),
+        floor2c_t_(other.floor2c_t_),
+        dense_floors_(other.dense_floors_ ? new DenseFloors(*other.dense_floors_) : nullptr),
+        table_restaurant_(other.table_restaurant_),
+        num_stop_customers_(other.num_stop_customers_),
+        num_pass_customers_(other.num_pass_customers_) {}
+  Restaurant(Restaurant&&) = default;
+  Restaurant& operator=(Restaurant other) {
+    std::swap(type2internal_, other.type2internal_);
+    std::swap(floor2c_t_, other.floor2c_t_);
+    std::swap(dense_floors_, other.dense_floors_);
+    std::swap(table_restaurant_, other.table_restaurant_);
+    std::swap(num_stop_customers_, other.num_stop_customers_);
+    std::swap(num_pass_customers_, other.num_pass_customers_);
+    return *this;
+  }
+  static void set_section_hash_threshold(size_t threshold) {
+    TypeMap<InternalRestaurant<topic_t> >::set_hash_threshold(threshold);
+  }
+  /**
+   * A restaurant keeps DenseFloors once it has more floors than this.
+   */
+  static void set_dense_floor_threshold(size_t threshold) {
+    dense_floor_threshold_ = threshold;
+  }
   std::pair<AddRemoveResult, topic_t> AddCustomer(
       topic_t floor_id,
       int type,
@@ -49,11 +95,11 @@ class Restaurant {
   void ChangeTableLabel(topic_t floor_id, int type, int customers, topic_t old_label, topic_t new_label);
   void CombineSectionToWord(topic_t floor_id,
                             int type,
-                            const std::shared_ptr<Word>& word_ptr,
+                            word_id_t word,
                             bool cache = false);
   void SeparateWordFromSection(topic_t floor_id,
                                int type,
-                               const std::shared_ptr<Word>& word_ptr,
+                               word_id_t word,
                                bool cache = false);
   void AddCustomerToCache(topic_t cache_id, int type, topic_t topic, double discount);
   
@@ -105,18 +151,21 @@ class Restaurant {
                                                        int type,
                                                        double discount,
                                                        double concentration) const;
+  // floor_customers is a buffer of (# topics + 1) elements
   inline void FillInPredictives(const std::vector<double>& parent_predictives,
                                 int type,
                                 const LambdaManagerInterface& lmanager,
                                 int depth,
                                 const HPYParameter& hpy_parameter,
-                                std::vector<double>& predictives) const;
+                                std::vector<double>& predictives,
+                                std::vector<int>& floor_customers) const;
   inline void FillInPredictivesNonGraphical(
       const std::vector<double>& parent_paredictives,
       int type,
       int depth,
       const HPYParameter& hpy_parameter,
-      std::vector<double>& predictives) const;
+      std::vector<double>& predictives,
+      std::vector<int>& floor_customers) const;
 
 
   
@@ -181,9 +230,17 @@ class Restaurant {
   std::map<int, std::vector<topic_t> > type2topics() const;
 
   const boost::container::flat_map<topic_t, std::pair<int, int> >& floor2c_t() { return floor2c_t_; }
+  const boost::container::flat_map<topic_t, std::pair<int, int> >& floor2c_t() const { return floor2c_t_; }
+  /**
+   * Floors in which type has customers (sparse); nullptr if none.
+   */
+  const InternalRestaurant<topic_t>* find_internal(int type) const {
+    auto it = type2internal_.find(type);
+    return it != type2internal_.end() ? &(*it).second : nullptr;
+  }
   const boost::container::flat_map<topic_t, std::pair<int, int> >& cache2c_t() { return floor2c_t(); }
   InternalRestaurant<topic_t>& internal(int type) { return type2internal_[type]; }
-  boost::container::flat_map<int, InternalRestaurant<topic_t> >& type2internal() {
+  TypeMap<InternalRestaurant<topic_t> >& type2internal() {
     return type2internal_;
   }
 
@@ -206,13 +263,18 @@ class Restaurant {
   }
   
  private:
-  boost::container::flat_map<int, InternalRestaurant<topic_t> > type2internal_;
+  void SyncDenseFloor(topic_t floor_id);
+  void ScaleDenseFloors(size_t first_floor,
+                        int depth,
+                        const HPYParameter& hpy_parameter,
+                        std::vector<double>& predictives) const;
+
+  TypeMap<InternalRestaurant<topic_t> > type2internal_;
   boost::container::flat_map<topic_t, std::pair<int, int> > floor2c_t_;
+  std::unique_ptr<DenseFloors> dense_floors_;
+  static size_t dense_floor_threshold_;
   //boost::container::flat_map<topic_t, std::pair<int, int> > cache2c_t_;
 
-  // buffer
-  static std::vector<int> tmp_c_;
-  
   HistogramTableRestaurant table_restaurant_;
 
   int num_stop_customers_;
@@ -226,6 +288,10 @@ class Restaurant {
         & MEMBER(table_restaurant_)
         & MEMBER(num_stop_customers_)
         & MEMBER(num_pass_customers_);
+    if (ar.is_read) {
+      dense_floors_.reset();
+      if (!floor2c_t_.empty()) SyncDenseFloor(floor2c_t_.begin()->first);
+    }
   }
 };
 
@@ -281,7 +347,8 @@ void Restaurant::FillInPredictives(const std::vector<double>& parent_predictives
                                    const LambdaManagerInterface& lmanager,
                                    int depth,
                                    const HPYParameter& hpy_parameter,
-                                   std::vector<double>& predictives) const {
+                                   std::vector<double>& predictives,
+                                   std::vector<int>& floor_customers) const {
   auto floor_it = floor2c_t_.begin();
   auto type_it = type2internal_.find(type);
   predictives[0] = parent_predictives[0];
@@ -311,19 +378,24 @@ void Restaurant::FillInPredictives(const std::vector<double>& parent_predictives
     double lambda = lmanager.lambda(i, depth);
     predictives[i] = lambda * parent_predictives[i] + (1 - lambda) * predictives[0];
   }
-  if ((*floor_it).first == 0) {
-    ++floor_it;
-  }
-  for (; floor_it != floor2c_t_.end(); ++floor_it) {
-    auto floor_id = (*floor_it).first;
-    auto& c_t = (*floor_it).second;
-    tmp_c_[floor_id] = c_t.first;
-    predictives[floor_id] *=
-        (hpy_parameter.concentration(depth, floor_id)
-         + hpy_parameter.discount(depth, floor_id) * c_t.second)
-        / (c_t.first + hpy_parameter.concentration(depth, floor_id));
+  if (dense_floors_) {
+    ScaleDenseFloors(1, depth, hpy_parameter, predictives);
+  } else {
+    if ((*floor_it).first == 0) {
+      ++floor_it;
+    }
+    for (; floor_it != floor2c_t_.end(); ++floor_it) {
+      auto floor_id = (*floor_it).first;
+      auto& c_t = (*floor_it).second;
+      floor_customers[floor_id] = c_t.first;
+      predictives[floor_id] *=
+          (hpy_parameter.concentration(depth, floor_id)
+           + hpy_parameter.discount(depth, floor_id) * c_t.second)
+          / (c_t.first + hpy_parameter.concentration(depth, floor_id));
+    }
   }
   if (type_it == type2internal_.end()) return;
+  const double* dense_customers = dense_floors_ ? dense_floors_->customers.data() : nullptr;
   auto& sections = (*type_it).second.sections_;
 
   auto section_it = sections.begin();
@@ -335,9 +407,10 @@ void Restaurant::FillInPredictives(const std::vector<double>& parent_predictives
     auto& section = (*section_it).second;
     int cw = section.customers;
     int tw = section.tables;
+    double c = dense_customers ? dense_customers[floor_id] : floor_customers[floor_id];
     predictives[floor_id] +=
         (cw - hpy_parameter.discount(depth, floor_id) * tw)
-        / (tmp_c_[floor_id] + hpy_parameter.concentration(depth, floor_id));
+        / (c + hpy_parameter.concentration(depth, floor_id));
   }
 }
 inline void Restaurant::FillInPredictivesNonGraphical(
@@ -345,21 +418,27 @@ inline void Restaurant::FillInPredictivesNonGraphical(
     int type,
     int depth,
     const HPYParameter& hpy_parameter,
-    std::vector<double>& predictives) const {
+    std::vector<double>& predictives,
+    std::vector<int>& floor_customers) const {
   for (size_t i = 0; i < parent_predictives.size(); ++i) {
     predictives[i] = parent_predictives[i];
   }
-  for (auto floor_it = floor2c_t_.begin(); floor_it != floor2c_t_.end(); ++floor_it) {
-    auto floor_id = (*floor_it).first;
-    auto& c_t = (*floor_it).second;
-    tmp_c_[floor_id] = c_t.first;
-    predictives[floor_id] *=
-        (hpy_parameter.concentration(depth, floor_id)
-         + hpy_parameter.discount(depth, floor_id) * c_t.second)
-        / (c_t.first + hpy_parameter.concentration(depth, floor_id));
+  if (dense_floors_) {
+    ScaleDenseFloors(0, depth, hpy_parameter, predictives);
+  } else {
+    for (auto floor_it = floor2c_t_.begin(); floor_it != floor2c_t_.end(); ++floor_it) {
+      auto floor_id = (*floor_it).first;
+      auto& c_t = (*floor_it).second;
+      floor_customers[floor_id] = c_t.first;
+      predictives[floor_id] *=
+          (hpy_parameter.concentration(depth, floor_id)
+           + hpy_parameter.discount(depth, floor_id) * c_t.second)
+          / (c_t.first + hpy_parameter.concentration(depth, floor_id));
+    }
   }
   auto type_it = type2internal_.find(type);
   if (type_it == type2internal_.end()) return;
+  const double* dense_customers = dense_floors_ ? dense_floors_->customers.data() : nullptr;
 
   auto& sections = (*type_it).second.sections_;
   auto section_it = sections.begin();
@@ -368,9 +447,10 @@ inline void Restaurant::FillInPredictivesNonGraphical(
     auto& section = (*section_it).second;
     auto cw = section.customers;
     auto tw = section.tables;
+    double c = dense_customers ? dense_customers[floor_id] : floor_customers[floor_id];
     predictives[floor_id] +=
         (cw - hpy_parameter.discount(depth, floor_id) * tw)
-        / (tmp_c_[floor_id] + hpy_parameter.concentration(depth, floor_id));
+        / (c + hpy_parameter.concentration(depth, floor_id));
   }
 }
 
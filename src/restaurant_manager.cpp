@@ -2,6 +2,7 @@
 #include "lambda_manager.hpp"
 #include "node.hpp"
 #include "parameters.hpp"
+#include "sampler_context.hpp"
 
 using namespace std;
 
@@ -10,21 +11,28 @@ namespace topiclm {
 RestaurantManager::RestaurantManager(const std::vector<Node*>& node_path,
                                      LambdaManagerInterface& lmanager,
                                      const Parameters& parameters,
-                                     double zero_order_pred)
+                                     double zero_order_pred,
+                                     SamplerContext& context)
     : node_path_(node_path),
       lmanager_(lmanager),
       hpy_parameter_(parameters.hpy_parameter()),
+      context_(context),
       depth2topic_predictives_(parameters.ngram_order(),
                                vector<double>(parameters.topic_parameter().num_topics + 1, 0)),
       cache_path_(parameters.ngram_order()),
-      zero_order_predictives_(parameters.topic_parameter().num_topics + 1, zero_order_pred) {
-  Restaurant::SetBufferSize(parameters.topic_parameter().num_topics + 1);
+      zero_order_predictives_(parameters.topic_parameter().num_topics + 1, zero_order_pred),
+      root_mutex_(nullptr) {
+  auto& floor_customers = context_.floor_customers();
+  if (floor_customers.size() < zero_order_predictives_.size()) {
+    floor_customers.resize(zero_order_predictives_.size());
+  }
 }
 RestaurantManager::~RestaurantManager() {}
 
 void RestaurantManager::AddCustomerToPath(int type, topic_t topic, int word_depth) {
   auto floor_id = topic;
   for (int i = word_depth; i >= 0; --i) {
+    auto root_lock = LockRootIf(i == 0);
     auto& restaurant = node_path_[i]->restaurant();
     auto parent_global_predictive = depth2topic_predictives_[i][0];
     auto parent_local_predictive =
@@ -44,6 +52,7 @@ void RestaurantManager::AddCustomerToPath(int type, topic_t topic, int word_dept
     if (add_result.first == AddRemoveResult::TableUnchanged) {
       break;
     }
+    if (root_lock.owns_lock()) root_lock.unlock(); // lmanager_ locks the root itself
     if (add_result.first == AddRemoveResult::GlobalTableChanged) {
       assert(add_result.second == 0);
       lmanager_.AddNewTable(node_path_, floor_id, i, true);
@@ -87,12 +96,14 @@ void RestaurantManager::AddCustomerToPathAtRandom(int type, topic_t topic, int w
 void RestaurantManager::RemoveCustomerFromPath(int type, topic_t topic, int word_depth) {
   auto floor_id = topic;
   for (int i = word_depth; i >= 0; --i) {
+    auto root_lock = LockRootIf(i == 0);
     auto& restaurant = node_path_[i]->restaurant();
     auto remove_result = restaurant.RemoveCustomer(floor_id, type);
 
     if (remove_result.first == AddRemoveResult::TableUnchanged) {
       break;
     }
+    if (root_lock.owns_lock()) root_lock.unlock(); // lmanager_ locks the root itself
     if (remove_result.first == AddRemoveResult::GlobalTableChanged) {
       lmanager_.RemoveTable(node_path_, floor_id, i, true);
       floor_id = kGlobalFloorId;
@@ -106,14 +117,18 @@ void RestaurantManager::RemoveCustomerFromPath(int type, topic_t topic, int word
 }
 
 void RestaurantManager::AddStopPassedCustomers(int word_depth) const {
+  auto root_lock = LockRoot();
   for (int i = 0; i < word_depth; ++i) {
     ++node_path_[i]->restaurant().pass_customers();
+    if (i == 0 && root_lock.owns_lock()) root_lock.unlock();
   }
   ++node_path_[word_depth]->restaurant().stop_customers();
 }
 void RestaurantManager::RemoveStopPassedCustomers(int word_depth) const {
+  auto root_lock = LockRoot();
   for (int i = 0; i < word_depth; ++i) {
     --node_path_[i]->restaurant().pass_customers();
+    if (i == 0 && root_lock.owns_lock()) root_lock.unlock();
   }
   --node_path_[word_depth]->restaurant().stop_customers();
 }
@@ -121,18 +136,18 @@ void RestaurantManager::RemoveStopPassedCustomers(int word_depth) const {
 void RestaurantManager::CombineSectionToWord(int type,
                                              topic_t floor_id,
                                              int word_depth,
-                                             const std::shared_ptr<Word>& word_ptr,
+                                             word_id_t word,
                                              bool cache) {
-  assert(node_path_[word_depth] == word_ptr->node);
-  node_path_[word_depth]->restaurant().CombineSectionToWord(floor_id, type, word_ptr, cache);
+  auto root_lock = LockRootIf(word_depth == 0);
+  node_path_[word_depth]->restaurant().CombineSectionToWord(floor_id, type, word, cache);
 }
 void RestaurantManager::SeparateWordFromSection(int type,
                                                 topic_t floor_id,
                                                 int word_depth,
-                                                const std::shared_ptr<Word>& word_ptr,
+                                                word_id_t word,
                                                 bool cache) {
-  assert(node_path_[word_depth] == word_ptr->node);  
-  node_path_[word_depth]->restaurant().SeparateWordFromSection(floor_id, type, word_ptr, cache);
+  auto root_lock = LockRootIf(word_depth == 0);
+  node_path_[word_depth]->restaurant().SeparateWordFromSection(floor_id, type, word, cache);
 }
 
 void RestaurantManager::CalcGlobalPredictivePath(int type, int word_depth) {
@@ -166,6 +181,7 @@ void RestaurantManager::CalcLocalPredictivePath(int type, topic_t topic, int wor
 
 void RestaurantManager::CalcDepth2TopicPredictives(int type, int word_depth, bool test) {
   lmanager_.CalcLambdaPath(node_path_, word_depth);
+  auto root_lock = LockRoot();
   auto parent_predictives = &zero_order_predictives_;
   for (int i = 0; i <= word_depth; ++i) {
     auto& restaurant = node_path_[i]->restaurant();
@@ -174,8 +190,10 @@ void RestaurantManager::CalcDepth2TopicPredictives(int type, int word_depth, boo
                                  lmanager_,
                                  i,
                                  hpy_parameter_,
-                                 depth2topic_predictives_[i]);
+                                 depth2topic_predictives_[i],
+                                 context_.floor_customers());
     parent_predictives = &depth2topic_predictives_[i];
+    if (i == 0 && root_lock.owns_lock()) root_lock.unlock();
   }
   if (test) {
     for (size_t i = word_depth + 1; i < depth2topic_predictives_.size(); ++i) {
@@ -203,6 +221,62 @@ void RestaurantManager::CalcMixtureParentPredictive(int word_depth) {
         + (1 - lambda) * depth2topic_predictives_[word_depth][0];
   }
 }
+void RestaurantManager::CalcLambdaAndGlobalPredictivePath(int type, int word_depth) {
+  lmanager_.CalcLambdaPath(node_path_, word_depth);
+  auto root_lock = LockRoot();
+  CalcGlobalPredictivePath(type, word_depth);
+  for (size_t i = word_depth + 1; i < depth2topic_predictives_.size(); ++i) {
+    depth2topic_predictives_[i][0] = depth2topic_predictives_[i - 1][0];
+  }
+}
+void RestaurantManager::CalcTopicPredictivePath(int type, topic_t topic, int word_depth) {
+  if (topic == kGlobalFloorId) return;
+  {
+    auto root_lock = LockRoot();
+    CalcLocalPredictivePath(type, topic, word_depth);
+  }
+  for (size_t i = word_depth + 1; i < depth2topic_predictives_.size(); ++i) {
+    auto lambda = lmanager_.lambda(topic, i);
+    depth2topic_predictives_[i][topic]
+        = lambda * depth2topic_predictives_[i - 1][topic]
+        + (1 - lambda) * depth2topic_predictives_[i][0];
+  }
+}
+void RestaurantManager::CollectPathTopics(int type,
+                                          int word_depth,
+                                          std::vector<topic_t>& topics,
+                                          std::vector<char>& marks) const {
+  topics.clear();
+  auto mark = [&topics, &marks](topic_t topic) {
+    if (topic != kGlobalFloorId && !marks[topic]) {
+      marks[topic] = 1;
+      topics.push_back(topic);
+    }
+  };
+  auto internal = node_path_[0]->restaurant().find_internal(type);
+  if (internal != nullptr) {
+    for (auto& section : internal->sections()) mark(section.first);
+  }
+  for (int i = 1; i <= word_depth; ++i) {
+    for (auto& floor : node_path_[i]->restaurant().floor2c_t()) mark(floor.first);
+  }
+}
+double RestaurantManager::RootSmoothingRatio(topic_t topic) const {
+  auto& restaurant = node_path_[0]->restaurant();
+  int c = restaurant.floor_sum_customers(topic);
+  if (c == 0) return 1;
+  double concentration = hpy_parameter_.concentration(0, topic);
+  return (concentration + hpy_parameter_.discount(0, topic) * restaurant.floor_sum_tables(topic))
+      / (concentration + c);
+}
+void RestaurantManager::SetPredictivePath(int word_depth,
+                                          topic_t topic,
+                                          const double* predictive_path) {
+  for (int i = 0; i <= word_depth; ++i) {
+    depth2topic_predictives_[i][0] = predictive_path[2 * i];
+    depth2topic_predictives_[i][topic] = predictive_path[2 * i + 1];
+  }
+}
 void RestaurantManager::CalcCachePath(int type, int word_depth, topic_t cache_id) {
   for (int i = 0; i <= word_depth; ++i) {
     cache_path_[i] = node_path_[i]->restaurant().cache_probability(cache_id, type, hpy_parameter_.cache_discount(i), hpy_parameter_.cache_concentration(i));
@@ -216,13 +290,15 @@ NonGraphicalRestaurantManager::NonGraphicalRestaurantManager(
     const std::vector<Node*>& node_path,
     LambdaManagerInterface& lmanager,
     const Parameters& parameters,
-    double zero_order_pred)
-    : RestaurantManager(node_path, lmanager, parameters, zero_order_pred) {}
+    double zero_order_pred,
+    SamplerContext& context)
+    : RestaurantManager(node_path, lmanager, parameters, zero_order_pred, context) {}
 NonGraphicalRestaurantManager::~NonGraphicalRestaurantManager() {}
 
 void NonGraphicalRestaurantManager::AddCustomerToPath(int type, topic_t topic, int word_depth) {
   auto floor_id = topic;
   for (int i = word_depth; i >= 0; --i) {
+    auto root_lock = LockRootIf(i == 0);
     auto& restaurant = node_path_[i]->restaurant();
     double parent_local_predictive =
         i == 0 ? zero_order_predictives_[topic] : depth2topic_predictives_[i - 1][topic];
@@ -265,6 +341,7 @@ void NonGraphicalRestaurantManager::RemoveCustomerFromPath(int type,
                                                            int word_depth) {
   int floor_id = topic;
   for (int i = word_depth; i >= 0; --i) {
+    auto root_lock = LockRootIf(i == 0);
     auto& restaurant = node_path_[i]->restaurant();
     if (restaurant.RemoveCustomer(floor_id, type).first
         == AddRemoveResult::TableUnchanged) {
@@ -294,6 +371,7 @@ void NonGraphicalRestaurantManager::CalcLocalPredictivePath(int type, topic_t to
 }
 void NonGraphicalRestaurantManager::CalcDepth2TopicPredictives(int type, int word_depth, bool test) {
   lmanager_.CalcLambdaPath(node_path_, word_depth);
+  auto root_lock = LockRoot();
   auto parent_predictives = &zero_order_predictives_;
   for (int i = 0; i <= word_depth; ++i) {
     auto& restaurant = node_path_[i]->restaurant();
@@ -301,8 +379,10 @@ void NonGraphicalRestaurantManager::CalcDepth2TopicPredictives(int type, int wor
                                              type,
                                              i,
                                              hpy_parameter_,
-                                             depth2topic_predictives_[i]);
+                                             depth2topic_predictives_[i],
+                                             context_.floor_customers());
     parent_predictives = &depth2topic_predictives_[i];
+    if (i == 0 && root_lock.owns_lock()) root_lock.unlock();
   }
   if (test) {
     for (size_t i = word_depth + 1; i < depth2topic_predictives_.size(); ++i) {
@@ -315,5 +395,15 @@ void NonGraphicalRestaurantManager::CalcDepth2TopicPredictives(int type, int wor
     }
   }
 }
+void NonGraphicalRestaurantManager::CalcTopicPredictivePath(int type, topic_t topic, int word_depth) {
+  if (topic == kGlobalFloorId) return;
+  {
+    auto root_lock = LockRoot();
+    CalcLocalPredictivePath(type, topic, word_depth);
+  }
+  for (size_t i = word_depth + 1; i < depth2topic_predictives_.size(); ++i) {
+    depth2topic_predictives_[i][topic] = depth2topic_predictives_[i - 1][topic];
+  }
+}
 
 } // topiclm
@@ -2,6 +2,7 @@
 #define _TOPICLM_RESTAURANT_MANAGER_HPP_
 
 #include <vector>
+#include <mutex>
 #include "word.hpp"
 #include "add_remove_result.hpp"
 #include "config.hpp"
@@ -12,13 +13,15 @@ class Node;
 class LambdaManagerInterface;
 class Parameters;
 class HPYParameter;
+class SamplerContext;
 
 class RestaurantManager {
  public:
   RestaurantManager(const std::vector<Node*>& node_path,
                     LambdaManagerInterface& lmanager,
                     const Parameters& parameters,
-                    double zero_order_pred);
+                    double zero_order_pred,
+                    SamplerContext& context);
   virtual ~RestaurantManager();
   virtual void AddCustomerToPath(int type, topic_t topic, int word_depth);
   virtual void AddObservedCustomerToPath(int type, topic_t topic, int word_depth) {
@@ -38,18 +41,51 @@ class RestaurantManager {
   void CombineSectionToWord(int type,
                             topic_t floor_id,
                             int word_depth,
-                            const std::shared_ptr<Word>& word_ptr,
+                            word_id_t word,
                             bool cache = false);
   void SeparateWordFromSection(int type,
                                topic_t floor_id,
                                int word_depth,
-                               const std::shared_ptr<Word>& word_ptr,
+                               word_id_t word,
                                bool cache = false);
 
   void CalcGlobalPredictivePath(int type, int word_depth);
   virtual void CalcLocalPredictivePath(int type, topic_t topic, int word_depth);
   virtual void CalcDepth2TopicPredictives(int type, int word_depth, bool test = false);
+  /**
+   * Lambda path and global predictives of all depths (for training), which
+   * CalcTopicPredictivePath depends on.
+   */
+  void CalcLambdaAndGlobalPredictivePath(int type, int word_depth);
+  /**
+   * Predictives of one topic of all depths as CalcDepth2TopicPredictives
+   * gives them (for training), in O(order) instead of O(K order).
+   */
+  virtual void CalcTopicPredictivePath(int type, topic_t topic, int word_depth);
+  /**
+   * Topics but the global one whose predictives on the path depend on more
+   * than their floor of the root: those with customers in a node of depth
+   * 1...word_depth, and those in which type has customers at the root.
+   * Only the floors with customers are visited. marks ((# topics + 1)
+   * elements, all 0) is set to 1 for them.
+   */
+  void CollectPathTopics(int type,
+                         int word_depth,
+                         std::vector<topic_t>& topics,
+                         std::vector<char>& marks) const;
+  /**
+   * (concentration + discount * t) / (concentration + c) of a floor of the
+   * root, by which the predictive of a type without customers scales its
+   * base; 1 if the floor is empty.
+   */
+  double RootSmoothingRatio(topic_t topic) const;
   void CalcMixtureParentPredictive(int word_depth);
+  /**
+   * Restore the global and topic predictives for depth 0...word_depth, which
+   * are all what AddCustomerToPath reads. predictive_path is laid out as
+   * (global, topic) pairs from the root.
+   */
+  void SetPredictivePath(int word_depth, topic_t topic, const double* predictive_path);
   void CalcCachePath(int type, int word_depth, topic_t cache_id);
 
   double predictive(int depth, topic_t topic) const {
@@ -66,15 +102,33 @@ class RestaurantManager {
   const std::vector<std::pair<double, double> >& cache_path() const {
     return cache_path_;
   }
+  /**
+   * When the tree is shared by several samplers, each owning whole subtrees
+   * below the root, the root restaurant is read and updated under root_mutex;
+   * the restaurants below the root are not locked. The lambda manager must
+   * be given the same mutex, and the structure of the tree must be guarded
+   * by the caller.
+   */
+  void set_root_mutex(std::mutex* root_mutex) { root_mutex_ = root_mutex; }
   
  protected:
+  std::unique_lock<std::mutex> LockRoot() const {
+    return root_mutex_ == nullptr ?
+        std::unique_lock<std::mutex>() : std::unique_lock<std::mutex>(*root_mutex_);
+  }
+  std::unique_lock<std::mutex> LockRootIf(bool lock) const {
+    return lock ? LockRoot() : std::unique_lock<std::mutex>();
+  }
+
   const std::vector<Node*>& node_path_;
   LambdaManagerInterface& lmanager_;
   const HPYParameter& hpy_parameter_;
+  SamplerContext& context_;
 
   std::vector<std::vector<double> > depth2topic_predictives_;
   std::vector<std::pair<double, double> > cache_path_;
   const std::vector<double> zero_order_predictives_;
+  std::mutex* root_mutex_;
 };
 
 class NonGraphicalRestaurantManager : public RestaurantManager {
@@ -82,7 +136,8 @@ class NonGraphicalRestaurantManager : public RestaurantManager {
   NonGraphicalRestaurantManager(const std::vector<Node*>& node_path,
                                 LambdaManagerInterface& lmanager,
                                 const Parameters& parameters,
-                                double zero_order_pred);
+                                double zero_order_pred,
+                                SamplerContext& context);
   virtual ~NonGraphicalRestaurantManager();
   
   virtual void AddCustomerToPath(int type, topic_t topic, int word_depth);
@@ -93,7 +148,7 @@ class NonGraphicalRestaurantManager : public RestaurantManager {
   
   virtual void CalcLocalPredictivePath(int type, topic_t topic, int word_depth);
   virtual void CalcDepth2TopicPredictives(int type, int word_depth, bool test = false);
-
+  virtual void CalcTopicPredictivePath(int type, topic_t topic, int word_depth);
 };
 
 } // topiclm
@@ -0,0 +1,43 @@
+#include <climits>
+#include "sampler_context.hpp"
+#include "random_util.hpp"
+
+namespace topiclm {
+
+namespace {
+thread_local SamplerContext* current_context = nullptr;
+} // namespace
+
+SamplerContext::SamplerContext(int seed, uint64_t stream) {
+  if (seed < 0) {
+    if (current_context != nullptr) {
+      seed = current_context->random().NextMult(INT_MAX);
+    } else {
+      std::random_device rd;
+      seed = rd() % INT_MAX;
+    }
+  }
+  random_.reset(new RandomPhilox(seed, stream, *temp_manager));
+}
+SamplerContext::~SamplerContext() {}
+
+SamplerContext& SamplerContext::current() {
+  if (current_context == nullptr) {
+    throw "no sampler context is bound to this thread (call init_rnd)";
+  }
+  return *current_context;
+}
+void SamplerContext::BindToThread(SamplerContext* context) {
+  current_context = context;
+  topiclm::random = context == nullptr ? nullptr : &context->random();
+}
+
+SamplerContext::Scope::Scope(SamplerContext& context)
+    : previous_(current_context) {
+  BindToThread(&context);
+}
+SamplerContext::Scope::~Scope() {
+  BindToThread(previous_);
+}
+
+} // namespace topiclm
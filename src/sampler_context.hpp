@@ -0,0 +1,68 @@
+#ifndef _TOPICLM_SAMPLER_CONTEXT_HPP_
+#define _TOPICLM_SAMPLER_CONTEXT_HPP_
+
+#include <vector>
+#include <memory>
+#include "random.hpp"
+
+namespace topiclm {
+
+/**
+ * Random number generator and scratch memory of one sampler (a training
+ * sampler, a prediction session or a sampling worker). Samplers never share
+ * a context, so independent models can run on different threads.
+ *
+ * RestaurantManager, TopicDepthSampler and FloorSampler are given their
+ * context explicitly. Code below them (restaurants, document counts and
+ * hyperparameter samplers) uses the context bound to the running thread,
+ * through `random` (random_util.hpp) or current(); a sampler binds its
+ * context with Scope on entry.
+ */
+class SamplerContext {
+ public:
+  /**
+   * Draws come from stream `stream` of a counter-based generator keyed by
+   * seed (see RandomPhilox). seed < 0 draws a seed from the context bound to
+   * this thread (or the device).
+   */
+  explicit SamplerContext(int seed = -1, uint64_t stream = 0);
+  ~SamplerContext();
+  SamplerContext(const SamplerContext&) = delete;
+  SamplerContext& operator=(const SamplerContext&) = delete;
+
+  RandomBase& random() { return *random_; }
+  int seed() const { return random_->seed(); }
+  // restart the generator from the head of another stream of the same seed
+  void set_stream(uint64_t stream) { random_->Seek(stream, 0); }
+
+  // c of each floor, used while computing predictives (see Restaurant::FillInPredictives)
+  std::vector<int>& floor_customers() { return floor_customers_; }
+  // unnormalized pdf of tables in a document restaurant
+  std::vector<double>& doc_table_pdf() { return doc_table_pdf_; }
+
+  static SamplerContext& current();
+  static void BindToThread(SamplerContext* context);
+
+  /**
+   * Binds a context to the running thread during its lifetime, and restores
+   * the previous one on exit.
+   */
+  class Scope {
+   public:
+    explicit Scope(SamplerContext& context);
+    ~Scope();
+   private:
+    SamplerContext* previous_;
+  };
+
+ private:
+  std::unique_ptr<RandomPhilox> random_;
+  
+  // buffer
+  std::vector<int> floor_customers_;
+  std::vector<double> doc_table_pdf_;
+};
+
+} // namespace topiclm
+
+#endif /* _TOPICLM_SAMPLER_CONTEXT_HPP_ */
@@ -0,0 +1,203 @@
+#include <cmath>
+#include "sampling_worker.hpp"
+#include "context_tree_manager.hpp"
+#include "document_manager.hpp"
+#include "lambda_manager.hpp"
+#include "restaurant_manager.hpp"
+#include "topic_sampler.hpp"
+#include "parameters.hpp"
+#include "node.hpp"
+#include "node_util.hpp"
+
+using namespace std;
+
+namespace topiclm {
+
+SamplingWorker::SamplingWorker(const ContextTreeManager& cmanager,
+                               TreeType tree_type,
+                               DocumentManager& dmanager,
+                               const Parameters& parameters,
+                               int seed,
+                               uint64_t stream)
+    : cmanager_(cmanager),
+      dmanager_(dmanager),
+      parameters_(parameters),
+      consider_general_(tree_type == kNonGraphical),
+      context_(seed, stream),
+      node_path_(parameters.ngram_order(), nullptr),
+      stop_prior_path_(parameters.ngram_order()),
+      topic_sampler_(GetTopicDepthSampler(tree_type, parameters, context_)) {
+  node_path_[0] = cmanager_.ct().root();
+  Sync();
+}
+
+SamplingWorker::~SamplingWorker() {}
+
+void SamplingWorker::Sync() {
+  rmanager_.reset();
+  lmanager_.reset(cmanager_.lmanager().Clone());
+  rmanager_.reset(cmanager_.NewRestaurantManager(node_path_, *lmanager_, context_));
+}
+
+double SamplingWorker::SampleWords(vector<int>::const_iterator word_idx_begin,
+                                   vector<int>::const_iterator word_idx_end) {
+  SamplerContext::Scope scope(context_);
+  samples_.clear();
+  predictive_paths_.clear();
+
+  auto& ct = cmanager_.ct();
+  auto& words = dmanager_.words();
+  double ll = 0;
+  for (auto it = word_idx_begin; it != word_idx_end; ++it) {
+    word_id_t word = *it;
+    auto sent = dmanager_.sentence(word);
+    int type = dmanager_.token(word);
+    int topic = dmanager_.topic(word);
+    int doc_id = words.doc_id(word);
+    int token_idx = words.token_idx(word);
+    dmanager_.DecrementTopicCount(doc_id, topic, words.is_general(word));
+
+    int current_max_depth = ct.WalkTreeNoCreate(sent, token_idx - 1, 0, node_path_);
+    cmanager_.CalcStopPriorPath(node_path_, current_max_depth, token_idx, stop_prior_path_);
+    rmanager_->CalcDepth2TopicPredictives(type, current_max_depth);
+
+    topic_sampler_->InitWithTopicPrior(dmanager_.doc2topic_count()[doc_id],
+                                       lmanager_->lambda_path());
+    topic_sampler_->TakeInStopPrior(stop_prior_path_);
+    topic_sampler_->TakeInLikelihood(rmanager_->depth2topic_predictives());
+    auto sample = topic_sampler_->Sample();
+
+    ll += std::log(sample.p_w);
+
+    if (consider_general_) {
+      words.set_is_general(word, sample.topic == 0);
+    }
+    dmanager_.IncrementTopicCount(doc_id,
+                                  sample.topic,
+                                  parameters_.topic_parameter().alpha[sample.topic],
+                                  words.is_general(word));
+    dmanager_.set_topic(word, sample.topic);
+
+    samples_.push_back({*it, sample.depth, topic_t(sample.topic), predictive_paths_.size()});
+    for (int d = 0; d <= sample.depth; ++d) {
+      predictive_paths_.push_back(rmanager_->predictive(d, kGlobalFloorId));
+      predictive_paths_.push_back(rmanager_->predictive(d, sample.topic));
+    }
+  }
+  return ll;
+}
+
+SubtreeSamplingWorker::SubtreeSamplingWorker(ContextTreeManager& cmanager,
+                                             TreeType tree_type,
+                                             DocumentManager& dmanager,
+                                             const Parameters& parameters,
+                                             SubtreeSamplingLocks& locks,
+                                             int seed,
+                                             uint64_t stream)
+    : cmanager_(cmanager),
+      dmanager_(dmanager),
+      parameters_(parameters),
+      locks_(locks),
+      consider_general_(tree_type == kNonGraphical),
+      context_(seed, stream),
+      node_path_(parameters.ngram_order(), nullptr),
+      stop_prior_path_(parameters.ngram_order()),
+      lmanager_(cmanager.lmanager().Clone()),
+      topic_sampler_(GetTopicDepthSampler(tree_type, parameters, context_)) {
+  node_path_[0] = cmanager_.ct().root();
+  // the lambdas are kept in the shared restaurants (see set_num_threads), so
+  // the clone only has its own buffers
+  lmanager_->set_root_mutex(&locks_.root);
+  rmanager_.reset(cmanager_.NewRestaurantManager(node_path_, *lmanager_, context_));
+  rmanager_->set_root_mutex(&locks_.root);
+}
+
+SubtreeSamplingWorker::~SubtreeSamplingWorker() {}
+
+double SubtreeSamplingWorker::SampleWords(vector<int>::const_iterator word_idx_begin,
+                                          vector<int>::const_iterator word_idx_end) {
+  SamplerContext::Scope scope(context_);
+
+  auto& ct = cmanager_.ct();
+  auto& words = dmanager_.words();
+  double ll = 0;
+  for (auto it = word_idx_begin; it != word_idx_end; ++it) {
+    word_id_t word = *it;
+    auto sent = dmanager_.sentence(word);
+    int type = dmanager_.token(word);
+    int topic = dmanager_.topic(word);
+    int depth = words.depth(word);
+    int doc_id = words.doc_id(word);
+    int token_idx = words.token_idx(word);
+    // the restaurants below the root are owned by this worker and are not
+    // locked; rmanager_ and lmanager_ lock the root restaurant themselves
+    util::UpTreeFromLeaf(words.node(word), depth, node_path_);
+    rmanager_->RemoveStopPassedCustomers(depth);
+    int current_max_depth = 0;
+    if (depth == 0) {
+      lock_guard<mutex> lock(locks_.root); // the children of the root
+      current_max_depth = ct.WalkTreeNoCreate(sent, token_idx - 1, 0, node_path_);
+    } else {
+      current_max_depth = ct.WalkTreeNoCreate(sent, token_idx - 1 - depth, depth, node_path_);
+    }
+    rmanager_->SeparateWordFromSection(type, topic, depth, word);
+    rmanager_->RemoveObservedCustomerFromPath(type, topic, depth);
+    {
+      lock_guard<mutex> lock(locks_.root); // the stop and pass customers of the root
+      cmanager_.CalcStopPriorPath(node_path_, current_max_depth, token_idx, stop_prior_path_);
+    }
+    rmanager_->CalcDepth2TopicPredictives(type, current_max_depth);
+    {
+      lock_guard<mutex> lock(locks_.doc(doc_id));
+      dmanager_.DecrementTopicCount(doc_id, topic, words.is_general(word));
+      topic_sampler_->InitWithTopicPrior(dmanager_.doc2topic_count()[doc_id],
+                                         lmanager_->lambda_path());
+    }
+    topic_sampler_->TakeInStopPrior(stop_prior_path_);
+    topic_sampler_->TakeInLikelihood(rmanager_->depth2topic_predictives());
+    auto sample = topic_sampler_->Sample();
+
+    ll += std::log(sample.p_w);
+
+    if (consider_general_) {
+      words.set_is_general(word, sample.topic == 0);
+    }
+    {
+      lock_guard<mutex> lock(locks_.doc(doc_id));
+      dmanager_.IncrementTopicCount(doc_id,
+                                    sample.topic,
+                                    parameters_.topic_parameter().alpha[sample.topic],
+                                    words.is_general(word));
+      dmanager_.set_topic(word, sample.topic);
+    }
+    if (sample.depth != current_max_depth) {
+      // nodes are created in the shared pool and registry, and linked to
+      // (or unlinked from) their suffixes in the subtrees of other workers
+      lock_guard<mutex> lock(locks_.root);
+      if (sample.depth > current_max_depth) {
+        ct.WalkTree(sent, token_idx - 1 - current_max_depth, current_max_depth,
+                    sample.depth, node_path_);
+      } else {
+        ct.EraseEmptyNodes(current_max_depth, sample.depth, node_path_);
+      }
+    }
+    words.set_depth(word, sample.depth);
+    if (words.node(word) != node_path_[sample.depth]) {
+      if (sample.depth > 0) {
+        lock_guard<mutex> lock(locks_.root);
+        node_path_[0]->add_type2child(type, node_path_[1]);
+      }
+      for (int d = 1; d < sample.depth; ++d) {
+        node_path_[d]->add_type2child(type, node_path_[d+1]);
+      }
+    }
+    words.set_node(word, node_path_[sample.depth]);
+
+    rmanager_->CombineSectionToWord(type, sample.topic, sample.depth, word);
+    rmanager_->AddStopPassedCustomers(sample.depth);
+    rmanager_->AddObservedCustomerToPath(type, sample.topic, sample.depth);
+  }
+  return ll;
+}
+
+} // topiclm
@@ -0,0 +1,130 @@
+#ifndef _TOPICLM_SAMPLING_WORKER_HPP_
+#define _TOPICLM_SAMPLING_WORKER_HPP_
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "config.hpp"
+#include "sampler_context.hpp"
+
+namespace topiclm {
+
+class ContextTreeManager;
+class DocumentManager;
+class LambdaManagerInterface;
+class Node;
+class Parameters;
+class RestaurantManager;
+class TopicDepthSampler;
+
+struct WorkerSample {
+  int word_idx;
+  int depth;
+  topic_t topic;
+  size_t path_offset; // offset of (global, topic) predictive path in the worker
+};
+
+/**
+ * Samples topic/depth of words of its own documents against a read-only view
+ * of the shared context tree (approximate distributed Gibbs, as AD-LDA).
+ *
+ * Words given to SampleWords must have been removed from the restaurants in
+ * advance. Topic counts of documents are updated directly because a document
+ * is owned by exactly one worker; the sampled results are kept in samples()
+ * and seated to the tree by the caller at a sync point.
+ */
+class SamplingWorker {
+ public:
+  SamplingWorker(const ContextTreeManager& cmanager,
+                 TreeType tree_type,
+                 DocumentManager& dmanager,
+                 const Parameters& parameters,
+                 int seed,
+                 uint64_t stream);
+  ~SamplingWorker();
+
+  /**
+   * Take a new snapshot of lambda statistics from the shared tree manager.
+   * Must be called from the main thread at each sync point.
+   */
+  void Sync();
+  double SampleWords(std::vector<int>::const_iterator word_idx_begin,
+                     std::vector<int>::const_iterator word_idx_end);
+
+  const std::vector<WorkerSample>& samples() const { return samples_; }
+  const double* predictive_path(const WorkerSample& sample) const {
+    return &predictive_paths_[sample.path_offset];
+  }
+
+ private:
+  const ContextTreeManager& cmanager_;
+  DocumentManager& dmanager_;
+  const Parameters& parameters_;
+  const bool consider_general_;
+
+  SamplerContext context_;
+  std::vector<Node*> node_path_;
+  std::vector<double> stop_prior_path_;
+  std::unique_ptr<LambdaManagerInterface> lmanager_;
+  std::unique_ptr<RestaurantManager> rmanager_;
+  std::unique_ptr<TopicDepthSampler> topic_sampler_;
+
+  std::vector<WorkerSample> samples_;
+  std::vector<double> predictive_paths_;
+};
+
+/**
+ * Locks shared by SubtreeSamplingWorkers. The root node (its restaurant and
+ * children) and the creation and erasure of nodes (the node pool, the
+ * depth2nodes and the suffix links of the tree) are guarded by root; the
+ * topic counts of a document by one of the striped doc mutexes.
+ */
+struct SubtreeSamplingLocks {
+  SubtreeSamplingLocks() : docs(64) {}
+  std::mutex& doc(int doc_id) { return docs[doc_id % docs.size()]; }
+
+  std::mutex root;
+  std::vector<std::mutex> docs;
+};
+
+/**
+ * Samples words in place on the shared context tree, as the serial sampler
+ * does. The words given to a worker must be routed by their depth-1 context
+ * (the preceding word), so that each subtree below the root is touched by
+ * exactly one worker and is updated without locks; only the root part is
+ * shared and guarded by locks. Lambdas must be hierarchical (kept in the
+ * restaurants of the tree).
+ */
+class SubtreeSamplingWorker {
+ public:
+  SubtreeSamplingWorker(ContextTreeManager& cmanager,
+                        TreeType tree_type,
+                        DocumentManager& dmanager,
+                        const Parameters& parameters,
+                        SubtreeSamplingLocks& locks,
+                        int seed,
+                        uint64_t stream);
+  ~SubtreeSamplingWorker();
+
+  double SampleWords(std::vector<int>::const_iterator word_idx_begin,
+                     std::vector<int>::const_iterator word_idx_end);
+
+ private:
+  ContextTreeManager& cmanager_;
+  DocumentManager& dmanager_;
+  const Parameters& parameters_;
+  SubtreeSamplingLocks& locks_;
+  const bool consider_general_;
+
+  SamplerContext context_;
+  std::vector<Node*> node_path_;
+  std::vector<double> stop_prior_path_;
+  std::unique_ptr<LambdaManagerInterface> lmanager_;
+  std::unique_ptr<RestaurantManager> rmanager_;
+  std::unique_ptr<TopicDepthSampler> topic_sampler_;
+};
+
+} // topiclm
+
+#endif /* _TOPICLM_SAMPLING_WORKER_HPP_ */
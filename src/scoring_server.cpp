@@ -0,0 +1,249 @@
+#include <sstream>
+#include <algorithm>
+#include <functional>
+#include <pficommon/text/json.h>
+#include "scoring_server.hpp"
+#include "topiclm_model.hpp"
+#include "test_predictive_cache.hpp"
+
+using namespace std;
+using namespace pfi::text::json;
+
+namespace topiclm {
+
+namespace {
+const size_t kLatencyWindow = 10000;
+
+// the string field key of a request; a missing or non-string one is an
+// error of the protocol rather than of the json library
+string GetStringField(json& request, const string& key) {
+  if (!request.count(key)) {
+    throw string("missing \"" + key + "\"");
+  }
+  if (!is<json_string>(request[key])) {
+    throw string("\"" + key + "\" is not a string");
+  }
+  return json_cast<string>(request[key]);
+}
+}
+
+struct ScoringServer::Session {
+  std::unique_ptr<FrozenSession> session;
+  bool store;
+};
+
+ScoringServer::ScoringServer(HpyLdaModel<FrozenHpyLdaSampler>& model,
+                             int num_threads,
+                             int num_particles,
+                             int step,
+                             const RejuvenationPolicy& rejuvenation,
+                             bool calc_eos)
+    : model_(model),
+      num_particles_(num_particles),
+      step_(step),
+      rejuvenation_(rejuvenation),
+      calc_eos_(calc_eos),
+      reader_(model.reader_for_test()),
+      num_sessions_(0),
+      num_open_sessions_(0),
+      os_(nullptr),
+      num_requests_(0),
+      num_errors_(0),
+      num_tokens_(0),
+      latency_pos_(0) {
+  for (int i = 0; i < max(num_threads, 1); ++i) {
+    workers_.emplace_back(new Worker());
+  }
+}
+
+ScoringServer::~ScoringServer() {}
+
+void ScoringServer::Serve(std::istream& is, std::ostream& os) {
+  os_ = &os;
+  start_ = Clock::now();
+  for (auto& worker : workers_) {
+    Worker* w = worker.get();
+    w->thread = thread([this, w] { Run(*w); });
+  }
+  hash<string> hasher;
+  for (string line; getline(is, line); ) {
+    if (line.empty()) continue;
+    // requests of a client go to the same worker; a malformed line goes anywhere
+    string client;
+    try {
+      json request;
+      istringstream iss(line);
+      iss >> request;
+      if (request.count("client")) {
+        client = json_cast<string>(request["client"]);
+      }
+    } catch (...) {}
+    Worker& worker = *workers_[hasher(client) % workers_.size()];
+    {
+      lock_guard<mutex> lock(worker.mutex);
+      worker.queue.push_back(Request{line, Clock::now()});
+    }
+    worker.cond.notify_one();
+  }
+  for (auto& worker : workers_) {
+    {
+      lock_guard<mutex> lock(worker->mutex);
+      worker->closed = true;
+    }
+    worker->cond.notify_one();
+  }
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+void ScoringServer::Run(Worker& worker) {
+  for (;;) {
+    Request request;
+    {
+      unique_lock<mutex> lock(worker.mutex);
+      worker.cond.wait(lock, [&worker] { return worker.closed || !worker.queue.empty(); });
+      if (worker.queue.empty()) return;
+      request = std::move(worker.queue.front());
+      worker.queue.pop_front();
+    }
+    string response = Handle(worker, request);
+    {
+      lock_guard<mutex> lock(output_mutex_);
+      (*os_) << response << endl;
+    }
+  }
+}
+
+std::string ScoringServer::Handle(Worker& worker, const Request& queued) {
+  json response(new json_object());
+  int tokens = 0;
+  bool error = false;
+  try {
+    json request;
+    istringstream iss(queued.line);
+    iss >> request;
+    if (request.count("tag")) {
+      response.add("tag", request["tag"]);
+    }
+    string command = GetStringField(request, "command");
+    response.add("command", json(new json_string(command)));
+
+    if (command == "stats") {
+      istringstream stats(Stats());
+      json stats_json;
+      stats >> stats_json;
+      response.add("stats", stats_json);
+    } else {
+      string client = GetStringField(request, "client");
+      response.add("client", json(new json_string(client)));
+      if (command == "close") {
+        bool closed = worker.sessions.erase(client) > 0;
+        if (closed) --num_open_sessions_;
+        response.add("closed", json(new json_bool(closed)));
+      } else {
+        auto& session = GetSession(worker, client);
+        if (command == "store") {
+          session.store = true;
+        } else if (command == "readonly") {
+          session.store = false;
+        } else if (command == "reestimate") {
+          session.session->sampler().ResampleAll();
+        } else if (command == "score") {
+          auto sentence = ReadSentence(GetStringField(request, "text"));
+          double log_probability = session.session->sampler().log_probability(sentence, session.store);
+          tokens = sentence.size();
+          response.add("log_probability", json(new json_float(log_probability)));
+          response.add("tokens", json(new json_integer(tokens)));
+        } else {
+          throw string("unknown command: " + command);
+        }
+      }
+    }
+  } catch (string& what) {
+    error = true;
+    response.add("error", json(new json_string(what)));
+  } catch (std::exception& e) {
+    error = true;
+    response.add("error", json(new json_string(string("invalid request: ") + e.what())));
+  }
+  // latencies include the time in the queue of the worker
+  Record(queued.arrival, tokens, error);
+  ostringstream oss;
+  oss << response;
+  return oss.str();
+}
+
+ScoringServer::Session& ScoringServer::GetSession(Worker& worker, const std::string& client) {
+  auto& session = worker.sessions[client];
+  if (!session) {
+    session.reset(new Session());
+    session->session = model_.sampler().NewSession(model_.GetPFDocumentManager(num_particles_),
+                                                   step_,
+                                                   num_sessions_++);
+    session->session->sampler().set_rejuvenation(rejuvenation_);
+    session->store = true;
+    ++num_open_sessions_;
+  }
+  return *session;
+}
+
+std::vector<int> ScoringServer::ReadSentence(const std::string& text) {
+  lock_guard<mutex> lock(dict_mutex_);
+  auto sentence = reader_->Read(model_.intern(), text);
+  if (!calc_eos_) sentence.pop_back();
+  return sentence;
+}
+
+void ScoringServer::Record(Clock::time_point arrival, int tokens, bool error) {
+  double latency = chrono::duration<double, micro>(Clock::now() - arrival).count();
+  lock_guard<mutex> lock(stats_mutex_);
+  ++num_requests_;
+  if (error) ++num_errors_;
+  num_tokens_ += tokens;
+  if (latencies_.size() < kLatencyWindow) {
+    latencies_.push_back(latency);
+  } else {
+    latencies_[latency_pos_] = latency;
+    latency_pos_ = (latency_pos_ + 1) % kLatencyWindow;
+  }
+}
+
+std::string ScoringServer::Stats() {
+  lock_guard<mutex> lock(stats_mutex_);
+  double elapsed = chrono::duration<double>(Clock::now() - start_).count();
+  vector<double> latencies(latencies_);
+  auto percentile = [&latencies](double p) {
+    if (latencies.empty()) return 0.0;
+    size_t k = min(latencies.size() - 1, size_t(p * latencies.size()));
+    nth_element(latencies.begin(), latencies.begin() + k, latencies.end());
+    return latencies[k];
+  };
+  uint64_t num_sessions = num_open_sessions_;
+  ostringstream oss;
+  oss << "{\"uptime_sec\": " << elapsed
+      << ", \"requests\": " << num_requests_
+      << ", \"errors\": " << num_errors_
+      << ", \"tokens\": " << num_tokens_
+      << ", \"sessions\": " << num_sessions
+      << ", \"requests_per_sec\": " << (elapsed > 0 ? num_requests_ / elapsed : 0)
+      << ", \"tokens_per_sec\": " << (elapsed > 0 ? num_tokens_ / elapsed : 0)
+      << ", \"latency_us\": {\"p50\": " << percentile(0.5)
+      << ", \"p99\": " << percentile(0.99)
+      << ", \"max\": " << percentile(1.0)
+      << ", \"window\": " << latencies.size() << "}";
+  if (auto cache = model_.sampler().predictive_cache()) {
+    auto cache_stats = cache->stats();
+    oss << ", \"predictive_cache\": {\"hits\": " << cache_stats.hits
+        << ", \"misses\": " << cache_stats.misses
+        << ", \"hit_rate\": " << cache_stats.hit_rate()
+        << ", \"evictions\": " << cache_stats.evictions
+        << ", \"entries\": " << cache_stats.entries
+        << ", \"bytes\": " << cache_stats.bytes
+        << ", \"max_bytes\": " << cache->max_bytes() << "}";
+  }
+  oss << "}";
+  return oss.str();
+}
+
+} // topiclm
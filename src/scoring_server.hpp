@@ -0,0 +1,105 @@
+#ifndef _TOPICLM_SCORING_SERVER_HPP_
+#define _TOPICLM_SCORING_SERVER_HPP_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <unordered_map>
+#include <istream>
+#include <ostream>
+#include "particle_filter_sampler.hpp"
+
+namespace topiclm {
+
+template <class SamplerType> class HpyLdaModel;
+class FrozenHpyLdaSampler;
+class FrozenSession;
+class Reader;
+
+/**
+ * Long-running scorer over a line-JSON protocol: one request object per
+ * input line, one response object per output line.
+ *
+ *   {"client": "u1", "command": "score", "text": "a sentence"}
+ *   -> {"client": "u1", "command": "score", "log_probability": -12.3, "tokens": 3}
+ *
+ * Commands are score, store, readonly, reestimate (as in the shell of
+ * log_probability), close (drop the session) and stats. Each client id has
+ * its own particle filter document session, created on its first request in
+ * the store mode. The compiled model is loaded once and shared read-only
+ * by the worker threads; requests of a client are always handled by the
+ * same worker, in order. A "tag" of a request is copied to its response.
+ */
+class ScoringServer {
+ public:
+  ScoringServer(HpyLdaModel<FrozenHpyLdaSampler>& model,
+                int num_threads,
+                int num_particles,
+                int step,
+                const RejuvenationPolicy& rejuvenation,
+                bool calc_eos);
+  ~ScoringServer();
+
+  /**
+   * Serve the requests of is until its end.
+   */
+  void Serve(std::istream& is, std::ostream& os);
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Request {
+    std::string line;
+    Clock::time_point arrival;
+  };
+  struct Session;
+  struct Worker {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Request> queue;
+    bool closed = false;
+    std::unordered_map<std::string, std::unique_ptr<Session> > sessions;
+    std::thread thread;
+  };
+
+  void Run(Worker& worker);
+  std::string Handle(Worker& worker, const Request& request);
+  Session& GetSession(Worker& worker, const std::string& client);
+  std::vector<int> ReadSentence(const std::string& text);
+  std::string Stats();
+  void Record(Clock::time_point arrival, int tokens, bool error);
+
+  HpyLdaModel<FrozenHpyLdaSampler>& model_;
+  const int num_particles_;
+  const int step_;
+  const RejuvenationPolicy rejuvenation_;
+  const bool calc_eos_;
+
+  std::shared_ptr<Reader> reader_;
+  std::mutex dict_mutex_; // the reader may add unknown words to the dictionary
+  std::atomic<uint64_t> num_sessions_; // ever created, for their streams
+  std::atomic<uint64_t> num_open_sessions_; // the maps of workers are theirs only
+
+  std::vector<std::unique_ptr<Worker> > workers_;
+  std::ostream* os_;
+  std::mutex output_mutex_;
+
+  // stats
+  std::mutex stats_mutex_;
+  Clock::time_point start_;
+  uint64_t num_requests_;
+  uint64_t num_errors_;
+  uint64_t num_tokens_;
+  std::vector<double> latencies_; // microseconds of the last kLatencyWindow requests
+  size_t latency_pos_;
+};
+
+} // topiclm
+
+#endif /* _TOPICLM_SCORING_SERVER_HPP_ */
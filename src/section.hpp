@@ -7,6 +7,7 @@
 #include "serialization.hpp"
 #include "word.hpp"
 #include "util.hpp"
+#include "small_vector.hpp"
 
 namespace topiclm {
 
@@ -37,11 +38,18 @@ struct BinaryHistoKey {
 };
 
 
+// (customers sitting at a table, number of such tables), sorted by customers
+typedef SmallVector<std::pair<int, int>, 1> LabelHistogram;
+
+/**
+ * Nearly every section of a deep node has a single label with a single
+ * bucket, which is then stored inline without any heap allocation.
+ */
 struct HistgramSection {
-  std::vector<std::pair<topic_t, std::vector<std::pair<int, int> > > > customer_histogram; // -1 -> local
+  SmallVector<std::pair<topic_t, LabelHistogram>, 1> customer_histogram; // -1 -> local
   int customers;
   int tables;
-  std::vector<std::shared_ptr<Word> > observeds;
+  std::vector<word_id_t> observeds;
   HistgramSection() : customers(0), tables(0) {}
 
   void AddNewTable(topic_t label, int num_customer) {
@@ -55,7 +63,7 @@ struct HistgramSection {
         label_histo.insert(customer_it, {num_customer, 1});
       }
     } else {
-      customer_histogram.insert(label_it, {label, {1, {num_customer, 1}}});
+      customer_histogram.insert(label_it, {label, {{num_customer, 1}}});
     }
     ++tables;
   }
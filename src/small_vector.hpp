@@ -0,0 +1,205 @@
+#ifndef _TOPICLM_SMALL_VECTOR_HPP_
+#define _TOPICLM_SMALL_VECTOR_HPP_
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "serialization.hpp"
+
+namespace topiclm {
+
+/**
+ * Vector which keeps up to N elements inline and spills to the heap beyond.
+ * Only the part of the std::vector interface used by the restaurants is
+ * provided; iterators are plain pointers. Serialized as a std::vector.
+ */
+template <typename T, size_t N>
+class SmallVector {
+  static_assert(N > 0, "SmallVector needs at least one inline element");
+ public:
+  typedef T value_type;
+  typedef T* iterator;
+  typedef const T* const_iterator;
+
+  SmallVector() : size_(0), capacity_(N) {}
+  SmallVector(std::initializer_list<T> init) : size_(0), capacity_(N) {
+    reserve(init.size());
+    for (auto& v : init) new (data() + size_++) T(v);
+  }
+  SmallVector(const SmallVector& other) : size_(0), capacity_(N) {
+    CopyFrom(other);
+  }
+  SmallVector(SmallVector&& other) noexcept : size_(0), capacity_(N) {
+    MoveFrom(other);
+  }
+  ~SmallVector() {
+    Release();
+  }
+  SmallVector& operator=(const SmallVector& other) {
+    if (this != &other) {
+      clear();
+      CopyFrom(other);
+    }
+    return *this;
+  }
+  SmallVector& operator=(SmallVector&& other) noexcept {
+    if (this != &other) {
+      Release();
+      size_ = 0;
+      capacity_ = N;
+      MoveFrom(other);
+    }
+    return *this;
+  }
+
+  T* data() { return is_inline() ? reinterpret_cast<T*>(inline_) : heap_; }
+  const T* data() const { return is_inline() ? reinterpret_cast<const T*>(inline_) : heap_; }
+  iterator begin() { return data(); }
+  iterator end() { return data() + size_; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size_; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  bool empty() const { return size_ == 0; }
+  T& operator[](size_t i) { return data()[i]; }
+  const T& operator[](size_t i) const { return data()[i]; }
+  T& front() { return data()[0]; }
+  T& back() { return data()[size_ - 1]; }
+  const T& back() const { return data()[size_ - 1]; }
+
+  void push_back(T value) {
+    if (size_ == capacity_) Grow(2 * capacity_);
+    new (data() + size_) T(std::move(value));
+    ++size_;
+  }
+  iterator insert(const_iterator pos, T value) {
+    size_t idx = pos - data();
+    if (size_ == capacity_) Grow(2 * capacity_);
+    T* d = data();
+    if (idx == size_) {
+      new (d + size_) T(std::move(value));
+    } else {
+      new (d + size_) T(std::move(d[size_ - 1]));
+      std::move_backward(d + idx, d + size_ - 1, d + size_);
+      d[idx] = std::move(value);
+    }
+    ++size_;
+    return d + idx;
+  }
+  iterator erase(const_iterator pos) {
+    size_t idx = pos - data();
+    T* d = data();
+    std::move(d + idx + 1, d + size_, d + idx);
+    d[--size_].~T();
+    return d + idx;
+  }
+  void resize(size_t n) {
+    reserve(n);
+    while (size_ > n) data()[--size_].~T();
+    while (size_ < n) new (data() + size_++) T();
+  }
+  void clear() {
+    T* d = data();
+    for (size_t i = 0; i < size_; ++i) d[i].~T();
+    size_ = 0;
+  }
+  void reserve(size_t n) {
+    if (n > capacity_) Grow(n);
+  }
+  /**
+   * Move the elements back inline if they fit, or to a smaller heap block.
+   */
+  void shrink_to_fit() {
+    if (is_inline() || size_ == capacity_) return;
+    T* old = heap_;
+    uint32_t old_size = size_;
+    if (size_ <= N) {
+      capacity_ = N;
+    } else {
+      capacity_ = size_;
+      heap_ = static_cast<T*>(::operator new(sizeof(T) * capacity_));
+    }
+    T* d = data();
+    for (uint32_t i = 0; i < old_size; ++i) {
+      new (d + i) T(std::move(old[i]));
+      old[i].~T();
+    }
+    ::operator delete(old);
+  }
+
+ private:
+  bool is_inline() const { return capacity_ == N; }
+
+  void Grow(size_t n) {
+    T* d = data();
+    T* grown = static_cast<T*>(::operator new(sizeof(T) * n));
+    for (uint32_t i = 0; i < size_; ++i) {
+      new (grown + i) T(std::move(d[i]));
+      d[i].~T();
+    }
+    if (!is_inline()) ::operator delete(heap_);
+    heap_ = grown;
+    capacity_ = n;
+  }
+  void Release() {
+    clear();
+    if (!is_inline()) ::operator delete(heap_);
+  }
+  // *this must be empty and inline
+  void CopyFrom(const SmallVector& other) {
+    reserve(other.size_);
+    for (uint32_t i = 0; i < other.size_; ++i) {
+      new (data() + i) T(other[i]);
+    }
+    size_ = other.size_;
+  }
+  void MoveFrom(SmallVector& other) {
+    if (other.is_inline()) {
+      for (uint32_t i = 0; i < other.size_; ++i) {
+        new (data() + i) T(std::move(other[i]));
+      }
+      size_ = other.size_;
+      other.clear();
+    } else {
+      heap_ = other.heap_;
+      size_ = other.size_;
+      capacity_ = other.capacity_;
+      other.size_ = 0;
+      other.capacity_ = N;
+    }
+  }
+
+  union {
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type inline_[N];
+    T* heap_;
+  };
+  uint32_t size_;
+  uint32_t capacity_; // N while the elements are inline
+
+  friend class pfi::data::serialization::access;
+  template <class Archive>
+  void serialize(Archive& ar) {
+    uint32_t size = size_;
+    ar & size;
+    resize(size);
+    for (uint32_t i = 0; i < size; ++i) {
+      ar & data()[i];
+    }
+  }
+};
+
+template <typename T, size_t N, typename Iter>
+void EraseAndShrink(SmallVector<T, N>& x, Iter it) {
+  x.erase(it);
+  if (x.size() < x.capacity() / 4) {
+    x.shrink_to_fit();
+  }
+}
+
+} // namespace topiclm
+
+#endif /* _TOPICLM_SMALL_VECTOR_HPP_ */
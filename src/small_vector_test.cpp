@@ -0,0 +1,85 @@
+#include <vector>
+#include <string>
+#include <sstream>
+#include <utility>
+#include "small_vector.hpp"
+#include "section.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace topiclm;
+using namespace std;
+
+namespace {
+
+// HistgramSection::customer_histogram before and after SmallVector
+typedef vector<pair<topic_t, vector<pair<int, int> > > > OldHistogram;
+typedef SmallVector<pair<topic_t, LabelHistogram>, 1> Histogram;
+
+template <class T>
+string Serialize(T& x) {
+  stringstream ss;
+  pfi::data::serialization::binary_oarchive oa(ss);
+  oa << x;
+  return ss.str();
+}
+
+template <class T>
+void Deserialize(const string& bytes, T& x) {
+  stringstream ss(bytes);
+  pfi::data::serialization::binary_iarchive ia(ss);
+  ia >> x;
+}
+
+// num_labels labels, label l with l + 1 buckets (inline for the first)
+void Fill(int num_labels, OldHistogram& old_histogram, Histogram& histogram) {
+  for (int l = 0; l < num_labels; ++l) {
+    topic_t label = l - 1;
+    old_histogram.push_back({label, {}});
+    histogram.push_back({label, {}});
+    for (int b = 0; b <= l; ++b) {
+      old_histogram.back().second.push_back({b + 1, 10 * l + b});
+      histogram.back().second.push_back({b + 1, 10 * l + b});
+    }
+  }
+}
+
+void ExpectSame(const OldHistogram& expected, const Histogram& actual) {
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t l = 0; l < expected.size(); ++l) {
+    EXPECT_EQ(expected[l].first, actual[l].first);
+    vector<pair<int, int> > buckets(actual[l].second.begin(), actual[l].second.end());
+    EXPECT_EQ(expected[l].second, buckets);
+  }
+}
+
+} // namespace
+
+TEST(small_vector, serializes_as_vector) {
+  for (int num_labels : {0, 1, 4}) {
+    OldHistogram old_histogram;
+    Histogram histogram;
+    Fill(num_labels, old_histogram, histogram);
+    EXPECT_EQ(Serialize(old_histogram), Serialize(histogram)) << num_labels << " labels";
+
+    Histogram read;
+    Deserialize(Serialize(old_histogram), read);
+    ExpectSame(old_histogram, read);
+
+    OldHistogram old_read;
+    Deserialize(Serialize(histogram), old_read);
+    EXPECT_EQ(old_histogram, old_read);
+  }
+}
+
+TEST(small_vector, reads_over_inline_and_heap_elements) {
+  // read into a vector spilled to the heap, then grown by a longer one
+  vector<int> small = {3};
+  vector<int> large = {1, 2, 3, 4, 5, 6};
+  SmallVector<int, 2> x = {7, 8, 9};
+  Deserialize(Serialize(small), x);
+  EXPECT_EQ(small, vector<int>(x.begin(), x.end()));
+  Deserialize(Serialize(large), x);
+  EXPECT_EQ(large, vector<int>(x.begin(), x.end()));
+  EXPECT_EQ(Serialize(large), Serialize(x));
+}
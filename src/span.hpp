@@ -0,0 +1,38 @@
+#ifndef _TOPICLM_SPAN_HPP_
+#define _TOPICLM_SPAN_HPP_
+
+#include <vector>
+#include <cstddef>
+#include <stdexcept>
+
+namespace topiclm {
+
+/**
+ * Read-only view of a contiguous range, e.g. a sentence of the packed corpus
+ * in DocumentManager. A vector converts to it implicitly.
+ */
+template <typename T>
+class Span {
+ public:
+  Span() : begin_(nullptr), end_(nullptr) {}
+  Span(const T* begin, const T* end) : begin_(begin), end_(end) {}
+  Span(const std::vector<T>& v) : begin_(v.data()), end_(v.data() + v.size()) {}
+
+  const T& operator[](size_t i) const { return begin_[i]; }
+  const T& at(size_t i) const {
+    if (i >= size()) throw std::out_of_range("Span::at");
+    return begin_[i];
+  }
+  size_t size() const { return end_ - begin_; }
+  bool empty() const { return begin_ == end_; }
+  const T* begin() const { return begin_; }
+  const T* end() const { return end_; }
+
+ private:
+  const T* begin_;
+  const T* end_;
+};
+
+} // topiclm
+
+#endif /* _TOPICLM_SPAN_HPP_ */
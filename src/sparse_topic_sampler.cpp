@@ -0,0 +1,191 @@
+#include <cassert>
+#include <algorithm>
+#include "sparse_topic_sampler.hpp"
+#include "parameters.hpp"
+#include "document_manager.hpp"
+#include "restaurant_manager.hpp"
+#include "sampler_context.hpp"
+
+using namespace std;
+
+namespace topiclm {
+
+SparseTopicDepthSampler::SparseTopicDepthSampler(const Parameters& parameters,
+                                                 TreeType tree_type,
+                                                 RestaurantManager& rmanager,
+                                                 const vector<double>& lambda_path,
+                                                 SamplerContext& context)
+    : num_topics_(parameters.topic_parameter().num_topics),
+      ngram_order_(parameters.ngram_order()),
+      non_graphical_(tree_type == kNonGraphical),
+      topic_parameter_(parameters.topic_parameter()),
+      rmanager_(rmanager),
+      lambda_path_(lambda_path),
+      context_(context),
+      root_smoothing_(num_topics_ + 1, 1.0),
+      alpha_smoothing_sum_(0),
+      alpha_sum_(0),
+      last_topic_(-1),
+      marks_(num_topics_ + 1, 0),
+      depth_coefficients_(ngram_order_),
+      shared_x_(0),
+      shared_y_(0),
+      depth_weights_(ngram_order_) {}
+
+void SparseTopicDepthSampler::BeginIteration() {
+  alpha_smoothing_sum_ = 0;
+  alpha_sum_ = 0;
+  for (int j = 1; j < num_topics_ + 1; ++j) {
+    root_smoothing_[j] = rmanager_.RootSmoothingRatio(j);
+    alpha_smoothing_sum_ += topic_parameter_.alpha[j] * root_smoothing_[j];
+    alpha_sum_ += topic_parameter_.alpha[j];
+  }
+  last_topic_ = -1;
+}
+
+void SparseTopicDepthSampler::UpdateSmoothing(topic_t topic) {
+  if (topic <= kGlobalFloorId) return;
+  double smoothing = rmanager_.RootSmoothingRatio(topic);
+  alpha_smoothing_sum_ += topic_parameter_.alpha[topic] * (smoothing - root_smoothing_[topic]);
+  root_smoothing_[topic] = smoothing;
+}
+
+void SparseTopicDepthSampler::CalcSharedPath(const vector<double>& stop_prior_path) {
+  // predictives of a topic off the path are u_i * s_j + v_i: the base of
+  // the root scaled by s_j, then (graphical) mixed with the global ones by
+  // lambda below, as in CalcTopicPredictivePath
+  double zero_order = rmanager_.predictive(-1, 1);
+  double u = 0;
+  double v = 0;
+  shared_x_ = 0;
+  shared_y_ = 0;
+  for (int i = 0; i < ngram_order_; ++i) {
+    double lambda = lambda_path_[i];
+    double global = rmanager_.predictive(i, kGlobalFloorId);
+    if (non_graphical_) {
+      u = zero_order;
+      depth_coefficients_[i] = lambda * stop_prior_path[i];
+    } else {
+      if (i == 0) {
+        u = lambda * zero_order + (1 - lambda) * global;
+      } else {
+        u = lambda * u;
+        v = lambda * v + (1 - lambda) * global;
+      }
+      depth_coefficients_[i] = stop_prior_path[i];
+    }
+    shared_x_ += depth_coefficients_[i] * u;
+    shared_y_ += depth_coefficients_[i] * v;
+  }
+}
+
+double SparseTopicDepthSampler::TopicWeight(int type,
+                                            topic_t topic,
+                                            double prior,
+                                            const vector<double>& stop_prior_path,
+                                            int word_depth) {
+  rmanager_.CalcTopicPredictivePath(type, topic, word_depth);
+  double sum = 0;
+  for (int i = 0; i < ngram_order_; ++i) {
+    double w = stop_prior_path[i] * rmanager_.predictive(i, topic);
+    if (non_graphical_) {
+      w *= topic == kGlobalFloorId ? 1 - lambda_path_[i] : lambda_path_[i] * prior;
+    } else {
+      w *= prior;
+    }
+    depth_weights_[i] = w;
+    sum += w;
+  }
+  return sum;
+}
+
+topic_t SparseTopicDepthSampler::SampleSmoothingBucket(double u) const {
+  topic_t topic = -1;
+  for (int j = 1; j < num_topics_ + 1; ++j) {
+    if (marks_[j]) continue;
+    double w = topic_parameter_.alpha[j] * (root_smoothing_[j] * shared_x_ + shared_y_);
+    if (w <= 0) continue;
+    topic = j;
+    if (u < w) break;
+    u -= w;
+  }
+  return topic;
+}
+
+SampleInfo SparseTopicDepthSampler::Sample(const DocumentManager& dmanager,
+                                           word_id_t word,
+                                           int type,
+                                           int removed_topic,
+                                           const vector<double>& stop_prior_path,
+                                           int word_depth) {
+  int doc_id = dmanager.words().doc_id(word);
+  auto& topic_count = dmanager.doc2topic_count()[doc_id];
+  auto& doc_topics = dmanager.doc2topics()[doc_id];
+  double inv_total = 1.0 / (topic_count.first + topic_parameter_.alpha_1);
+  auto prior = [&](topic_t topic) {
+    return (topic_count.second[topic] + topic_parameter_.alpha[topic]) * inv_total;
+  };
+  auto doc_weight = [&](topic_t topic) {
+    return topic_count.second[topic] * (root_smoothing_[topic] * shared_x_ + shared_y_) * inv_total;
+  };
+
+  UpdateSmoothing(last_topic_);
+  UpdateSmoothing(removed_topic);
+  rmanager_.CalcLambdaAndGlobalPredictivePath(type, word_depth);
+  CalcSharedPath(stop_prior_path);
+
+  double global_weight = TopicWeight(type, kGlobalFloorId, prior(kGlobalFloorId),
+                                     stop_prior_path, word_depth);
+  rmanager_.CollectPathTopics(type, word_depth, path_topics_, marks_);
+  path_weights_.resize(path_topics_.size());
+  double path_sum = 0;
+  double path_alpha_smoothing = 0;
+  double path_alpha = 0;
+  for (size_t k = 0; k < path_topics_.size(); ++k) {
+    topic_t j = path_topics_[k];
+    path_weights_[k] = TopicWeight(type, j, prior(j), stop_prior_path, word_depth);
+    path_sum += path_weights_[k];
+    path_alpha_smoothing += topic_parameter_.alpha[j] * root_smoothing_[j];
+    path_alpha += topic_parameter_.alpha[j];
+  }
+  double doc_sum = 0;
+  for (auto j : doc_topics) {
+    if (j != kGlobalFloorId && !marks_[j]) doc_sum += doc_weight(j);
+  }
+  double smoothing_sum = max(0.0, shared_x_ * (alpha_smoothing_sum_ - path_alpha_smoothing)
+                             + shared_y_ * (alpha_sum_ - path_alpha)) * inv_total;
+  double p_w = global_weight + path_sum + doc_sum + smoothing_sum;
+
+  double u = context_.random().NextDouble() * p_w;
+  topic_t topic = -1;
+  if (u < global_weight) {
+    topic = kGlobalFloorId;
+  } else if ((u -= global_weight) < path_sum || (doc_sum <= 0 && smoothing_sum <= 0)) {
+    for (size_t k = 0; k < path_topics_.size(); ++k) {
+      if (path_weights_[k] <= 0) continue;
+      topic = path_topics_[k];
+      if (u < path_weights_[k]) break;
+      u -= path_weights_[k];
+    }
+  } else if ((u -= path_sum) < doc_sum || smoothing_sum <= 0) {
+    for (auto j : doc_topics) {
+      if (j == kGlobalFloorId || marks_[j]) continue;
+      double w = doc_weight(j);
+      if (w <= 0) continue;
+      topic = j;
+      if (u < w) break;
+      u -= w;
+    }
+  } else {
+    topic = SampleSmoothingBucket((u - doc_sum) / inv_total);
+  }
+  if (topic < 0) topic = kGlobalFloorId; // only by rounding
+  for (auto j : path_topics_) marks_[j] = 0;
+
+  TopicWeight(type, topic, prior(topic), stop_prior_path, word_depth);
+  int depth = context_.random().SampleUnnormalizedPdfRef(depth_weights_);
+  last_topic_ = topic;
+  return {false, depth, topic, p_w};
+}
+
+} // namespace topiclm
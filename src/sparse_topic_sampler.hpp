@@ -0,0 +1,87 @@
+#ifndef _TOPICLM_SPARSE_TOPIC_SAMPLER_HPP_
+#define _TOPICLM_SPARSE_TOPIC_SAMPLER_HPP_
+
+#include <vector>
+#include "config.hpp"
+#include "word.hpp"
+#include "topic_sampler.hpp"
+
+namespace topiclm {
+
+class DocumentManager;
+class RestaurantManager;
+
+/**
+ * Exact topic-depth sampler for training (SparseLDA style) whose cost per
+ * word grows with the topics in use around it rather than with K.
+ *
+ * A topic j whose floors on the path are empty below the root, and without
+ * the type at the root, has predictives u_i * s_j + v_i, where s_j is the
+ * smoothing ratio of its root floor and u, v are shared; so its posterior is
+ * (n_dj + alpha_j) (s_j X + Y) / (n_d + alpha_1). The posterior is split
+ * into
+ *  - the smoothing bucket, sum of alpha_j (s_j X + Y) over such topics, from
+ *    sum_j alpha_j s_j, which is kept up to date as root floors change,
+ *  - the document bucket, over such topics used in the document,
+ *  - the path bucket, the other topics computed exactly, and topic 0.
+ * Only the smoothing bucket needs a pass over all topics, when it is drawn.
+ * Needs lambdas shared by the topics (not Wood's) in the graphical tree.
+ */
+class SparseTopicDepthSampler {
+ public:
+  SparseTopicDepthSampler(const Parameters& parameters,
+                          TreeType tree_type,
+                          RestaurantManager& rmanager,
+                          const std::vector<double>& lambda_path,
+                          SamplerContext& context);
+
+  /**
+   * Recompute the smoothing of all topics (after the hyperparameters or
+   * the tree have changed outside Sample).
+   */
+  void BeginIteration();
+  /**
+   * Sample the topic and depth of word (removed from the tree and counts),
+   * on the path after CalcStopPriorPath. Leaves the predictives of the
+   * sampled topic as AddCustomerToPath reads them.
+   */
+  SampleInfo Sample(const DocumentManager& dmanager,
+                    word_id_t word,
+                    int type,
+                    int removed_topic,
+                    const std::vector<double>& stop_prior_path,
+                    int word_depth);
+
+ private:
+  void UpdateSmoothing(topic_t topic);
+  void CalcSharedPath(const std::vector<double>& stop_prior_path);
+  double TopicWeight(int type, topic_t topic, double prior,
+                     const std::vector<double>& stop_prior_path, int word_depth);
+  topic_t SampleSmoothingBucket(double u) const;
+
+  const int num_topics_;
+  const int ngram_order_;
+  const bool non_graphical_;
+  const DirichletParameter& topic_parameter_;
+  RestaurantManager& rmanager_;
+  const std::vector<double>& lambda_path_;
+  SamplerContext& context_;
+
+  std::vector<double> root_smoothing_; // s_j
+  double alpha_smoothing_sum_; // sum_{j>0} alpha_j s_j
+  double alpha_sum_; // sum_{j>0} alpha_j
+  topic_t last_topic_; // added to the tree after the last Sample
+
+  // buffers
+  std::vector<topic_t> path_topics_;
+  std::vector<char> marks_;
+  std::vector<double> path_weights_;
+  std::vector<double> depth_coefficients_; // stop (x lambda for non-graphical)
+  double shared_x_;
+  double shared_y_;
+  std::vector<double> depth_weights_;
+};
+
+} // namespace topiclm
+
+#endif /* _TOPICLM_SPARSE_TOPIC_SAMPLER_HPP_ */
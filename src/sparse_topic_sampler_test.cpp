@@ -0,0 +1,91 @@
+#include <vector>
+#include <cmath>
+#include "parameters.hpp"
+#include "document_manager.hpp"
+#include "topiclm.hpp"
+#include "context_tree_manager.hpp"
+#include "restaurant_manager.hpp"
+#include "sampler_context.hpp"
+#include "topic_sampler.hpp"
+#include "sparse_topic_sampler.hpp"
+#include "test_corpus.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace topiclm;
+using namespace std;
+
+namespace {
+
+const int kNumTopics = 6;
+const int kOrder = 3;
+const int kVocabulary = 15;
+const int kNumDraws = 20000;
+
+void CompareWithDenseSampler(TreeType tree_type) {
+  // a tree left by the sparse sampler itself
+  TestCorpus corpus(10, 5, kVocabulary);
+  auto model = corpus.Train(kNumTopics, kOrder, tree_type, true);
+  auto& trainer = model->sampler();
+  auto& parameters = trainer.parameters();
+  auto& dmanager = model->dmanager();
+  auto& cmanager = trainer.cmanager();
+  auto& words = dmanager.words();
+  SamplerContext context(5);
+  SamplerContext::Scope scope(context);
+  auto dense = GetTopicDepthSampler(tree_type, parameters, context);
+  SparseTopicDepthSampler sparse(parameters, tree_type, cmanager.rmanager(),
+                                 cmanager.lambda_path(), context);
+  sparse.BeginIteration();
+
+  for (int i = 0; i < dmanager.num_words(); i += 13) {
+    word_id_t word = i;
+    auto sent = dmanager.sentence(word);
+    int type = dmanager.token(word);
+    int token_idx = words.token_idx(word);
+    int depth = cmanager.WalkTreeNoCreate(sent, token_idx - 1, 0);
+    cmanager.CalcStopPriorPath(depth, token_idx);
+
+    cmanager.rmanager().CalcDepth2TopicPredictives(type, depth);
+    dense->InitWithTopicPrior(dmanager.doc2topic_count()[words.doc_id(word)],
+                              cmanager.lambda_path());
+    dense->TakeInStopPrior(cmanager.stop_prior_path());
+    dense->TakeInLikelihood(cmanager.rmanager().depth2topic_predictives());
+    auto pdf = dense->topic_depth_pdf();
+    double p_w = dense->CalcMarginal();
+
+    vector<int> counts(pdf.size(), 0);
+    for (int n = 0; n < kNumDraws; ++n) {
+      auto sample = sparse.Sample(dmanager, word, type, dmanager.topic(word),
+                                  cmanager.stop_prior_path(), depth);
+      ASSERT_NEAR(p_w, sample.p_w, 1e-12 * p_w) << "word " << word;
+      ASSERT_LE(sample.depth, depth);
+      ++counts[sample.depth * (kNumTopics + 1) + sample.topic];
+    }
+    // (topic, depth) and topic frequencies within 5 sigma of the dense posterior
+    vector<double> topic_probs(kNumTopics + 1, 0.0);
+    vector<int> topic_counts(kNumTopics + 1, 0);
+    for (size_t k = 0; k < pdf.size(); ++k) {
+      double p = pdf[k] / p_w;
+      EXPECT_NEAR(p, double(counts[k]) / kNumDraws, 5 * sqrt(p * (1 - p) / kNumDraws) + 1e-9)
+          << "word " << word << " depth " << k / (kNumTopics + 1) << " topic " << k % (kNumTopics + 1);
+      topic_probs[k % (kNumTopics + 1)] += p;
+      topic_counts[k % (kNumTopics + 1)] += counts[k];
+    }
+    for (int j = 0; j < kNumTopics + 1; ++j) {
+      double p = topic_probs[j];
+      EXPECT_NEAR(p, double(topic_counts[j]) / kNumDraws, 5 * sqrt(p * (1 - p) / kNumDraws) + 1e-9)
+          << "word " << word << " topic " << j;
+    }
+  }
+}
+
+} // namespace
+
+TEST(sparse_topic_sampler, same_as_dense_in_graphical_tree) {
+  CompareWithDenseSampler(kGraphical);
+}
+
+TEST(sparse_topic_sampler, same_as_dense_in_non_graphical_tree) {
+  CompareWithDenseSampler(kNonGraphical);
+}
@@ -12,13 +12,14 @@ using namespace std;
 namespace topiclm {
 
 unordered_map<int, int> CountDoc2MoveCustomers(
-    const vector<pair<size_t, vector<MovingNode> > >& moving_nodes) {
+    const vector<pair<size_t, vector<MovingNode> > >& moving_nodes,
+    const WordTable& words) {
   unordered_map<int, int> doc2move_customers;
   for (size_t j = 0; j < moving_nodes.size(); ++j) {
     if (size_t size = moving_nodes[j].first) {
       for (size_t l = 0; l < size; ++l) {
-        for (auto& word : moving_nodes[j].second[l].observeds) {
-          ++doc2move_customers[word->doc_id];
+        for (auto word : moving_nodes[j].second[l].observeds) {
+          ++doc2move_customers[words.doc_id(word)];
         }
       }
     }
@@ -143,25 +144,26 @@ void TableBasedSampler::ChangeTopics(const TableInfo& anchor,
                                      int type,
                                      topic_t k,
                                      topic_t sample) {
+  auto& words = dmanager_.words();
   for (size_t j = 0; j < moving_nodes_.size(); ++j) {
     if (size_t size = moving_nodes_[j].first) {
       for (size_t l = 0; l < size; ++l) {
         auto& mnode_jl = moving_nodes_[j].second[l];
-        for (auto& word : mnode_jl.observeds) {
-          dmanager_.DecrementTopicCount(word->doc_id, k, word->is_general);
+        for (auto word : mnode_jl.observeds) {
+          dmanager_.DecrementTopicCount(words.doc_id(word), k, words.is_general(word));
 
           // TODO: originally, this code is surrounded by if-state checking whether
           // ConsiderGeneral flag is on or not, but it seems unnecessary because 
           // this flag is only valid for cHPYTM: in DHPYTM, prob of sampling 0 is 0.
-          word->is_general = sample == 0;
+          words.set_is_general(word, sample == 0);
           
-          dmanager_.IncrementTopicCount(word->doc_id,
+          dmanager_.IncrementTopicCount(words.doc_id(word),
                                         sample,
                                         parameters_.topic_parameter().alpha[sample],
-                                        word->is_general);
-          dmanager_.set_topic(*word, sample);
-          word->node->restaurant().SeparateWordFromSection(k, type, word);
-          word->node->restaurant().CombineSectionToWord(sample, type, word);
+                                        words.is_general(word));
+          dmanager_.set_topic(word, sample);
+          words.node(word)->restaurant().SeparateWordFromSection(k, type, word);
+          words.node(word)->restaurant().CombineSectionToWord(sample, type, word);
         }
       }
     }
@@ -231,7 +233,7 @@ void TableBasedSampler::SampleAllTablesOnce() {
             continue;
           }
           
-          auto doc2move_customers = CountDoc2MoveCustomers(moving_nodes_);
+          auto doc2move_customers = CountDoc2MoveCustomers(moving_nodes_, dmanager_.words());
           floor_sampler_->TakeInPrior(k, doc2move_customers, dmanager_.doc2topic_count());
           
           RemoveFirstCustomerAndConsiderLambda(table_info, i, k, type);
@@ -275,9 +277,10 @@ GraphicalTableBasedSampler::GraphicalTableBasedSampler(
     const vector<Node*>& node_path,
     ContextTreeManager& ct_manager,
     LambdaManagerInterface& lmanager,
-    DocumentManager& dmanager)
+    DocumentManager& dmanager,
+    SamplerContext& context)
     : TableBasedSampler(parameters, node_path, ct_manager, lmanager, dmanager) {
-  floor_sampler_.reset(new FloorSampler(parameters.topic_parameter().num_topics, false));
+  floor_sampler_.reset(new FloorSampler(parameters.topic_parameter().num_topics, false, context));
   ResetCacheInFloorSampler();
 }
 
@@ -328,9 +331,10 @@ NonGraphicalTableBasedSampler::NonGraphicalTableBasedSampler(
     const vector<Node*>& node_path,
     ContextTreeManager& ct_manager,
     LambdaManagerInterface& lmanager,
-    DocumentManager& dmanager)
+    DocumentManager& dmanager,
+    SamplerContext& context)
     : TableBasedSampler(parameters, node_path, ct_manager, lmanager, dmanager) {
-  floor_sampler_.reset(new FloorSampler(parameters.topic_parameter().num_topics, true));
+  floor_sampler_.reset(new FloorSampler(parameters.topic_parameter().num_topics, true, context));
   ResetCacheInFloorSampler();
 }
 
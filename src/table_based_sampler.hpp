@@ -16,6 +16,7 @@ class Parameters;
 class LambdaManagerInterface;
 class Restaurant;
 class TableInfo;
+class SamplerContext;
 
 class TableBasedSampler {
  public:
@@ -78,7 +79,8 @@ class GraphicalTableBasedSampler : public TableBasedSampler {
                              const std::vector<Node*>& node_path,
                              ContextTreeManager& ct_manager,
                              LambdaManagerInterface& lmanager,
-                             DocumentManager& dmanager);
+                             DocumentManager& dmanager,
+                             SamplerContext& context);
  protected:
   virtual void ResetSectionTableSeq(Restaurant& r, int type);
   virtual void RemoveFirstCustomerAndConsiderLambda(
@@ -94,7 +96,8 @@ class NonGraphicalTableBasedSampler : public TableBasedSampler {
                                 const std::vector<Node*>& node_path,
                                 ContextTreeManager& ct_manager,
                                 LambdaManagerInterface& lmanager,
-                                DocumentManager& dmanager);
+                                DocumentManager& dmanager,
+                                SamplerContext& context);
  protected:
   virtual void ResetSectionTableSeq(Restaurant& r, int type);
   virtual void RemoveFirstCustomerAndConsiderLambda(
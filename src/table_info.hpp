@@ -2,17 +2,16 @@
 #define _TOPICLM_TABLE_INFO_HPP_
 
 #include "config.hpp"
+#include "word.hpp"
 
 namespace topiclm {
 
-class Word;
-
 struct TableInfo {
   topic_t floor;
   int customers;
   topic_t label;
   int obs_size;
-  std::vector<std::shared_ptr<Word> > observeds;
+  std::vector<word_id_t> observeds;
 
   // TableInfo(topic_t floor, int customers, topic_t label)
   //     : floor(floor), customers(customers), label(label) {}
@@ -0,0 +1,91 @@
+#ifndef _TOPICLM_TEST_CORPUS_HPP_
+#define _TOPICLM_TEST_CORPUS_HPP_
+
+#include <string>
+#include <random>
+#include <memory>
+#include <fstream>
+#include <cstdlib>
+#include <unistd.h>
+#include "random_util.hpp"
+#include "topiclm_model.hpp"
+
+namespace topiclm {
+
+/**
+ * Small synthetic corpus for the tests, where each document prefers a part
+ * of the vocabulary (words "w0", "w1", ...). It is written to a temporary
+ * directory, removed with this object once the files of the test in it are.
+ */
+class TestCorpus {
+ public:
+  TestCorpus(int num_docs, int num_sentences, int vocabulary) {
+    char dir[] = "/tmp/topiclm_testXXXXXX";
+    if (mkdtemp(dir) == nullptr) {
+      throw std::string("cannot create a temporary directory");
+    }
+    dir_ = dir;
+    std::mt19937 random(11);
+    std::ofstream ofs(train_fn());
+    for (int d = 0; d < num_docs; ++d) {
+      for (int s = 0; s < num_sentences; ++s) {
+        int length = 3 + random() % 8;
+        for (int i = 0; i < length; ++i) {
+          int w = (random() % 3 == 0) ? random() % vocabulary : (d * 3 + random() % 4) % vocabulary;
+          ofs << (i > 0 ? " " : "") << "w" << w;
+        }
+        ofs << "\n";
+      }
+      ofs << "\n";
+    }
+  }
+  ~TestCorpus() {
+    unlink(train_fn().c_str());
+    rmdir(dir_.c_str());
+  }
+  TestCorpus(const TestCorpus&) = delete;
+  TestCorpus& operator=(const TestCorpus&) = delete;
+
+  const std::string& dir() const { return dir_; }
+  std::string train_fn() const { return dir_ + "/train.txt"; }
+
+  /**
+   * A model with hierarchical lambdas trained for num_iterations on the
+   * corpus, with the same seed every time.
+   */
+  std::unique_ptr<HpyLdaModel<HpyLdaSampler> > Train(int num_topics,
+                                                     int ngram_order,
+                                                     TreeType tree_type,
+                                                     bool sparse_sampler = false,
+                                                     int num_iterations = 3) const {
+    init_rnd(7);
+    ReadConfig config;
+    config.unk_converter_type = kNormal;
+    config.unk_handler_type = kNone;
+    config.unprocess_with_stream = 0;
+    config.unk_threshold = 1;
+    config.unk_type = "__unk__";
+    std::unique_ptr<HpyLdaModel<HpyLdaSampler> > model(new HpyLdaModel<HpyLdaSampler>(
+        1, 1, 10.0, 1.0, 0.0, 0.5, 0.1, 1.0, 10.0,
+        num_topics, ngram_order, kHierarchical, tree_type, config));
+    model->ReadTrainFile(train_fn());
+    model->SetSampler();
+    model->SetAlphaSampler(HyperSamplerType(1));
+    model->SetHpySampler(HyperSamplerType(0));
+    auto& sampler = model->sampler();
+    sampler.set_table_based_sampler(-1, -1, true);
+    sampler.set_sparse_sampler(sparse_sampler);
+    sampler.InitializeInRandom(ngram_order - 1, true, 0.0);
+    for (int i = 1; i <= num_iterations; ++i) {
+      sampler.RunOneIteration(i, true);
+    }
+    return model;
+  }
+
+ private:
+  std::string dir_;
+};
+
+} // topiclm
+
+#endif /* _TOPICLM_TEST_CORPUS_HPP_ */
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include "test_predictive_cache.hpp"
+
+using namespace std;
+
+namespace topiclm {
+
+TestPredictiveCache::TestPredictiveCache(size_t max_bytes, int num_shards)
+    : max_bytes_(max_bytes),
+      shard_max_bytes_(max_bytes / max(num_shards, 1)) {
+  for (int i = 0; i < max(num_shards, 1); ++i) {
+    shards_.emplace_back(new Shard());
+  }
+}
+
+TestPredictiveCache::~TestPredictiveCache() {}
+
+bool TestPredictiveCache::Find(int node,
+                               int type,
+                               int word_depth,
+                               vector<double>& stop_prior_path,
+                               vector<double>& lambda_path,
+                               vector<vector<double> >& depth2topic_predictives) {
+  uint64_t key = Key(node, type);
+  auto& shard = GetShard(key);
+  lock_guard<mutex> lock(shard.mutex);
+  auto it = shard.index.find(key);
+  if (it == shard.index.end()) {
+    ++shard.misses;
+    return false;
+  }
+  ++shard.hits;
+  shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+
+  auto value = it->second->values.begin();
+  copy(value, value + stop_prior_path.size(), stop_prior_path.begin());
+  value += stop_prior_path.size();
+  copy(value, value + lambda_path.size(), lambda_path.begin());
+  value += lambda_path.size();
+  for (size_t i = 0; i < depth2topic_predictives.size(); ++i) {
+    auto& predictives = depth2topic_predictives[i];
+    if (int(i) <= word_depth) {
+      copy(value, value + predictives.size(), predictives.begin());
+      value += predictives.size();
+    } else {
+      fill(predictives.begin(), predictives.end(), 0.0);
+    }
+  }
+  return true;
+}
+
+void TestPredictiveCache::Insert(int node,
+                                 int type,
+                                 int word_depth,
+                                 const vector<double>& stop_prior_path,
+                                 const vector<double>& lambda_path,
+                                 const vector<vector<double> >& depth2topic_predictives) {
+  uint64_t key = Key(node, type);
+  Entry entry;
+  entry.key = key;
+  size_t num_values = stop_prior_path.size() + lambda_path.size();
+  for (int i = 0; i <= word_depth; ++i) {
+    num_values += depth2topic_predictives[i].size();
+  }
+  entry.values.reserve(num_values);
+  entry.values.insert(entry.values.end(), stop_prior_path.begin(), stop_prior_path.end());
+  entry.values.insert(entry.values.end(), lambda_path.begin(), lambda_path.end());
+  for (int i = 0; i <= word_depth; ++i) {
+    entry.values.insert(entry.values.end(),
+                        depth2topic_predictives[i].begin(), depth2topic_predictives[i].end());
+  }
+  size_t bytes = EntryBytes(entry);
+  if (bytes > shard_max_bytes_) return;
+
+  auto& shard = GetShard(key);
+  lock_guard<mutex> lock(shard.mutex);
+  if (shard.index.count(key)) return; // by another thread meanwhile
+  while (shard.bytes + bytes > shard_max_bytes_) {
+    auto& last = shard.lru.back();
+    shard.bytes -= EntryBytes(last);
+    shard.index.erase(last.key);
+    shard.lru.pop_back();
+    ++shard.evictions;
+  }
+  shard.lru.push_front(std::move(entry));
+  shard.index[key] = shard.lru.begin();
+  shard.bytes += bytes;
+}
+
+void TestPredictiveCache::Clear() {
+  for (auto& shard : shards_) {
+    lock_guard<mutex> lock(shard->mutex);
+    shard->lru.clear();
+    shard->index.clear();
+    shard->bytes = 0;
+  }
+}
+
+TestPredictiveCache::Stats TestPredictiveCache::stats() const {
+  Stats stats;
+  for (auto& shard : shards_) {
+    lock_guard<mutex> lock(shard->mutex);
+    stats.hits += shard->hits;
+    stats.misses += shard->misses;
+    stats.evictions += shard->evictions;
+    stats.entries += shard->index.size();
+    stats.bytes += shard->bytes
+        + shard->index.bucket_count() * sizeof(void*);
+  }
+  return stats;
+}
+
+} // topiclm
@@ -0,0 +1,98 @@
+#ifndef _TOPICLM_TEST_PREDICTIVE_CACHE_HPP_
+#define _TOPICLM_TEST_PREDICTIVE_CACHE_HPP_
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+namespace topiclm {
+
+/**
+ * Test-mode predictives of (deepest node, type) on a FrozenModel: the stop
+ * prior path, the lambda path and the depth x topic predictives, which only
+ * depend on the path to the node and the type as long as the model is
+ * frozen.
+ *
+ * Entries are split among shards by their key, each with its own mutex and
+ * LRU list, so predictors on different threads may share one cache. A shard
+ * drops its least recently used entries above max_bytes / num_shards bytes
+ * of entries (the hash buckets are only counted in stats).
+ */
+class TestPredictiveCache {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0; // approximate, including the index
+    double hit_rate() const {
+      return hits + misses > 0 ? double(hits) / (hits + misses) : 0.0;
+    }
+  };
+
+  TestPredictiveCache(size_t max_bytes, int num_shards);
+  ~TestPredictiveCache();
+
+  /**
+   * Copy the entry of (node, type) at word_depth into the buffers (rows
+   * deeper than word_depth are zero) if any; counts a hit or a miss.
+   */
+  bool Find(int node,
+            int type,
+            int word_depth,
+            std::vector<double>& stop_prior_path,
+            std::vector<double>& lambda_path,
+            std::vector<std::vector<double> >& depth2topic_predictives);
+  void Insert(int node,
+              int type,
+              int word_depth,
+              const std::vector<double>& stop_prior_path,
+              const std::vector<double>& lambda_path,
+              const std::vector<std::vector<double> >& depth2topic_predictives);
+  void Clear();
+
+  Stats stats() const;
+  size_t max_bytes() const { return max_bytes_; }
+  int num_shards() const { return shards_.size(); }
+
+ private:
+  struct Entry {
+    uint64_t key;
+    // stop prior path, lambda path, then the rows up to the word depth
+    std::vector<double> values;
+  };
+  struct Shard {
+    std::mutex mutex;
+    std::list<Entry> lru; // most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    size_t bytes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+  };
+
+  static uint64_t Key(int node, int type) {
+    return (uint64_t(uint32_t(node)) << 32) | uint32_t(type);
+  }
+  Shard& GetShard(uint64_t key) {
+    // the low bits of node ids and types are the busiest
+    return *shards_[((key * 0x9E3779B97F4A7C15ULL) >> 32) % shards_.size()];
+  }
+  static size_t EntryBytes(const Entry& entry) {
+    return sizeof(Entry) + entry.values.capacity() * sizeof(double)
+        + 4 * sizeof(void*) + sizeof(uint64_t); // list and index nodes
+  }
+
+  const size_t max_bytes_;
+  const size_t shard_max_bytes_;
+  std::vector<std::unique_ptr<Shard> > shards_;
+};
+
+} // topiclm
+
+#endif /* _TOPICLM_TEST_PREDICTIVE_CACHE_HPP_ */
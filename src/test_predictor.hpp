@@ -0,0 +1,31 @@
+#ifndef _TOPICLM_TEST_PREDICTOR_HPP_
+#define _TOPICLM_TEST_PREDICTOR_HPP_
+
+#include <vector>
+#include "span.hpp"
+
+namespace topiclm {
+
+/**
+ * Test-mode predictive computation for ParticleFilterSampler. Implemented by
+ * ContextTreeManager on the training tree and by FrozenPredictor on a
+ * compiled FrozenModel.
+ */
+class TestPredictor {
+ public:
+  virtual ~TestPredictor() {}
+  /**
+   * Walk the context preceding sent[idx] and compute the stop prior path,
+   * the lambda path and the predictives of type sent[idx] on each depth
+   * (rows deeper than the word depth are zero). Returns the word depth.
+   */
+  virtual int CalcTestPredictives(Span<int> sent, int idx) = 0;
+
+  virtual const std::vector<std::vector<double> >& depth2topic_predictives() const = 0;
+  virtual const std::vector<double>& stop_prior_path() const = 0;
+  virtual const std::vector<double>& lambda_path() const = 0;
+};
+
+} // topiclm
+
+#endif /* _TOPICLM_TEST_PREDICTOR_HPP_ */
@@ -2,9 +2,11 @@
 #define _TOPICLM_TOPIC_SAMPLER_HPP_
 
 #include <vector>
+#include <memory>
 #include <algorithm>
-#include "random_util.hpp"
+#include "sampler_context.hpp"
 #include "parameters.hpp"
+#include "config.hpp"
 
 namespace topiclm {
 
@@ -36,12 +38,13 @@ class TopicDepthSamplerInterface {
 // used for dhpytm
 class TopicDepthSampler : public TopicDepthSamplerInterface {
  public:
-  TopicDepthSampler(const Parameters& parameters)
+  TopicDepthSampler(const Parameters& parameters, SamplerContext& context)
       : topic_depth_pdf_(
           (parameters.topic_parameter().num_topics + 1) * parameters.ngram_order()),
         ngram_order_(parameters.ngram_order()),
         num_topics_(parameters.topic_parameter().num_topics),
-        topic_parameter_(parameters.topic_parameter()) {}
+        topic_parameter_(parameters.topic_parameter()),
+        context_(context) {}
   virtual ~TopicDepthSampler() {}
   
   virtual void InitWithTopicPrior(const std::pair<int, std::vector<int> >& topic_count,
@@ -82,12 +85,12 @@ class TopicDepthSampler : public TopicDepthSamplerInterface {
   }
   virtual SampleInfo Sample() {
     double p_w = std::accumulate(topic_depth_pdf_.begin(), topic_depth_pdf_.end(), 0.0);
-    int sample = random->SampleUnnormalizedPdfRef(topic_depth_pdf_);
+    int sample = context_.random().SampleUnnormalizedPdfRef(topic_depth_pdf_);
     
     return {false, sample / (num_topics_ + 1), sample % (num_topics_ + 1), p_w};
   }
   virtual int SampleAtRandom(double) const {
-    return random->SampleUnnormalizedPdf(topic_parameter_.alpha);
+    return context_.random().SampleUnnormalizedPdf(topic_parameter_.alpha);
   }
 
   virtual const std::vector<double>& topic_depth_pdf() const { return topic_depth_pdf_; }
@@ -102,13 +105,14 @@ class TopicDepthSampler : public TopicDepthSamplerInterface {
   const int ngram_order_;
   const int num_topics_;
   const DirichletParameter& topic_parameter_;
+  SamplerContext& context_;
 };
 
 // used for chpytm
 class NonGraphicalTopicDepthSampler : public TopicDepthSampler {
  public:
-  NonGraphicalTopicDepthSampler(const Parameters& parameters)
-      : TopicDepthSampler(parameters) {}
+  NonGraphicalTopicDepthSampler(const Parameters& parameters, SamplerContext& context)
+      : TopicDepthSampler(parameters, context) {}
   virtual ~NonGraphicalTopicDepthSampler() {}
   virtual void InitWithTopicPrior(const std::pair<int, std::vector<int> >& topic_count,
                                   const std::vector<double>& lambda_path,
@@ -137,27 +141,37 @@ class NonGraphicalTopicDepthSampler : public TopicDepthSampler {
   }
   virtual int SampleAtRandom(double p_global) const {
     if (p_global == 0) {
-      //return random->NextMult(topic_parameter_.num_topics) + 1;
-      return random->NextMult(topic_parameter_.num_topics + 1);
+      //return context_.random().NextMult(topic_parameter_.num_topics) + 1;
+      return context_.random().NextMult(topic_parameter_.num_topics + 1);
     } else {
-      if (random->NextDouble() < p_global) {
+      if (context_.random().NextDouble() < p_global) {
         return 0;
       } else {
-        return random->NextMult(topic_parameter_.num_topics) + 1;
+        return context_.random().NextMult(topic_parameter_.num_topics) + 1;
       }
     }
   }
 };
 
+inline std::unique_ptr<TopicDepthSampler> GetTopicDepthSampler(TreeType tree_type,
+                                                               const Parameters& parameters,
+                                                               SamplerContext& context) {
+  auto p = tree_type == kGraphical ?
+      std::unique_ptr<TopicDepthSampler>(new TopicDepthSampler(parameters, context)) :
+      std::unique_ptr<TopicDepthSampler>(new NonGraphicalTopicDepthSampler(parameters, context));
+  return p;
+}
+
 // may be no use ?
 class CachedTopicDepthSampler : public TopicDepthSamplerInterface {
  public:
-  CachedTopicDepthSampler(const Parameters& parameters)
+  CachedTopicDepthSampler(const Parameters& parameters, SamplerContext& context)
       : topic_depth_pdf_(
           (parameters.topic_parameter().num_topics + 2) * parameters.ngram_order()),
         ngram_order_(parameters.ngram_order()),
         num_topics_(parameters.topic_parameter().num_topics),
-        topic_parameter_(parameters.topic_parameter()) {}
+        topic_parameter_(parameters.topic_parameter()),
+        context_(context) {}
 
 
   virtual void InitWithTopicPrior(const std::pair<int, std::vector<int> >& topic_count,
@@ -209,12 +223,12 @@ class CachedTopicDepthSampler : public TopicDepthSamplerInterface {
     // std::cerr << std::endl;
 
     double p_w = std::accumulate(topic_depth_pdf_.begin(), topic_depth_pdf_.end(), 0.0);
-    int sample = random->SampleUnnormalizedPdfRef(topic_depth_pdf_);
+    int sample = context_.random().SampleUnnormalizedPdfRef(topic_depth_pdf_);
     bool cache = sample > 0 && (sample % (num_topics_ + 2) == num_topics_ + 1);
     return {cache, sample / (num_topics_ + 2), sample % (num_topics_ + 2), p_w};
   }
   virtual int SampleAtRandom(double) const {
-    return random->SampleUnnormalizedPdf(topic_parameter_.alpha);
+    return context_.random().SampleUnnormalizedPdf(topic_parameter_.alpha);
   }
 
   const std::vector<double>& topic_depth_pdf() const { return topic_depth_pdf_; }
@@ -224,14 +238,16 @@ class CachedTopicDepthSampler : public TopicDepthSamplerInterface {
   const int ngram_order_;
   const int num_topics_;
   const DirichletParameter& topic_parameter_;
+  SamplerContext& context_;
 };
 
 // used for unigram rescaling
 class TopicSampler {
  public:
-  TopicSampler(const Parameters& parameters)
+  TopicSampler(const Parameters& parameters, SamplerContext& context)
       : topic_pdf_(parameters.topic_parameter().num_topics + 1),
-        topic_parameter_(parameters.topic_parameter()) {}
+        topic_parameter_(parameters.topic_parameter()),
+        context_(context) {}
   void InitWithTopicPrior(const std::pair<int, std::vector<int> >& topic_count) {
     for (size_t j = 0; j < topic_pdf_.size(); ++j) {
       topic_pdf_[j] = (topic_count.second[j] + topic_parameter_.alpha[j])
@@ -245,20 +261,21 @@ class TopicSampler {
   }
   SampleInfo Sample() {
     double p_w = CalcMarginal();
-    int sample = random->SampleUnnormalizedPdfRef(topic_pdf_);
+    int sample = context_.random().SampleUnnormalizedPdfRef(topic_pdf_);
     return {false, 0, sample, p_w};
   }
   double CalcMarginal() const {
     return std::accumulate(topic_pdf_.begin(), topic_pdf_.end(), 0.0);
   }
   int SampleAtRandom() const {
-    return random->SampleUnnormalizedPdf(topic_parameter_.alpha);
+    return context_.random().SampleUnnormalizedPdf(topic_parameter_.alpha);
   }
   const std::vector<double>& topic_pdf() { return topic_pdf_; }
   
  private:
   std::vector<double> topic_pdf_;
   const DirichletParameter& topic_parameter_;
+  SamplerContext& context_;
 };
 
 }
@@ -1,36 +1,42 @@
 #include <iomanip>
 #include <iostream>
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+#include <pficommon/system/time_util.h>
 #include "util.hpp"
 #include "random_util.hpp"
 #include "topiclm.hpp"
 #include "document_manager.hpp"
 #include "parameters.hpp"
 #include "topic_sampler.hpp"
+#include "mh_topic_sampler.hpp"
+#include "sparse_topic_sampler.hpp"
 #include "log.hpp"
 #include "sampling_configuration.hpp"
 #include "lambda_manager.hpp"
 #include "restaurant_manager.hpp"
 #include "table_based_sampler.hpp"
+#include "sampling_worker.hpp"
 
 using namespace std;
+using namespace pfi::system::time;
 
 namespace topiclm {
 
-unique_ptr<TopicDepthSampler> GetTopicDepthSampler(TreeType tree_type,
-                                                   const Parameters& parameters) {
-  auto p = tree_type == kGraphical ?
-      unique_ptr<TopicDepthSampler>(new TopicDepthSampler(parameters)) :
-      unique_ptr<TopicDepthSampler>(new NonGraphicalTopicDepthSampler(parameters));
-  return p;
-}
-
 HpyLdaSampler::HpyLdaSampler(LambdaType lambda_type, TreeType tree_type, DocumentManager& dmanager, Parameters& parameters)
     : dmanager_(dmanager),
       parameters_(parameters),
-      cmanager_(lambda_type, tree_type, parameters, dmanager.lexicon(), dmanager.eos_id()),
-      topic_sampler_(GetTopicDepthSampler(tree_type, parameters)),
+      cmanager_(lambda_type, tree_type, parameters, dmanager.lexicon(), dmanager.eos_id(), context_),
+      topic_sampler_(GetTopicDepthSampler(tree_type, parameters, context_)),
       lambda_type_(lambda_type),
-      tree_type_(tree_type) {
+      tree_type_(tree_type),
+      num_threads_(1),
+      sync_interval_(0),
+      num_pf_samplers_(0) {
+  if (parameters.ngram_order() > WordTable::kMaxDepth + 1) {
+    throw string("ngram order must be at most 256");
+  }
   int num_words = dmanager_.num_words();
   sampling_idxs_.clear();
   for (int i = 0; i < num_words; ++i) {
@@ -42,80 +48,156 @@ HpyLdaSampler::~HpyLdaSampler() {}
 
 void HpyLdaSampler::InitializeInRandom(int init_depth, bool hpy_random, double p_global) {
   assert(sampling_idxs_.size() > 0);
+  SamplerContext::Scope scope(context_);
   cerr << "initializting..." << endl;
   random_shuffle(sampling_idxs_.begin(), sampling_idxs_.end(), *random);
+  auto& words = dmanager_.words();
+  // the words are walked in order, so the path of a word is advanced from
+  // the deepest existing path of the previous one
+  const int* prev_sent = nullptr;
+  int prev_token_idx = -1;
+  int prev_depth = 0;
   for (size_t j = 0; j < sampling_idxs_.size(); ++j) {
-    auto& word = dmanager_.word(j);
-    auto& sent = dmanager_.sentence(*word);
-    int type = dmanager_.token(*word);
+    word_id_t word = j;
+    auto sent = dmanager_.sentence(word);
+    int type = dmanager_.token(word);
+    int token_idx = words.token_idx(word);
 
+    int depth = init_depth;
     if (init_depth == 0) {
-      word->depth = random->NextMult(parameters_.ngram_order());
-    } else {
-      word->depth = init_depth;
+      depth = random->NextMult(parameters_.ngram_order());
     }
 
-    word->depth = cmanager_.WalkTree(sent, word->token_idx - 1, 0, word->depth);
-    cmanager_.rmanager().AddStopPassedCustomers(word->depth);
+    int existing_depth = (sent.begin() == prev_sent && token_idx == prev_token_idx + 1)
+        ? cmanager_.AdvanceNoCreate(sent, token_idx - 1, prev_depth)
+        : cmanager_.WalkTreeNoCreate(sent, token_idx - 1, 0);
+    if (depth > existing_depth) {
+      depth = cmanager_.WalkTree(sent, token_idx - 1 - existing_depth, existing_depth, depth);
+    }
+    prev_sent = sent.begin();
+    prev_token_idx = token_idx;
+    prev_depth = max(existing_depth, depth);
+    words.set_depth(word, depth);
+    cmanager_.rmanager().AddStopPassedCustomers(depth);
 
     auto& node_path = cmanager_.current_node_path();
-    for (int d = 0; d < word->depth; ++d) {
+    for (int d = 0; d < depth; ++d) {
       node_path[d]->add_type2child(type, node_path[d+1]);
     }
-    word->node = cmanager_.current_node_path()[word->depth];
+    words.set_node(word, cmanager_.current_node_path()[depth]);
     
     int sampled_topic = topic_sampler_->SampleAtRandom(p_global);
     if (ConsiderGeneral()) {
-      word->is_general = sampled_topic == 0;
+      words.set_is_general(word, sampled_topic == 0);
     }
-    dmanager_.IncrementTopicCount(word->doc_id,
+    dmanager_.IncrementTopicCount(words.doc_id(word),
                                   sampled_topic,
                                   parameters_.topic_parameter().alpha[sampled_topic],
-                                  word->is_general);
-    dmanager_.set_topic(*word, sampled_topic);
+                                  words.is_general(word));
+    dmanager_.set_topic(word, sampled_topic);
 
     if (hpy_random) {
-      cmanager_.rmanager().AddCustomerToPathAtRandom(type, sampled_topic, word->depth);
+      cmanager_.rmanager().AddCustomerToPathAtRandom(type, sampled_topic, depth);
     } else {
-      cmanager_.rmanager().CalcDepth2TopicPredictives(type, word->depth);
-      cmanager_.rmanager().AddObservedCustomerToPath(type, sampled_topic, word->depth);
+      cmanager_.rmanager().CalcDepth2TopicPredictives(type, depth);
+      cmanager_.rmanager().AddObservedCustomerToPath(type, sampled_topic, depth);
     }
-    cmanager_.rmanager().CombineSectionToWord(type, sampled_topic, word->depth, word);
+    cmanager_.rmanager().CombineSectionToWord(type, sampled_topic, depth, word);
   }
   LOG("lambda") << "iteration: 0 \n"
                 << cmanager_.PrintDepth2Tables() << endl;
 }
 
 double HpyLdaSampler::RunOneIteration(int iteration_i, bool table_sample) {
+  SamplerContext::Scope scope(context_);
+  double begin = get_clock_time();
+  double ll = 0;
+  if (!subtree_workers_.empty() && iteration_i > 0) {
+    ll = SampleWordsInSubtrees();
+  } else if (!workers_.empty() && iteration_i > 0) {
+    ll = SampleWordsInParallel();
+  } else {
+    ll = SampleWordsSerially(iteration_i);
+  }
+  double sampling_time = get_clock_time() - begin;
+  
+  auto& depth2nodes = cmanager_.GetDepth2Nodes();
+  parameters_.SamplingHpyParameter(depth2nodes);
+  parameters_.SamplingAlpha(dmanager_.doc2topic_count(),
+                            dmanager_.doc2topic2tables());
+  if (iteration_i > 5) {
+    parameters_.SamplingLambdaConcentration(depth2nodes);
+  }
+  if (iteration_i % 10 == 0) {
+    LOG("hyper") << "iteration: " << iteration_i << "\n"
+                 << parameters_.OutputHypers() << endl;
+    LOG("lambda") << "iteration: " << iteration_i << "\n"
+                  << cmanager_.PrintDepth2Tables() << endl;
+    cmanager_.tsampler().ResetCacheInFloorSampler();
+  }
+  if (table_sample) {
+    cmanager_.TableBasedResample();
+  }
+  auto& ct = cmanager_.ct();
+  ct.ReclaimRetiredNodes();
+  auto& pool_stats = ct.node_pool_stats();
+  LOG("tree") << "[" << setw(2) << (iteration_i + 1) << "]"
+              << " live_nodes=" << ct.num_live_nodes()
+              << " created=" << pool_stats.created
+              << " reused=" << pool_stats.reused
+              << " reclaimed=" << pool_stats.reclaimed
+              << " slabs=" << pool_stats.slabs << endl;
+
+  double ppl = std::exp(-ll / sampling_idxs_.size());
+  cerr << "[" << setw(2) << (iteration_i + 1) << "] sampling ...\t" << setw(6)
+       << sampling_idxs_.size() << "/" << sampling_idxs_.size()
+       << "\tperplexity=" << ppl << "\r";
+      //<< "\ttopicLL=" << logjoint() << "\r";
+  ll = logjoint();
+  LOG("info") << "[" << setw(2) << (iteration_i + 1)
+              << "] perplexity=" << ppl
+              << " log-likelihood=" << ll
+              << " tokens/sec=" << sampling_idxs_.size() / sampling_time << endl;
+  return ll;
+}
+
+double HpyLdaSampler::SampleWordsSerially(int iteration_i) {
   random_shuffle(sampling_idxs_.begin(), sampling_idxs_.end(), *random);
+  auto& words = dmanager_.words();
   double ll = 0;
+  bool mh = mh_sampler_ && iteration_i > 0;
+  bool sparse = !mh && sparse_sampler_;
+  if (mh) mh_sampler_->BeginIteration(dmanager_);
+  if (sparse) sparse_sampler_->BeginIteration();
   for (size_t j = 0; j < sampling_idxs_.size(); ++j) {
     if (j % 1000 == 0) {
       cerr << "[" << setw(2) << (iteration_i + 1) << "] sampling ...\t" << setw(6)
            << (j + 1) << "/" << sampling_idxs_.size() << "\r";
     }
-    auto& word = dmanager_.word(j);
-    auto& sent = dmanager_.sentence(*word);
-    int type = dmanager_.token(*word);
-    int topic = dmanager_.topic(*word);
-    int current_max_depth = word->depth;
+    word_id_t word = j;
+    auto sent = dmanager_.sentence(word);
+    int type = dmanager_.token(word);
+    int topic = dmanager_.topic(word);
+    int depth = words.depth(word);
+    int token_idx = words.token_idx(word);
+    int current_max_depth = depth;
     if (iteration_i > 0) {
-      cmanager_.UpTreeFromLeaf(word->node, word->depth);
-      cmanager_.rmanager().RemoveStopPassedCustomers(word->depth);
+      cmanager_.UpTreeFromLeaf(words.node(word), depth);
+      cmanager_.rmanager().RemoveStopPassedCustomers(depth);
       current_max_depth
-          = cmanager_.WalkTreeNoCreate(sent, word->token_idx - 1 - word->depth, word->depth);
-      cmanager_.rmanager().SeparateWordFromSection(type, topic, word->depth, word);
-      cmanager_.rmanager().RemoveObservedCustomerFromPath(type, topic, word->depth);
-      dmanager_.DecrementTopicCount(word->doc_id, topic, word->is_general);
+          = cmanager_.WalkTreeNoCreate(sent, token_idx - 1 - depth, depth);
+      cmanager_.rmanager().SeparateWordFromSection(type, topic, depth, word);
+      cmanager_.rmanager().RemoveObservedCustomerFromPath(type, topic, depth);
+      dmanager_.DecrementTopicCount(words.doc_id(word), topic, words.is_general(word));
     } else {
-      current_max_depth = cmanager_.WalkTreeNoCreate(sent, word->token_idx - 1, 0);
+      current_max_depth = cmanager_.WalkTreeNoCreate(sent, token_idx - 1, 0);
     }
-    cmanager_.CalcStopPriorPath(current_max_depth, word->token_idx);
+    cmanager_.CalcStopPriorPath(current_max_depth, token_idx);
     // if (j == 1000) {
     //   double p_sum = 0;
     //   for (int i = 0; i < dmanager_.lexicon(); ++i) {
     //     cmanager_.rmanager().CalcDepth2TopicPredictives(i, current_max_depth);
-    //     topic_sampler_->InitWithTopicPrior(dmanager_.doc2topic_count()[word->doc_id],
+    //     topic_sampler_->InitWithTopicPrior(dmanager_.doc2topic_count()[words.doc_id(word)],
     //                                        cmanager_.lambda_path());
     //     topic_sampler_->TakeInStopPrior(cmanager_.stop_prior_path());
     //     topic_sampler_->TakeInLikelihood(cmanager_.rmanager().depth2topic_predictives());
@@ -123,84 +205,277 @@ double HpyLdaSampler::RunOneIteration(int iteration_i, bool table_sample) {
     //   }
     //   cerr << "\n p_sum = " << p_sum << endl;
     // }
-    cmanager_.rmanager().CalcDepth2TopicPredictives(type, current_max_depth);
+    SampleInfo sample;
+    if (mh) {
+      sample = mh_sampler_->Sample(dmanager_, word, type, topic,
+                                   cmanager_.stop_prior_path(), current_max_depth);
+    } else if (sparse) {
+      sample = sparse_sampler_->Sample(dmanager_, word, type, topic,
+                                       cmanager_.stop_prior_path(), current_max_depth);
+    } else {
+      cmanager_.rmanager().CalcDepth2TopicPredictives(type, current_max_depth);
 
-    topic_sampler_->InitWithTopicPrior(dmanager_.doc2topic_count()[word->doc_id],
-                                       cmanager_.lambda_path());
-    topic_sampler_->TakeInStopPrior(cmanager_.stop_prior_path());
-    topic_sampler_->TakeInLikelihood(cmanager_.rmanager().depth2topic_predictives());
-    auto sample = topic_sampler_->Sample();
+      topic_sampler_->InitWithTopicPrior(dmanager_.doc2topic_count()[words.doc_id(word)],
+                                         cmanager_.lambda_path());
+      topic_sampler_->TakeInStopPrior(cmanager_.stop_prior_path());
+      topic_sampler_->TakeInLikelihood(cmanager_.rmanager().depth2topic_predictives());
+      sample = topic_sampler_->Sample();
+    }
 
     ll += std::log(sample.p_w);
 
     if (ConsiderGeneral()) {
-      word->is_general = sample.topic == 0;
+      words.set_is_general(word, sample.topic == 0);
     }
 
-    dmanager_.IncrementTopicCount(word->doc_id,
+    dmanager_.IncrementTopicCount(words.doc_id(word),
                                   sample.topic,
                                   parameters_.topic_parameter().alpha[sample.topic],
-                                  word->is_general);
-    dmanager_.set_topic(*word, sample.topic);
+                                  words.is_general(word));
+    dmanager_.set_topic(word, sample.topic);
 
     if (sample.depth > current_max_depth) { // sample deep node
-      cmanager_.WalkTree(sent, word->token_idx - 1 - current_max_depth, current_max_depth, sample.depth);
+      cmanager_.WalkTree(sent, token_idx - 1 - current_max_depth, current_max_depth, sample.depth);
     } else if (sample.depth < current_max_depth) {
       cmanager_.EraseEmptyNodes(current_max_depth, sample.depth);
     }
-    word->depth = sample.depth;
+    words.set_depth(word, sample.depth);
 
     // TODO separate this logic to other methods
-    if (word->node != cmanager_.current_node_path()[sample.depth]) {
+    if (words.node(word) != cmanager_.current_node_path()[sample.depth]) {
       auto& node_path = cmanager_.current_node_path();
       for (int d = 0; d < sample.depth; ++d) {
         node_path[d]->add_type2child(type, node_path[d+1]);
       }
     }
-    word->node = cmanager_.current_node_path()[sample.depth];
+    words.set_node(word, cmanager_.current_node_path()[sample.depth]);
     
-    cmanager_.rmanager().CombineSectionToWord(type, sample.topic, word->depth, word);
+    cmanager_.rmanager().CombineSectionToWord(type, sample.topic, sample.depth, word);
     
-    cmanager_.rmanager().AddStopPassedCustomers(word->depth);
-    cmanager_.rmanager().AddObservedCustomerToPath(type, sample.topic, word->depth);
+    cmanager_.rmanager().AddStopPassedCustomers(sample.depth);
+    cmanager_.rmanager().AddObservedCustomerToPath(type, sample.topic, sample.depth);
   }
-  auto& depth2nodes = cmanager_.GetDepth2Nodes();
-  parameters_.SamplingHpyParameter(depth2nodes);
-  parameters_.SamplingAlpha(dmanager_.doc2topic_count(),
-                            dmanager_.doc2topic2tables());
-  if (iteration_i > 5) {
-    parameters_.SamplingLambdaConcentration(depth2nodes);
+  return ll;
+}
+
+double HpyLdaSampler::SampleWordsInParallel() {
+  size_t num_workers = workers_.size();
+  for (auto& word_idxs : worker2word_idxs_) {
+    random_shuffle(word_idxs.begin(), word_idxs.end(), *random);
   }
-  if (iteration_i % 10 == 0) {
-    LOG("hyper") << "iteration: " << iteration_i << "\n"
-                 << parameters_.OutputHypers() << endl;
-    LOG("lambda") << "iteration: " << iteration_i << "\n"
-                  << cmanager_.PrintDepth2Tables() << endl;
-    cmanager_.tsampler().ResetCacheInFloorSampler();
+  vector<double> worker2ll(num_workers, 0);
+  size_t num_done = 0;
+  for (size_t begin = 0; ; begin += sync_interval_) {
+    bool remaining = false;
+    for (size_t w = 0; w < num_workers; ++w) {
+      auto& word_idxs = worker2word_idxs_[w];
+      size_t end = min(word_idxs.size(), begin + sync_interval_);
+      for (size_t j = begin; j < end; ++j) {
+        DetachWord(word_idxs[j]);
+      }
+      remaining |= begin < end;
+    }
+    if (!remaining) break;
+    
+    for (size_t w = 0; w < num_workers; ++w) {
+      workers_[w]->Sync();
+    }
+    // workers read only the tree and their own documents, so how they are
+    // spread over threads does not change the result
+    vector<thread> threads;
+    size_t num_threads = min(size_t(num_threads_), num_workers);
+    for (size_t t = 0; t < num_threads; ++t) {
+      threads.push_back(thread([this, t, num_threads, num_workers, begin, &worker2ll]() {
+            for (size_t w = t; w < num_workers; w += num_threads) {
+              auto& word_idxs = worker2word_idxs_[w];
+              size_t b = min(word_idxs.size(), begin);
+              size_t e = min(word_idxs.size(), begin + sync_interval_);
+              worker2ll[w] += workers_[w]->SampleWords(word_idxs.begin() + b,
+                                                       word_idxs.begin() + e);
+            }
+          }));
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    
+    for (size_t w = 0; w < num_workers; ++w) {
+      for (auto& sample : workers_[w]->samples()) {
+        AttachWord(sample, workers_[w]->predictive_path(sample));
+        ++num_done;
+      }
+    }
+    cerr << "sampling ...\t" << setw(6) << num_done << "/" << sampling_idxs_.size() << "\r";
   }
-  if (table_sample) {
-    cmanager_.TableBasedResample();
+  double ll = 0;
+  for (auto l : worker2ll) {
+    ll += l;
+  }
+  return ll;
+}
+
+double HpyLdaSampler::SampleWordsInSubtrees() {
+  size_t num_workers = subtree_workers_.size();
+  vector<double> worker2ll(num_workers, 0);
+  vector<thread> threads;
+  for (size_t w = 0; w < num_workers; ++w) {
+    auto& word_idxs = worker2word_idxs_[w];
+    random_shuffle(word_idxs.begin(), word_idxs.end(), *random);
+    threads.push_back(thread([this, w, &word_idxs, &worker2ll]() {
+          worker2ll[w] = subtree_workers_[w]->SampleWords(word_idxs.begin(),
+                                                          word_idxs.end());
+        }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  double ll = 0;
+  for (auto l : worker2ll) {
+    ll += l;
   }
-  
-  double ppl = std::exp(-ll / sampling_idxs_.size());
-  cerr << "[" << setw(2) << (iteration_i + 1) << "] sampling ...\t" << setw(6)
-       << sampling_idxs_.size() << "/" << sampling_idxs_.size()
-       << "\tperplexity=" << ppl << "\r";
-      //<< "\ttopicLL=" << logjoint() << "\r";
-  ll = logjoint();
-  LOG("info") << "[" << setw(2) << (iteration_i + 1)
-              << "] perplexity=" << ppl
-              << " log-likelihood=" << ll << endl;
   return ll;
 }
 
+void HpyLdaSampler::DetachWord(word_id_t word) {
+  auto& words = dmanager_.words();
+  int type = dmanager_.token(word);
+  int topic = dmanager_.topic(word);
+  int depth = words.depth(word);
+  cmanager_.UpTreeFromLeaf(words.node(word), depth);
+  cmanager_.rmanager().RemoveStopPassedCustomers(depth);
+  cmanager_.rmanager().SeparateWordFromSection(type, topic, depth, word);
+  cmanager_.rmanager().RemoveObservedCustomerFromPath(type, topic, depth);
+}
+
+void HpyLdaSampler::AttachWord(const WorkerSample& sample, const double* predictive_path) {
+  auto& words = dmanager_.words();
+  word_id_t word = sample.word_idx;
+  auto sent = dmanager_.sentence(word);
+  int type = dmanager_.token(word);
+  int token_idx = words.token_idx(word);
+  
+  int current_max_depth = cmanager_.WalkTreeNoCreate(sent, token_idx - 1, 0);
+  if (sample.depth > current_max_depth) {
+    cmanager_.WalkTree(sent, token_idx - 1 - current_max_depth, current_max_depth, sample.depth);
+  } else if (sample.depth < current_max_depth) {
+    cmanager_.EraseEmptyNodes(current_max_depth, sample.depth);
+  }
+  words.set_depth(word, sample.depth);
+  auto& node_path = cmanager_.current_node_path();
+  for (int d = 0; d < sample.depth; ++d) {
+    node_path[d]->add_type2child(type, node_path[d+1]);
+  }
+  words.set_node(word, node_path[sample.depth]);
+
+  // seat with the predictives the worker sampled with, under the current lambdas
+  cmanager_.CalcLambdaPath(sample.depth);
+  cmanager_.rmanager().SetPredictivePath(sample.depth, sample.topic, predictive_path);
+  cmanager_.rmanager().CombineSectionToWord(type, sample.topic, sample.depth, word);
+  cmanager_.rmanager().AddStopPassedCustomers(sample.depth);
+  cmanager_.rmanager().AddObservedCustomerToPath(type, sample.topic, sample.depth);
+}
+
 ParticleFilterSampler
 HpyLdaSampler::GetParticleFilterSampler(ParticleFilterDocumentManager& pf_dmanager, int step_size) {
-  return ParticleFilterSampler(*this, pf_dmanager, step_size);
+  return ParticleFilterSampler(cmanager_, parameters_, tree_type_, context_.seed(),
+                               (uint64_t(3) << 32) + num_pf_samplers_++,
+                               pf_dmanager, step_size);
 }
 ContextTreeAnalyzer HpyLdaSampler::GetCTAnalyzer() {
   return cmanager_.GetCTAnalyzer(dmanager_.intern());
 }
+void HpyLdaSampler::set_num_threads(int num_threads,
+                                    int num_shards,
+                                    int sync_interval,
+                                    bool shard_by_context) {
+  workers_.clear();
+  subtree_workers_.clear();
+  worker2word_idxs_.clear();
+  num_threads_ = max(num_threads, 1);
+  if (shard_by_context) {
+    // the workers share the tree but not the flat lambda tables
+    if (lambda_type_ != kHierarchical) {
+      throw "sharding by context needs hierarchical lambdas";
+    }
+    num_shards = num_threads_;
+  }
+  if (num_shards <= 0) throw "the number of shards must be positive";
+  if (num_shards <= 1) return;
+  if (sync_interval <= 0) throw "sync_interval must be positive";
+  sync_interval_ = sync_interval;
+
+  // group words into units which must be owned by one worker: a document (its
+  // topic counts are updated without locks), or a depth-1 context (its subtree)
+  vector<vector<int> > unit2word_idxs;
+  if (shard_by_context) {
+    unordered_map<int, int> context2unit;
+    auto& words = dmanager_.words();
+    for (int i = 0; i < dmanager_.num_words(); ++i) {
+      int context = words.token_idx(i) > 0 ?
+          dmanager_.sentence(i)[words.token_idx(i) - 1] : dmanager_.eos_id();
+      auto it = context2unit.find(context);
+      if (it == context2unit.end()) {
+        it = context2unit.insert({context, unit2word_idxs.size()}).first;
+        unit2word_idxs.push_back(vector<int>());
+      }
+      unit2word_idxs[it->second].push_back(i);
+    }
+  } else {
+    unit2word_idxs.resize(dmanager_.doc2topic_count().size());
+    for (int i = 0; i < dmanager_.num_words(); ++i) {
+      unit2word_idxs[dmanager_.words().doc_id(i)].push_back(i);
+    }
+  }
+  // assign the units to workers so that each worker has a similar number of words
+  sort(unit2word_idxs.begin(), unit2word_idxs.end(), [](const vector<int>& a, const vector<int>& b) {
+      return a.size() > b.size();
+    });
+  worker2word_idxs_.resize(num_shards);
+  for (auto& word_idxs : unit2word_idxs) {
+    auto lightest = min_element(worker2word_idxs_.begin(), worker2word_idxs_.end(),
+                                [](const vector<int>& a, const vector<int>& b) {
+                                  return a.size() < b.size();
+                                });
+    lightest->insert(lightest->end(), word_idxs.begin(), word_idxs.end());
+  }
+  // stream 0 is of the sampler itself
+  if (shard_by_context) {
+    subtree_locks_.reset(new SubtreeSamplingLocks());
+    for (int i = 0; i < num_shards; ++i) {
+      subtree_workers_.emplace_back(
+          new SubtreeSamplingWorker(cmanager_, tree_type_, dmanager_, parameters_, *subtree_locks_,
+                                    context_.seed(), i + 1));
+    }
+  } else {
+    for (int i = 0; i < num_shards; ++i) {
+      workers_.emplace_back(new SamplingWorker(cmanager_, tree_type_, dmanager_, parameters_,
+                                               context_.seed(), i + 1));
+    }
+  }
+}
+
+void HpyLdaSampler::set_mh_steps(int num_steps) {
+  if (num_steps < 0) throw "mh_steps must not be negative";
+  if (num_steps == 0) {
+    mh_sampler_.reset();
+    return;
+  }
+  mh_sampler_.reset(new MHTopicDepthSampler(parameters_, tree_type_, cmanager_.rmanager(),
+                                            cmanager_.lambda_path(), context_, num_steps));
+}
+
+void HpyLdaSampler::set_sparse_sampler(bool sparse) {
+  if (!sparse) {
+    sparse_sampler_.reset();
+    return;
+  }
+  if (tree_type_ == kGraphical && lambda_type_ != kHierarchical) {
+    throw "the sparse sampler needs hierarchical lambdas in the graphical tree";
+  }
+  sparse_sampler_.reset(new SparseTopicDepthSampler(parameters_, tree_type_, cmanager_.rmanager(),
+                                                    cmanager_.lambda_path(), context_));
+}
+
 void HpyLdaSampler::set_table_based_sampler(int max_t_in_block, int max_c_in_block, bool include_root) {
   cmanager_.set_table_based_sampler(tree_type_, dmanager_);
   cmanager_.tsampler().set_max_t_in_block(max_t_in_block);
@@ -8,18 +8,24 @@
 #include "context_tree_manager.hpp"
 #include "config.hpp"
 #include "particle_filter_sampler.hpp"
+#include "sampler_context.hpp"
+#include "word.hpp"
 
 namespace topiclm {
 
 class TopicDepthSampler;
+class MHTopicDepthSampler;
+class SparseTopicDepthSampler;
+class SamplingWorker;
+struct WorkerSample;
+class SubtreeSamplingWorker;
+struct SubtreeSamplingLocks;
 class Parameters;
 class DocumentManager;
 class ParticleFilterDocumentManager;
 struct SamplingConfiguration;
-struct Word;
 
 class HpyLdaSampler {
-  friend class ParticleFilterSampler;
  public:
   HpyLdaSampler(LambdaType lambda_type, TreeType tree_type, DocumentManager& dmanager, Parameters& parameters);
   ~HpyLdaSampler();
@@ -27,25 +33,79 @@ class HpyLdaSampler {
   void InitializeInRandom(int init_depth, bool hpy_random, double p_global);
   double RunOneIteration(int iteration_i, bool table_sample);
   
+  /**
+   * A prediction sampler on the tree with a random stream of its own;
+   * samplers must be used on the thread of this sampler.
+   */
   ParticleFilterSampler GetParticleFilterSampler(ParticleFilterDocumentManager& pf_dmanager, int step_size);
   ContextTreeAnalyzer GetCTAnalyzer();
+  const ContextTreeManager& cmanager() const { return cmanager_; }
+  ContextTreeManager& cmanager() { return cmanager_; }
+  const Parameters& parameters() const { return parameters_; }
+  LambdaType lambda_type() const { return lambda_type_; }
+  int seed() const { return context_.seed(); }
+  int num_nodes() const { return cmanager_.ct().CountNodes(); }
 
   void set_table_based_sampler(int max_t_in_block, int max_c_in_block, bool include_root);
+  /**
+   * Sample topics/depths in parallel with num_threads threads.
+   *
+   * By default words are distributed by documents to num_shards workers,
+   * which num_threads threads run; each worker samples sync_interval words
+   * against the tree left by the previous sync point with its own random
+   * stream, then all sampled words are seated to the tree serially
+   * (approximate). The result depends on num_shards but not on num_threads;
+   * one shard is the exact serial sampling.
+   * With shard_by_context, words are distributed by their preceding word so
+   * that each of num_threads workers owns whole subtrees below the root, and
+   * are sampled in place; only the root and the topic counts are shared
+   * (under locks), so the result is not reproducible. It needs hierarchical
+   * lambdas.
+   */
+  void set_num_threads(int num_threads, int num_shards, int sync_interval, bool shard_by_context);
+  /**
+   * Sample topics with num_steps Metropolis-Hastings steps per word (see
+   * MHTopicDepthSampler) after the first iteration; 0 for the exact
+   * sampler. Only the serial sampling uses it.
+   */
+  void set_mh_steps(int num_steps);
+  /**
+   * Sample topics exactly with SparseTopicDepthSampler, whose cost grows
+   * with the topics in use rather than with K. Only the serial sampling
+   * uses it, and only the first iteration if set_mh_steps is also given.
+   */
+  void set_sparse_sampler(bool sparse);
 
  private:
   bool ConsiderGeneral() {
     return tree_type_ == kNonGraphical;
   }
+  double SampleWordsSerially(int iteration_i);
+  double SampleWordsInParallel();
+  double SampleWordsInSubtrees();
+  void DetachWord(word_id_t word);
+  void AttachWord(const WorkerSample& sample, const double* predictive_path);
   double logjoint() const;
   
   DocumentManager& dmanager_;
   Parameters& parameters_;
+  SamplerContext context_;
   ContextTreeManager cmanager_;
   std::unique_ptr<TopicDepthSampler> topic_sampler_;
+  std::unique_ptr<MHTopicDepthSampler> mh_sampler_;
+  std::unique_ptr<SparseTopicDepthSampler> sparse_sampler_;
   std::vector<int> sampling_idxs_;
   LambdaType lambda_type_;
   TreeType tree_type_;
 
+  int num_threads_;
+  int sync_interval_;
+  uint64_t num_pf_samplers_; // streams of GetParticleFilterSampler
+  std::vector<std::unique_ptr<SamplingWorker> > workers_;
+  std::unique_ptr<SubtreeSamplingLocks> subtree_locks_;
+  std::vector<std::unique_ptr<SubtreeSamplingWorker> > subtree_workers_;
+  std::vector<std::vector<int> > worker2word_idxs_;
+
   friend class pfi::data::serialization::access;
   template <typename Archive>
   void serialize(Archive& ar) {
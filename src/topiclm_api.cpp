@@ -0,0 +1,155 @@
+#include <string>
+#include <atomic>
+#include <exception>
+#include "topiclm_api.h"
+#include "topiclm_model.hpp"
+#include "incremental_scorer.hpp"
+
+using namespace std;
+using namespace topiclm;
+
+static_assert(sizeof(topiclm_state) == sizeof(LmState), "topiclm_state must be LmState");
+static_assert(TOPICLM_MAX_HISTORY == kMaxLmHistory, "topiclm_state must be LmState");
+
+struct topiclm_model {
+  explicit topiclm_model(const char* fn)
+      : model(LoadFrozenModel(fn)),
+        incremental(model.sampler().model(), model.sampler().parameters()),
+        reader(model.reader_for_test()),
+        dict(model.intern()),
+        num_sessions(0) {}
+
+  // words are looked up without adding them, so that the dictionary is
+  // read-only and ids of unknown words are all dict.size()
+  int32_t WordId(const string& token) const {
+    int id = dict.key2id_nogen(token);
+    return id < 0 ? dict.size() : id;
+  }
+
+  HpyLdaModel<FrozenHpyLdaSampler> model;
+  IncrementalModel incremental;
+  shared_ptr<Reader> reader;
+  const pfi::data::intern<string>& dict;
+  atomic<uint64_t> num_sessions;
+};
+
+struct topiclm_scorer {
+  explicit topiclm_scorer(const topiclm_model& model) : scorer(model.incremental) {}
+  IncrementalScorer scorer;
+};
+
+struct topiclm_snapshot {
+  explicit topiclm_snapshot(const ParticleFilterDocumentManager& pf_dmanager)
+      : snapshot(pf_dmanager) {}
+  DocumentTopicSnapshot snapshot;
+};
+
+namespace {
+
+thread_local string last_error;
+
+template <class F>
+auto Guard(F f) -> decltype(f()) {
+  try {
+    return f();
+  } catch (string& what) {
+    last_error = what;
+  } catch (const char* what) {
+    last_error = what;
+  } catch (std::exception& e) {
+    last_error = e.what();
+  }
+  return nullptr;
+}
+
+const LmState& AsLmState(const topiclm_state* state) {
+  return *reinterpret_cast<const LmState*>(state);
+}
+
+} // namespace
+
+extern "C" {
+
+const char* topiclm_last_error(void) {
+  return last_error.c_str();
+}
+
+topiclm_model* topiclm_model_load(const char* fn) {
+  return Guard([fn] { return new topiclm_model(fn); });
+}
+
+void topiclm_model_free(topiclm_model* model) {
+  delete model;
+}
+
+int topiclm_model_order(const topiclm_model* model) {
+  return model->incremental.model().ngram_order();
+}
+
+int topiclm_model_num_topics(const topiclm_model* model) {
+  return model->incremental.model().num_topics();
+}
+
+int32_t topiclm_word_id(const topiclm_model* model, const char* word) {
+  auto tokens = model->reader->ReadTokens(word);
+  return tokens.empty() ? -1 : model->WordId(tokens[0]);
+}
+
+int32_t topiclm_eos_id(const topiclm_model* model) {
+  return model->incremental.model().eos_id();
+}
+
+void topiclm_begin_sentence_state(const topiclm_model* model, topiclm_state* out) {
+  *reinterpret_cast<LmState*>(out) = model->incremental.BeginSentenceState();
+}
+
+int topiclm_state_equal(const topiclm_state* a, const topiclm_state* b) {
+  return AsLmState(a) == AsLmState(b);
+}
+
+size_t topiclm_state_hash(const topiclm_state* state) {
+  return LmStateHash()(AsLmState(state));
+}
+
+topiclm_snapshot* topiclm_snapshot_new(topiclm_model* model,
+                                       const char* const* sentences,
+                                       int num_sentences,
+                                       int num_particles) {
+  return Guard([=] {
+      if (num_particles <= 0) throw string("num_particles must be positive");
+      auto session = model->model.sampler().NewSession(
+          model->model.GetPFDocumentManager(num_particles), 1, model->num_sessions++);
+      for (int i = 0; i < num_sentences; ++i) {
+        vector<int> sentence;
+        for (auto& token : model->reader->ReadTokens(sentences[i])) {
+          sentence.push_back(model->WordId(token));
+        }
+        sentence.push_back(model->incremental.model().eos_id());
+        session->sampler().log_probability(sentence, true);
+      }
+      return new topiclm_snapshot(session->pf_dmanager());
+    });
+}
+
+void topiclm_snapshot_free(topiclm_snapshot* snapshot) {
+  delete snapshot;
+}
+
+topiclm_scorer* topiclm_scorer_new(const topiclm_model* model) {
+  return Guard([model] { return new topiclm_scorer(*model); });
+}
+
+void topiclm_scorer_free(topiclm_scorer* scorer) {
+  delete scorer;
+}
+
+double topiclm_score(topiclm_scorer* scorer,
+                     const topiclm_snapshot* snapshot,
+                     const topiclm_state* state,
+                     int32_t word,
+                     topiclm_state* out) {
+  return scorer->scorer.Score(AsLmState(state), word, snapshot->snapshot,
+                              *reinterpret_cast<LmState*>(out));
+}
+
+} // extern "C"
@@ -0,0 +1,77 @@
+#ifndef _TOPICLM_TOPICLM_API_H_
+#define _TOPICLM_TOPICLM_API_H_
+
+/*
+ * C interface of the TOPICLM library for embedding the scorer of a compiled
+ * model (by topiclm_compile) in a decoder.
+ *
+ *   topiclm_model* model = topiclm_model_load("model.img");
+ *   topiclm_scorer* scorer = topiclm_scorer_new(model);   (one per thread)
+ *   topiclm_snapshot* doc = topiclm_snapshot_new(model, sentences, n, 10);
+ *   topiclm_state state, next;
+ *   topiclm_begin_sentence_state(model, &state);
+ *   double lp = topiclm_score(scorer, doc, &state, topiclm_word_id(model, "a"), &next);
+ *
+ * A model and snapshots are read-only after they are made and may be shared
+ * among threads; a scorer may not. Functions returning a pointer return
+ * NULL on errors, whose message is given by topiclm_last_error.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TOPICLM_MAX_HISTORY 7
+
+typedef struct topiclm_model topiclm_model;
+typedef struct topiclm_scorer topiclm_scorer;
+typedef struct topiclm_snapshot topiclm_snapshot;
+
+/* Opaque to users; compare with topiclm_state_equal. */
+typedef struct topiclm_state {
+  int32_t node;
+  int32_t history[TOPICLM_MAX_HISTORY];
+} topiclm_state;
+
+const char* topiclm_last_error(void);
+
+topiclm_model* topiclm_model_load(const char* fn);
+void topiclm_model_free(topiclm_model* model);
+int topiclm_model_order(const topiclm_model* model);
+int topiclm_model_num_topics(const topiclm_model* model);
+/* The id of word after the unknown word conversion of the model. Words the
+   model has never seen share one id outside of its vocabulary; -1 if word
+   has no token. */
+int32_t topiclm_word_id(const topiclm_model* model, const char* word);
+int32_t topiclm_eos_id(const topiclm_model* model);
+
+void topiclm_begin_sentence_state(const topiclm_model* model, topiclm_state* out);
+int topiclm_state_equal(const topiclm_state* a, const topiclm_state* b);
+size_t topiclm_state_hash(const topiclm_state* state);
+
+/* Topic state of a document after reading its sentences (may be none) with
+   the particle filter of num_particles particles. */
+topiclm_snapshot* topiclm_snapshot_new(topiclm_model* model,
+                                       const char* const* sentences,
+                                       int num_sentences,
+                                       int num_particles);
+void topiclm_snapshot_free(topiclm_snapshot* snapshot);
+
+topiclm_scorer* topiclm_scorer_new(const topiclm_model* model);
+void topiclm_scorer_free(topiclm_scorer* scorer);
+/* The natural log probability of word after state; the next state is
+   written to out (which may be state). */
+double topiclm_score(topiclm_scorer* scorer,
+                     const topiclm_snapshot* snapshot,
+                     const topiclm_state* state,
+                     int32_t word,
+                     topiclm_state* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TOPICLM_TOPICLM_API_H_ */
@@ -0,0 +1,40 @@
+#include <string>
+#include <fstream>
+#include "cmdline.h"
+#include "topiclm_model.hpp"
+
+using namespace std;
+
+static long FileSize(const string& fn) {
+  ifstream ifs(fn, ios::binary | ios::ate);
+  return ifs ? long(ifs.tellg()) : -1;
+}
+
+int main(int argc, char *argv[])
+{
+  cmdline::parser p;
+  p.add<string>("model", 'm', "trained model file name (not directory)", true);
+  p.add<string>("output", 'o', "compiled model file name", true);
+  p.add("image", '\0', "write an image to be mapped in place instead of an archive");
+  p.parse_check(argc, argv);
+
+  try {
+    auto model = topiclm::LoadModel<topiclm::HpyLdaSampler>(p.get<string>("model"));
+    if (p.exist("image")) {
+      model.SaveCompiledImage<topiclm::FrozenHpyLdaSampler>(p.get<string>("output"));
+    } else {
+      model.SaveCompiledModel<topiclm::FrozenHpyLdaSampler>(p.get<string>("output"));
+    }
+
+    auto frozen = topiclm::LoadFrozenModel(p.get<string>("output"));
+    auto& frozen_model = frozen.sampler().model();
+    cerr << "tree node size: " << frozen_model.num_nodes() << endl;
+    cerr << "compiled arrays: " << frozen_model.memory_size() << " bytes" << endl;
+    cerr << "file size: " << FileSize(p.get<string>("model")) << " -> "
+         << FileSize(p.get<string>("output")) << " bytes" << endl;
+  } catch (string& what) {
+    cerr << what << endl;
+    return 1;
+  }
+  return 0;
+}
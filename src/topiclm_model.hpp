@@ -11,6 +11,8 @@
 #include "document_manager.hpp"
 #include "particle_filter_document_manager.hpp"
 #include "io_util.hpp"
+#include "frozen_sampler.hpp"
+#include "mapped_image.hpp"
 
 namespace topiclm {
 
@@ -86,6 +88,70 @@ class HpyLdaModel {
   }
   
   SamplerType& sampler() { return *sampler_; }
+  const DocumentManager& dmanager() const { return dmanager_; }
+
+  /**
+   * Save as a model of CompiledType (e.g. FrozenHpyLdaSampler) which is
+   * built from the current sampler; the setting and dictionary are shared.
+   */
+  template <class CompiledType>
+  void SaveCompiledModel(const std::string& fn) {
+    std::ofstream ofs(fn);
+    if (!ofs) {
+      throw "cannot open model file " + fn;
+    }
+    pfi::data::serialization::binary_oarchive oa(ofs);
+    SerializeSetting(oa);
+    CompiledType compiled(*sampler_);
+    oa << compiled;
+    std::string end_flag = "end";
+    oa << end_flag;
+  }
+  /**
+   * Save the compiled model as an image which is used in place after
+   * mapping (see MapImage). Only the setting and dictionary are archived.
+   */
+  template <class CompiledType>
+  void SaveCompiledImage(const std::string& fn) {
+    std::ofstream ofs(fn, std::ios::binary);
+    if (!ofs) {
+      throw "cannot open model file " + fn;
+    }
+    std::stringstream setting;
+    {
+      pfi::data::serialization::binary_oarchive oa(setting);
+      SerializeSetting(oa);
+    }
+    std::string setting_bytes = setting.str();
+    CompiledType compiled(*sampler_);
+
+    ModelImageHeader header;
+    ImageWriter writer(ofs);
+    writer.Write(&header, sizeof(header));
+    header.setting_offset = writer.Align();
+    header.setting_size = setting_bytes.size();
+    writer.Write(setting_bytes.data(), setting_bytes.size());
+    header.sampler_offset = writer.Align();
+    compiled.WriteImage(writer);
+    header.sampler_size = writer.offset() - header.sampler_offset;
+    writer.Rewrite(0, &header, sizeof(header));
+    if (!ofs) {
+      throw "cannot write model file " + fn;
+    }
+  }
+  /**
+   * Read the setting from an image written by SaveCompiledImage; the
+   * sampler uses the rest of the mapped file in place.
+   */
+  void MapImage(std::shared_ptr<const MappedFile> file) {
+    auto& header = ModelImageHeader::Check(file->data(), file->size());
+    MemoryStreamBuf buf(file->data() + header.setting_offset, header.setting_size);
+    std::istream is(&buf);
+    pfi::data::serialization::binary_iarchive ia(is);
+    SerializeSetting(ia);
+    SetSampler();
+    sampler_->MapImage(file, header.sampler_offset, header.sampler_size);
+  }
 
   std::shared_ptr<Reader> reader(const std::string& fn) {
     auto word_convs = word_converters();
@@ -221,6 +287,14 @@ class HpyLdaModel {
   friend class pfi::data::serialization::access;
   template <typename Archive>
   void serialize(Archive& ar) {
+    SerializeSetting(ar);
+    if (ar.is_read) {
+      SetSampler();
+    }
+    ar & MEMBER(*sampler_);
+  }
+  template <typename Archive>
+  void SerializeSetting(Archive& ar) {
     if (ar.is_read) {
       int lambda_type;
       ar & lambda_type;      
@@ -237,10 +311,6 @@ class HpyLdaModel {
     ar & MEMBER(config_)
         & MEMBER(parameters_)
         & MEMBER(dmanager_);
-    if (ar.is_read) {
-      SetSampler();
-    }
-    ar & MEMBER(*sampler_);
   }
 };
 
@@ -257,8 +327,7 @@ inline void SaveModel(const std::string& fn, HpyLdaModel<SamplerType>& model) {
 }
 
 template <class SamplerType>
-inline HpyLdaModel<SamplerType> LoadModel(const std::string& fn) {
-  HpyLdaModel<SamplerType> model;
+inline void ReadModel(const std::string& fn, HpyLdaModel<SamplerType>& model) {
   std::ifstream ifs(fn);
   if (!ifs) {
     throw "cannot read model file " + fn;
@@ -270,17 +339,56 @@ inline HpyLdaModel<SamplerType> LoadModel(const std::string& fn) {
   std::string end_flag;
   ia >> end_flag;
   assert(end_flag == "end");
+}
 
+template <class SamplerType>
+inline void PrintLoadedModel(const HpyLdaModel<SamplerType>& model) {
   std::cerr << "model load done." << std::endl;
   
   std::cerr << "\nsetting of loaded model:" << std::endl;
   std::cerr << "--------------------" << std::endl;
   std::cerr << model.status();
   std::cerr << "--------------------\n" << std::endl;
-  
+}
+
+template <class SamplerType>
+inline HpyLdaModel<SamplerType> LoadModel(const std::string& fn) {
+  HpyLdaModel<SamplerType> model;
+  ReadModel(fn, model);
+  PrintLoadedModel(model);
+  return model;
+}
+
+/**
+ * Load a model compiled by topiclm_compile, mapping it if it is an image.
+ */
+inline HpyLdaModel<FrozenHpyLdaSampler> LoadFrozenModel(const std::string& fn) {
+  HpyLdaModel<FrozenHpyLdaSampler> model;
+  if (IsModelImage(fn)) {
+    model.MapImage(std::make_shared<MappedFile>(fn));
+  } else {
+    ReadModel(fn, model);
+  }
+  PrintLoadedModel(model);
   return model;
 }
 
+/**
+ * Call run(model) on the model in fn, loaded by LoadFrozenModel if it is
+ * compiled and by LoadModel otherwise; run takes HpyLdaModel of either
+ * sampler type.
+ */
+template <class Runner>
+inline void RunOnModel(const std::string& fn, bool compiled, const Runner& run) {
+  if (compiled) {
+    auto model = LoadFrozenModel(fn);
+    run(model);
+  } else {
+    auto model = LoadModel<HpyLdaSampler>(fn);
+    run(model);
+  }
+}
+
 } // topiclm
   
 #endif /* _TOPICLM_TOPICLM_MODEL_HPP_ */
@@ -3,38 +3,93 @@
 #include "cmdline.h"
 #include "random_util.hpp"
 #include "topiclm_model.hpp"
+#include "rejuvenation_options.hpp"
 #include "log.hpp"
 #include "particle_filter_document_manager.hpp"
+#include "test_predictive_cache.hpp"
 
 using namespace std;
 
+double RunParallel(topiclm::FrozenHpyLdaSampler& sampler,
+                   const topiclm::ParticleFilterDocumentManager& pf_dmanager,
+                   const topiclm::RejuvenationPolicy& rejuvenation,
+                   const cmdline::parser& p) {
+  sampler.set_predictive_cache(size_t(p.get<int>("predictive_cache")) << 20,
+                               p.get<int>("predictive_cache_shards"));
+  double ppl = sampler.Run(pf_dmanager, p.get<int>("step"), rejuvenation, p.get<int>("threads"), cout);
+  if (auto cache = sampler.predictive_cache()) {
+    auto stats = cache->stats();
+    cerr << "predictive cache: hits=" << stats.hits
+         << " misses=" << stats.misses
+         << " hit_rate=" << stats.hit_rate()
+         << " evictions=" << stats.evictions
+         << " entries=" << stats.entries
+         << " bytes=" << stats.bytes << endl;
+  }
+  return ppl;
+}
+
+// threads evaluate documents on a compiled model, which gives the same
+// predictives as the tree and may be read concurrently
+double RunParallel(topiclm::HpyLdaSampler& sampler,
+                   const topiclm::ParticleFilterDocumentManager& pf_dmanager,
+                   const topiclm::RejuvenationPolicy& rejuvenation,
+                   const cmdline::parser& p) {
+  topiclm::FrozenHpyLdaSampler frozen(sampler);
+  return RunParallel(frozen, pf_dmanager, rejuvenation, p);
+}
+
+template <class SamplerType>
+void Predict(topiclm::HpyLdaModel<SamplerType>& model, const cmdline::parser& p) {
+  auto& sampler = model.sampler();
+  cerr << "tree node size: " << sampler.num_nodes() << endl;
+
+  auto pf_dmanager = model.GetPFDocumentManager(p.get<int>("particles"));
+    
+  pf_dmanager.Read(model.reader_for_test(p.get<string>("file")));
+  auto rejuvenation = topiclm::GetRejuvenationPolicy(p);
+
+  double ppl;
+  if (p.get<int>("threads") > 1 || p.get<int>("predictive_cache") > 0) {
+    ppl = RunParallel(sampler, pf_dmanager, rejuvenation, p);
+  } else {
+    auto pf_sampler = sampler.GetParticleFilterSampler(pf_dmanager, p.get<int>("step"));
+    pf_sampler.set_rejuvenation(rejuvenation);
+    ppl = pf_sampler.Run(cout);
+  }
+  cerr << "perplexity: " << ppl << endl;
+  cout << "perplexity: " << ppl << endl;
+}
+
+struct Predictor {
+  const cmdline::parser& p;
+  template <class SamplerType>
+  void operator()(topiclm::HpyLdaModel<SamplerType>& model) const { Predict(model, p); }
+};
+
 int main(int argc, char *argv[])
 {
   cmdline::parser p;
   p.add<string>("file", 'f', "test file", true);
   p.add<int>("particles", 'p', "nubmer of particles", false, 1);
   p.add<int>("step", 's', "reestimate step size", false, 1);
+  topiclm::AddRejuvenationOptions(p);
   p.add<string>("model", 'm', "model file name (not directory)", true);
+  p.add("frozen", '\0', "the model is compiled by topiclm_compile (archive or mapped image)");
+  p.add<int>("threads", 't', "number of threads evaluating documents (the result does not depend on it)", false, 1);
+  p.add<int>("seed", 'A', "random seed", false, -1);
+  p.add<int>("predictive_cache", '\0', "MB of predictives of (context, word) kept for reuse by the threads (0=no cache; evaluates on a compiled model as with threads)", false, 0);
+  p.add<int>("predictive_cache_shards", '\0', "number of independently locked parts of the predictive cache", false, 16);
   p.parse_check(argc, argv);
 
   try {
-    topiclm::init_rnd();
-    
-    auto model = topiclm::LoadModel<topiclm::HpyLdaSampler>(p.get<string>("model"));
-
-    auto& sampler = model.sampler();
-    auto ct_analyzer = sampler.GetCTAnalyzer();
-    
-    cerr << "tree node size: " << ct_analyzer.CountNodes() << endl;
-
-    auto pf_dmanager = model.GetPFDocumentManager(p.get<int>("particles"));
-    
-    pf_dmanager.Read(model.reader_for_test(p.get<string>("file")));
-    auto pf_sampler = sampler.GetParticleFilterSampler(pf_dmanager, p.get<int>("step"));
+    if (p.get<int>("seed") == -1) {
+      topiclm::init_rnd();
+    } else {
+      topiclm::init_rnd(p.get<int>("seed"));
+    }
 
-    double ppl = pf_sampler.Run(cout);
-    cerr << "perplexity: " << ppl << endl;
-    cout << "perplexity: " << ppl << endl;
+    topiclm::RunOnModel(p.get<string>("model"), p.exist("frozen"), Predictor{p});
   } catch (string& what) {
     cerr << what << endl;
     return 1;
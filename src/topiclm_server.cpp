@@ -0,0 +1,43 @@
+#include <string>
+#include <iostream>
+#include "cmdline.h"
+#include "random_util.hpp"
+#include "topiclm_model.hpp"
+#include "rejuvenation_options.hpp"
+#include "scoring_server.hpp"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+  cmdline::parser p;
+  p.add<string>("model", 'm', "compiled model file name (by topiclm_compile)", true);
+  p.add<int>("threads", 't', "number of worker threads", false, 1);
+  p.add<int>("particles", 'p', "nubmer of particles of each session", false, 1);
+  p.add<int>("step", 's', "reestimate each after storing this number of sentences", false, 1);
+  topiclm::AddRejuvenationOptions(p);
+  p.add<bool>("calc_eos", 'e', "Whether the sentence probability contains each EOS probability", false, true);
+  p.add<int>("predictive_cache", '\0', "MB of predictives of (context, word) kept for reuse by all sessions (0=no cache; hits are in stats)", false, 0);
+  p.add<int>("predictive_cache_shards", '\0', "number of independently locked parts of the predictive cache", false, 16);
+  p.parse_check(argc, argv);
+
+  try {
+    topiclm::init_rnd();
+
+    auto rejuvenation = topiclm::GetRejuvenationPolicy(p);
+    auto model = topiclm::LoadFrozenModel(p.get<string>("model"));
+    model.sampler().set_predictive_cache(size_t(p.get<int>("predictive_cache")) << 20,
+                                         p.get<int>("predictive_cache_shards"));
+    topiclm::ScoringServer server(model,
+                                  p.get<int>("threads"),
+                                  p.get<int>("particles"),
+                                  p.get<int>("step"),
+                                  rejuvenation,
+                                  p.get<bool>("calc_eos"));
+    server.Serve(cin, cout);
+  } catch (string& what) {
+    cerr << what << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -92,6 +92,14 @@ int main(int argc, char** argv) {
   p.add<int>("max_c_in_block", 'E', "In table-based sampler, if # customers exceeds this, that block will be ignored", false, -1);
   p.add<bool>("table_include_root", 'R', "visit all tables in the root node, or skip (0=skip; 1=visit)", false, 1);
   p.add<int>("seed", 'A', "random seed", false, -1);
+  p.add<int>("threads", 'j', "number of threads sampling the document shards (or the subtrees with shard_by_context)", false, 1);
+  p.add<int>("shards", 'W', "number of document shards sampled in parallel, each with its own random stream; results are reproducible at any number of threads (1=exact serial sampling)", false, 1);
+  p.add<int>("sync_interval", 'Y', "with threads or shards > 1, number of words each shard samples between synchronizations of the tree", false, 1000);
+  p.add<bool>("shard_by_context", 'Z', "with threads > 1, distribute words by their preceding word and sample in place on each thread's own subtrees (not approximate)", false, false);
+  p.add<int>("mh_steps", 'M', "after the first iteration, sample each topic by this number of Metropolis-Hastings steps with alias-table proposals instead of the exact posterior over all topics (0=exact; serial sampling only)", false, 0);
+  p.add<bool>("sparse_sampler", 'S', "sample topics exactly with a sparse (SparseLDA-style) sampler whose cost grows with the topics in use rather than with num_topics (serial sampling only)", false, false);
+  p.add<int>("section_hash_threshold", 'X', "a restaurant switches its type index from a sorted array to a hash table above this number of types", false, 256);
+  p.add<int>("dense_floor_threshold", 'L', "a restaurant keeps its floor totals as dense arrays over topics above this number of floors, and scales its predictives in one pass", false, 64);
   
   p.add<string>("word_converters", 'c', "list of word converters to apply for each word (ex: -c \"0 1\") (0=lower casing all words; 1=replace all number charactors to # (ex: 12,345=>##,###))", false, "");
   p.add<int>("unk_converter", 'u', "How to convert an unknown token? (0=replace with unk_type; 1=replace with a signature of a surface (e.g., vexing -> UNK-ing; NOTE: English spcific))", false, 0);
@@ -126,6 +134,8 @@ int main(int argc, char** argv) {
       topiclm::init_rnd(p.get<int>("seed"));
     }
     StartLogging(argv, p.get<string>("model"));
+    topiclm::Restaurant::set_section_hash_threshold(p.get<int>("section_hash_threshold"));
+    topiclm::Restaurant::set_dense_floor_threshold(p.get<int>("dense_floor_threshold"));
 
     int num_burnins = p.get<int>("burn-ins");
     int interval = p.get<int>("interval");
@@ -179,6 +189,15 @@ int main(int argc, char** argv) {
     sampler.set_table_based_sampler(p.get<int>("max_t_in_block"),
                                     p.get<int>("max_c_in_block"),
                                     p.get<bool>("table_include_root"));
+    if (p.get<int>("threads") > 1 && p.get<int>("shards") == 1 && !p.get<bool>("shard_by_context")) {
+      cerr << "threads have no effect with one shard (see --shards)" << endl;
+    }
+    sampler.set_num_threads(p.get<int>("threads"),
+                            p.get<int>("shards"),
+                            p.get<int>("sync_interval"),
+                            p.get<bool>("shard_by_context"));
+    sampler.set_mh_steps(p.get<int>("mh_steps"));
+    sampler.set_sparse_sampler(p.get<bool>("sparse_sampler"));
     
     int table_based_step = p.get<int>("table_based_step");
     if (table_based_step == 0 || p.get<int>("max_t_in_block") == 0 || p.get<int>("num_topics") == 1) {
@@ -189,6 +208,7 @@ int main(int argc, char** argv) {
     std::cerr << "--------------------" << std::endl;
     std::cerr << " # sampling for burn-in: " << num_burnins << std::endl;
     std::cerr << " after that, samples " << p.get<int>("num-samples") << " models every " << interval << "iterations" << std::endl;
+    std::cerr << " # threads: " << p.get<int>("threads") << std::endl;
     std::cerr << " Table-based sampler:" << std::endl;
     std::cerr << "  Running table-based sampler?: " << (table_sample ? "yes" : "no") << std::endl;
     if (table_sample) {
@@ -0,0 +1,148 @@
+#ifndef _TOPICLM_TYPE_MAP_HPP_
+#define _TOPICLM_TYPE_MAP_HPP_
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include "serialization.hpp"
+
+namespace topiclm {
+
+/**
+ * Map from a type (word id) to V, used as the section index of a Restaurant.
+ *
+ * Entries are kept in one vector. While the map is small they are sorted and
+ * found by binary search, as a flat_map. Once it grows beyond
+ * hash_threshold() entries (restaurants near the root see almost the whole
+ * vocabulary), new entries are appended and found through an open addressing
+ * table of entry indices, so an insertion no longer shifts the vector.
+ * Types are never erased. Iteration follows the entry vector, which is not
+ * sorted after the switch; serialization always writes the entries sorted,
+ * in the same format as a flat_map.
+ */
+template <typename V>
+class TypeMap {
+ public:
+  typedef std::pair<int, V> value_type;
+  typedef typename std::vector<value_type>::iterator iterator;
+  typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+  static size_t hash_threshold() { return hash_threshold_; }
+  static void set_hash_threshold(size_t threshold) { hash_threshold_ = threshold; }
+
+  TypeMap() : mask_(0) {}
+
+  iterator begin() { return entries_.begin(); }
+  iterator end() { return entries_.end(); }
+  const_iterator begin() const { return entries_.begin(); }
+  const_iterator end() const { return entries_.end(); }
+  size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+  bool hashed() const { return !slots_.empty(); }
+
+  iterator find(int type) {
+    return entries_.begin() + FindIndex(type);
+  }
+  const_iterator find(int type) const {
+    return entries_.begin() + FindIndex(type);
+  }
+  V& operator[](int type) {
+    if (hashed()) {
+      size_t slot = Probe(type);
+      if (slots_[slot] != 0) return entries_[slots_[slot] - 1].second;
+      entries_.emplace_back(type, V());
+      slots_[slot] = entries_.size();
+      if (entries_.size() * 2 > slots_.size()) Rehash(slots_.size() * 2);
+      return entries_.back().second;
+    }
+    auto it = LowerBound(type);
+    if (it != entries_.end() && (*it).first == type) return (*it).second;
+    it = entries_.emplace(it, type, V());
+    if (entries_.size() > hash_threshold_) {
+      size_t idx = it - entries_.begin();
+      Rehash(4 * entries_.size());
+      return entries_[idx].second;
+    }
+    return (*it).second;
+  }
+  void clear() {
+    entries_.clear();
+    slots_.clear();
+    mask_ = 0;
+  }
+
+ private:
+  static size_t hash_threshold_;
+
+  static size_t Hash(int type) {
+    return (uint64_t(uint32_t(type)) * 0x9E3779B97F4A7C15ull) >> 32;
+  }
+  iterator LowerBound(int type) {
+    return std::lower_bound(entries_.begin(), entries_.end(), type,
+                            [](const value_type& e, int t) { return e.first < t; });
+  }
+  size_t FindIndex(int type) const {
+    if (hashed()) {
+      uint32_t idx = slots_[Probe(type)];
+      return idx != 0 ? idx - 1 : entries_.size();
+    }
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), type,
+                               [](const value_type& e, int t) { return e.first < t; });
+    return (it != entries_.end() && (*it).first == type) ? it - entries_.begin() : entries_.size();
+  }
+  // slot holding type, or the empty slot where it should be inserted
+  size_t Probe(int type) const {
+    size_t slot = Hash(type) & mask_;
+    while (slots_[slot] != 0 && entries_[slots_[slot] - 1].first != type) {
+      slot = (slot + 1) & mask_;
+    }
+    return slot;
+  }
+  void Rehash(size_t min_slots) {
+    size_t num_slots = 16;
+    while (num_slots < min_slots) num_slots <<= 1;
+    slots_.assign(num_slots, 0);
+    mask_ = num_slots - 1;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      slots_[Probe(entries_[i].first)] = i + 1;
+    }
+  }
+
+  std::vector<value_type> entries_;
+  std::vector<uint32_t> slots_; // entry index + 1, 0 for an empty slot
+  size_t mask_;
+
+  friend class pfi::data::serialization::access;
+  template <class Archive>
+  void serialize(Archive& ar) {
+    uint32_t size = static_cast<uint32_t>(entries_.size());
+    ar & size;
+    if (ar.is_read) {
+      clear();
+      while (size--) {
+        value_type v;
+        ar & v;
+        (*this)[v.first] = std::move(v.second);
+      }
+    } else {
+      std::vector<uint32_t> order(entries_.size());
+      for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+      if (hashed()) {
+        std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+            return entries_[a].first < entries_[b].first;
+          });
+      }
+      for (uint32_t i : order) {
+        ar & entries_[i];
+      }
+    }
+  }
+};
+
+template <typename V>
+size_t TypeMap<V>::hash_threshold_ = 256;
+
+} // namespace topiclm
+
+#endif /* _TOPICLM_TYPE_MAP_HPP_ */
@@ -0,0 +1,102 @@
+#include <vector>
+#include <string>
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include "type_map.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace topiclm;
+using namespace std;
+
+namespace {
+
+typedef vector<int> Value;
+typedef TypeMap<Value> Map;
+typedef boost::container::flat_map<int, Value> FlatMap;
+
+template <class T>
+string Serialize(T& x) {
+  stringstream ss;
+  pfi::data::serialization::binary_oarchive oa(ss);
+  oa << x;
+  return ss.str();
+}
+
+template <class T>
+void Deserialize(const string& bytes, T& x) {
+  stringstream ss(bytes);
+  pfi::data::serialization::binary_iarchive ia(ss);
+  ia >> x;
+}
+
+// the same entries in a TypeMap and a flat_map, inserted in random order
+void Fill(int num_types, Map& map, FlatMap& flat_map) {
+  vector<int> types;
+  for (int t = 0; t < num_types; ++t) types.push_back(3 * t + 1);
+  mt19937 random(7);
+  shuffle(types.begin(), types.end(), random);
+  for (int type : types) {
+    Value value(type % 4, type);
+    map[type] = value;
+    flat_map[type] = value;
+  }
+}
+
+void ExpectSameEntries(const FlatMap& expected, const Map& actual) {
+  ASSERT_EQ(expected.size(), actual.size());
+  for (auto& kv : expected) {
+    auto it = actual.find(kv.first);
+    ASSERT_TRUE(it != actual.end()) << "type " << kv.first;
+    EXPECT_EQ(kv.second, (*it).second);
+  }
+}
+
+class TypeMapSerializationTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() { threshold_ = Map::hash_threshold(); }
+  virtual void TearDown() { Map::set_hash_threshold(threshold_); }
+  size_t threshold_;
+};
+
+} // namespace
+
+TEST_F(TypeMapSerializationTest, sorted_map_as_flat_map) {
+  Map::set_hash_threshold(256);
+  Map map;
+  FlatMap flat_map;
+  Fill(100, map, flat_map);
+  ASSERT_FALSE(map.hashed());
+  EXPECT_EQ(Serialize(flat_map), Serialize(map));
+
+  Map read;
+  Deserialize(Serialize(flat_map), read);
+  ExpectSameEntries(flat_map, read);
+}
+
+TEST_F(TypeMapSerializationTest, hashed_map_as_flat_map) {
+  Map::set_hash_threshold(8);
+  Map map;
+  FlatMap flat_map;
+  Fill(100, map, flat_map);
+  ASSERT_TRUE(map.hashed());
+  EXPECT_EQ(Serialize(flat_map), Serialize(map));
+
+  // an old model is hashed again while it is read
+  Map read;
+  Deserialize(Serialize(flat_map), read);
+  EXPECT_TRUE(read.hashed());
+  ExpectSameEntries(flat_map, read);
+  EXPECT_EQ(Serialize(flat_map), Serialize(read));
+
+  FlatMap flat_read;
+  Deserialize(Serialize(map), flat_read);
+  EXPECT_TRUE(flat_map == flat_read);
+}
+
+TEST_F(TypeMapSerializationTest, empty_map_as_flat_map) {
+  Map map;
+  FlatMap flat_map;
+  EXPECT_EQ(Serialize(flat_map), Serialize(map));
+}
@@ -18,8 +18,8 @@ namespace topiclm {
 UnigramRescalingSampler::UnigramRescalingSampler(LambdaType lambda_type, TreeType tree_type, DocumentManager& dmanager, Parameters& parameters)
     : dmanager_(dmanager),
       parameters_(parameters),
-      cmanager_(lambda_type, tree_type, parameters, dmanager.lexicon(), dmanager.eos_id()),
-      topic_sampler_(parameters),
+      cmanager_(lambda_type, tree_type, parameters, dmanager.lexicon(), dmanager.eos_id(), context_),
+      topic_sampler_(parameters, context_),
       topic2word_prob_(parameters.topic_parameter().num_topics + 1),
       unigram_sum_count_(0),
       topic2word_counts_(parameters.topic_parameter().num_topics + 1),
@@ -40,31 +40,35 @@ UnigramRescalingSampler::~UnigramRescalingSampler() {}
 void UnigramRescalingSampler::InitializeInRandom() {
   assert(beta_ > 0);
   assert(sampling_idxs_.size() > 0);
+  SamplerContext::Scope scope(context_);
   cerr << "initializting..." << endl;
   random_shuffle(sampling_idxs_.begin(), sampling_idxs_.end(), *random);
+  auto& words = dmanager_.words();
   for (size_t j = 0; j < sampling_idxs_.size(); ++j) {
-    auto& word = dmanager_.word(j);
-    auto& sent = dmanager_.sentence(*word);
-    int type = dmanager_.token(*word);
-    word->depth = cmanager_.WalkTree(sent, word->token_idx - 1, 0, parameters_.ngram_order() - 1);
+    word_id_t word = j;
+    auto sent = dmanager_.sentence(word);
+    int type = dmanager_.token(word);
+    int depth = cmanager_.WalkTree(sent, words.token_idx(word) - 1, 0, parameters_.ngram_order() - 1);
+    words.set_depth(word, depth);
     int sampled_topic = topic_sampler_.SampleAtRandom();
     
     ++topic2word_counts_[sampled_topic].second[type];
     ++topic2word_counts_[sampled_topic].first;
     
-    dmanager_.IncrementTopicCount(word->doc_id, sampled_topic, parameters_.topic_parameter().alpha[sampled_topic]);
-    dmanager_.set_topic(*word, sampled_topic);
+    dmanager_.IncrementTopicCount(words.doc_id(word), sampled_topic, parameters_.topic_parameter().alpha[sampled_topic]);
+    dmanager_.set_topic(word, sampled_topic);
 
-    cmanager_.rmanager().CalcGlobalPredictivePath(type, word->depth);
-    cmanager_.rmanager().AddCustomerToPath(type, 0, word->depth);
+    cmanager_.rmanager().CalcGlobalPredictivePath(type, depth);
+    cmanager_.rmanager().AddCustomerToPath(type, 0, depth);
 
-    word->node = cmanager_.current_node_path()[word->depth];
-    assert(word->node != nullptr);
+    words.set_node(word, cmanager_.current_node_path()[depth]);
+    assert(words.node(word) != nullptr);
   }
 }
 
 void UnigramRescalingSampler::RunOneIteration(int iteration_i) {
   assert(beta_ > 0);
+  SamplerContext::Scope scope(context_);
   random_shuffle(sampling_idxs_.begin(), sampling_idxs_.end(), *random);
   if (iteration_i == 0) {
     SampleHpyPart(iteration_i);
@@ -83,6 +87,7 @@ double UnigramRescalingSampler::PredictInParticleFilter(
     int step,
     double rescale_factor,
     ostream& os) {
+  SamplerContext::Scope scope(context_);
   cerr << "test set particle filter start ..." << endl;
   vector<double> current_priors(topic2word_prob_.size());
   double ll = 0;
@@ -101,18 +106,17 @@ double UnigramRescalingSampler::PredictInParticleFilter(
       if (i % step == 0) {
         for (int j = 0; j < i; ++j) {
           for (int m = 0; m < num_particles; ++m) {
-            auto& word = pf_dmanager.word(m, j);
-            int topic = pf_dmanager.topic(m, word);
+            int topic = pf_dmanager.topic(m, j);
             pf_dmanager.DecrementTopicCount(m, topic);
             topic_sampler_.InitWithTopicPrior(pf_dmanager.topic_count(m));
             topic_sampler_.TakeInLikelihood(doc_predictives[j]);
             auto sample = topic_sampler_.Sample();
             pf_dmanager.IncrementTopicCount(m, sample.topic);
-            pf_dmanager.set_topic(m, word, sample.topic);
+            pf_dmanager.set_topic(m, j, sample.topic);
           }
         }
       } // end
-      auto& word = pf_dmanager.word(0, i);
+      auto& word = pf_dmanager.word(i);
       auto& sent = pf_dmanager.sentence(word);
       int type = pf_dmanager.token(word);
       double p_w = 0;
@@ -172,7 +176,7 @@ double UnigramRescalingSampler::PredictInParticleFilter(
         topic_sampler_.TakeInLikelihood(topic2word_prob_);
         auto sample = topic_sampler_.Sample();
         pf_dmanager.IncrementTopicCount(m, sample.topic);
-        pf_dmanager.set_topic(m, word, sample.topic);
+        pf_dmanager.set_topic(m, i, sample.topic);
       }
       os << getWord(type, pf_dmanager.intern()) << "\t" << p_w << endl;
     }
@@ -186,27 +190,28 @@ ContextTreeAnalyzer UnigramRescalingSampler::GetCTAnalyzer() {
 
 void UnigramRescalingSampler::SampleLdaPart(int iteration_i) {
   double ll =0;
+  auto& words = dmanager_.words();
   for (size_t j = 0; j < sampling_idxs_.size(); ++j) {
     if (j % 1000 == 0) {
       cerr << "[" << setw(2) << (iteration_i + 1) << "] sampling ...\t" << setw(6)
            << (j + 1) << "/" << sampling_idxs_.size() << "\r";
     }
-    auto& word = dmanager_.word(j);
-    int type = dmanager_.token(*word);
-    int topic = dmanager_.topic(*word);
+    word_id_t word = j;
+    int type = dmanager_.token(word);
+    int topic = dmanager_.topic(word);
     if (iteration_i > 0) {
-      dmanager_.DecrementTopicCount(word->doc_id, topic);
+      dmanager_.DecrementTopicCount(words.doc_id(word), topic);
       --topic2word_counts_[topic].first;      
       if (--topic2word_counts_[topic].second[type] == 0) {
         topic2word_counts_[topic].second.erase(type);
       }
     }
-    topic_sampler_.InitWithTopicPrior(dmanager_.doc2topic_count()[word->doc_id]);
+    topic_sampler_.InitWithTopicPrior(dmanager_.doc2topic_count()[words.doc_id(word)]);
     CalcTopic2WordProb(type);
     topic_sampler_.TakeInLikelihood(topic2word_prob_);
     auto sample = topic_sampler_.Sample();
-    dmanager_.IncrementTopicCount(word->doc_id, sample.topic, parameters_.topic_parameter().alpha[sample.topic]);
-    dmanager_.set_topic(*word, sample.topic);
+    dmanager_.IncrementTopicCount(words.doc_id(word), sample.topic, parameters_.topic_parameter().alpha[sample.topic]);
+    dmanager_.set_topic(word, sample.topic);
     ++topic2word_counts_[sample.topic].second[type];
     ++topic2word_counts_[sample.topic].first;
     ll += std::log(sample.p_w);
@@ -220,23 +225,25 @@ void UnigramRescalingSampler::SampleLdaPart(int iteration_i) {
 }
 
 void UnigramRescalingSampler::SampleHpyPart(int iteration_i) {
+  auto& words = dmanager_.words();
   for (size_t j = 0; j < sampling_idxs_.size(); ++j) {
     if (j % 1000 == 0) {
       cerr << "[" << setw(2) << (iteration_i + 1) << "] sampling ...\t" << setw(6)
            << (j + 1) << "/" << sampling_idxs_.size() << "\r";
     }
-    auto& word = dmanager_.word(j);
-    auto& sent = dmanager_.sentence(*word);
-    int type = dmanager_.token(*word);
+    word_id_t word = j;
+    auto sent = dmanager_.sentence(word);
+    int type = dmanager_.token(word);
     if (iteration_i > 0) {
-      cmanager_.UpTreeFromLeaf(word->node, word->depth);
-      cmanager_.rmanager().RemoveCustomerFromPath(type, 0, word->depth);
+      cmanager_.UpTreeFromLeaf(words.node(word), words.depth(word));
+      cmanager_.rmanager().RemoveCustomerFromPath(type, 0, words.depth(word));
     } else {
-      word->depth = cmanager_.WalkTree(sent, word->token_idx - 1, 0, parameters_.ngram_order() - 1);
-      word->node = cmanager_.current_node_path()[word->depth];
+      words.set_depth(word, cmanager_.WalkTree(sent, words.token_idx(word) - 1, 0,
+                                               parameters_.ngram_order() - 1));
+      words.set_node(word, cmanager_.current_node_path()[words.depth(word)]);
     }
-    cmanager_.rmanager().CalcGlobalPredictivePath(type, word->depth);
-    cmanager_.rmanager().AddCustomerToPath(type, 0, word->depth);
+    cmanager_.rmanager().CalcGlobalPredictivePath(type, words.depth(word));
+    cmanager_.rmanager().AddCustomerToPath(type, 0, words.depth(word));
   }
   auto& depth2nodes = cmanager_.GetDepth2Nodes();
   parameters_.SamplingHpyParameter(depth2nodes);
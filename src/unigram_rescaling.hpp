@@ -47,6 +47,7 @@ class UnigramRescalingSampler {
 
   DocumentManager& dmanager_;
   Parameters& parameters_;
+  SamplerContext context_;
   ContextTreeManager cmanager_;
   TopicSampler topic_sampler_;
   std::vector<int> sampling_idxs_;
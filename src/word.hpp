@@ -1,6 +1,9 @@
 #ifndef _TOPICLM_WORD_HPP_
 #define _TOPICLM_WORD_HPP_
 
+#include <vector>
+#include <cstdint>
+#include <cassert>
 #include "config.hpp"
 
 namespace topiclm {
@@ -19,6 +22,57 @@ struct Word {
   Node* node;
 };
 
+typedef uint32_t word_id_t;
+
+/**
+ * Sampling state of all words of a training corpus, kept in parallel arrays
+ * indexed by word_id_t (ids follow the corpus order). Restaurants refer to
+ * the observed words of a section by their ids.
+ */
+class WordTable {
+ public:
+  static const int kMaxDepth = UINT8_MAX;
+
+  word_id_t Add(int doc_id, int sent_id, int token_idx) {
+    doc_ids_.push_back(doc_id);
+    sent_ids_.push_back(sent_id);
+    token_idxs_.push_back(token_idx);
+    depths_.push_back(0);
+    topics_.push_back(-1);
+    is_generals_.push_back(false);
+    nodes_.push_back(nullptr);
+    return doc_ids_.size() - 1;
+  }
+  void clear() { *this = WordTable(); }
+  size_t size() const { return doc_ids_.size(); }
+
+  int doc_id(word_id_t word) const { return doc_ids_[word]; }
+  // index of the sentence in the whole corpus
+  int sent_id(word_id_t word) const { return sent_ids_[word]; }
+  int token_idx(word_id_t word) const { return token_idxs_[word]; }
+  int depth(word_id_t word) const { return depths_[word]; }
+  topic_t topic(word_id_t word) const { return topics_[word]; }
+  bool is_general(word_id_t word) const { return is_generals_[word]; }
+  Node* node(word_id_t word) const { return nodes_[word]; }
+
+  void set_depth(word_id_t word, int depth) {
+    assert(depth >= 0 && depth <= kMaxDepth);
+    depths_[word] = depth;
+  }
+  void set_topic(word_id_t word, topic_t topic) { topics_[word] = topic; }
+  void set_is_general(word_id_t word, bool is_general) { is_generals_[word] = is_general; }
+  void set_node(word_id_t word, Node* node) { nodes_[word] = node; }
+
+ private:
+  std::vector<int32_t> doc_ids_;
+  std::vector<int32_t> sent_ids_;
+  std::vector<int32_t> token_idxs_;
+  std::vector<uint8_t> depths_;
+  std::vector<topic_t> topics_;
+  std::vector<uint8_t> is_generals_;
+  std::vector<Node*> nodes_;
+};
+
 } // topiclm
 
 #endif /* _TOPICLM_WORD_HPP_ */